@@ -0,0 +1,504 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "client-accounting.h"
+#include "client-name.h"
+#include "log.h"
+
+/* Request opcodes, only the client protocol header names them */
+#define SHM_CREATE_POOL 0
+#define SHM_POOL_CREATE_BUFFER 0
+#define SHM_POOL_RESIZE 2
+
+/* One protocol object counted against a client, freed with the object.
+ * A wl_shm_pool charge lives on until its buffers are gone too. */
+struct charge
+{
+  struct client_usage *usage; /* NULL once the client has gone */
+  struct wl_list link; /* client_usage::charges */
+  struct wl_listener destroy_listener;
+  enum xfway_client_resource resource;
+  uint64_t amount;
+
+  struct charge *pool; /* of a wl_buffer made from a wl_shm_pool */
+  uint32_t refs; /* of a pool: the pool object and each of its buffers */
+};
+
+struct client_usage
+{
+  struct xfway_client_usage public;
+  struct xfway_client_accounting *accounting;
+  struct wl_list link; /* xfway_client_accounting::clients */
+  struct wl_listener destroy_listener;
+  struct wl_listener resource_created_listener;
+  struct wl_list charges;
+
+  /* resources over their limit, logged already */
+  uint32_t over_limit;
+
+  /* from wl_shm requests seen by the logger, for the object they create */
+  uint32_t pending_pool_id;
+  int32_t pending_pool_size;
+  uint32_t pending_buffer_id;
+  struct charge *pending_buffer_pool;
+};
+
+struct xfway_client_accounting
+{
+  struct wl_display *display;
+  struct wl_list clients;
+  struct wl_listener client_created_listener;
+  struct wl_protocol_logger *logger;
+
+  uint64_t limits[XFWAY_CLIENT_RESOURCE_COUNT];
+  bool disconnect;
+};
+
+static const char *resource_names[XFWAY_CLIENT_RESOURCE_COUNT] =
+{
+  [XFWAY_CLIENT_SURFACES] = "surfaces",
+  [XFWAY_CLIENT_VIEWS] = "views",
+  [XFWAY_CLIENT_SHM_BYTES] = "shm_bytes",
+  [XFWAY_CLIENT_BUFFERS] = "buffers",
+  [XFWAY_CLIENT_LAYER_SURFACES] = "layer_surfaces",
+  [XFWAY_CLIENT_TOPLEVEL_RESOURCES] = "toplevel_resources",
+  [XFWAY_CLIENT_SWITCHER_WINDOWS] = "switcher_windows",
+};
+
+/* Objects counted as they are created, by interface name so this does
+ * not depend on the generated protocol code. wl_shm_pool is handled
+ * apart. */
+static const struct
+{
+  const char *interface;
+  enum xfway_client_resource resource;
+} counted_interfaces[] = {
+  { "wl_surface", XFWAY_CLIENT_SURFACES },
+  { "wl_buffer", XFWAY_CLIENT_BUFFERS },
+  { "zwlr_foreign_toplevel_manager_v1", XFWAY_CLIENT_TOPLEVEL_RESOURCES },
+  { "zwlr_foreign_toplevel_handle_v1", XFWAY_CLIENT_TOPLEVEL_RESOURCES },
+  { "zww_window_switcher_window_v1", XFWAY_CLIENT_SWITCHER_WINDOWS },
+};
+
+const char *
+xfway_client_resource_get_name (enum xfway_client_resource resource)
+{
+  if (resource >= XFWAY_CLIENT_RESOURCE_COUNT)
+    return NULL;
+
+  return resource_names[resource];
+}
+
+static void
+usage_check_limit (struct client_usage        *usage,
+                   enum xfway_client_resource  resource)
+{
+  struct xfway_client_accounting *accounting = usage->accounting;
+  uint64_t limit = accounting->limits[resource];
+  uint64_t count = usage->public.counts[resource];
+  uint32_t bit = 1u << resource;
+
+  if (limit == 0 || count <= limit)
+    {
+      usage->over_limit &= ~bit;
+      return;
+    }
+
+  if (usage->over_limit & bit)
+    return;
+  usage->over_limit |= bit;
+
+  xfway_log_warning (XFWAY_LOG_SCOPE_CORE,
+                     "client %d (%s) holds %llu %s, over its limit of %llu%s\n",
+                     (int) usage->public.pid, usage->public.name,
+                     (unsigned long long) count, resource_names[resource],
+                     (unsigned long long) limit,
+                     accounting->disconnect ? ", disconnecting it" : "");
+
+  /* the client is destroyed once libwayland is done with it */
+  if (accounting->disconnect)
+    wl_client_post_implementation_error (usage->public.client,
+                                         "over the compositor's limit of %llu %s",
+                                         (unsigned long long) limit,
+                                         resource_names[resource]);
+}
+
+static void
+usage_add (struct client_usage        *usage,
+           enum xfway_client_resource  resource,
+           int64_t                     count)
+{
+  if (count < 0 && (uint64_t) -count > usage->public.counts[resource])
+    usage->public.counts[resource] = 0;
+  else
+    usage->public.counts[resource] += count;
+
+  usage_check_limit (usage, resource);
+}
+
+static void
+charge_free (struct charge *charge)
+{
+  if (charge->usage)
+    {
+      usage_add (charge->usage, charge->resource, -(int64_t) charge->amount);
+      wl_list_remove (&charge->link);
+      if (charge->usage->pending_buffer_pool == charge)
+        charge->usage->pending_buffer_pool = NULL;
+    }
+  free (charge);
+}
+
+static void
+pool_unref (struct charge *pool)
+{
+  if (--pool->refs == 0)
+    charge_free (pool);
+}
+
+static void
+charge_destroyed (struct wl_listener *listener,
+                  void               *data)
+{
+  struct charge *charge = wl_container_of (listener, charge, destroy_listener);
+  struct charge *pool = charge->pool;
+
+  wl_list_remove (&charge->destroy_listener.link);
+
+  if (charge->resource == XFWAY_CLIENT_SHM_BYTES)
+    {
+      pool_unref (charge);
+      return;
+    }
+
+  charge_free (charge);
+  if (pool)
+    pool_unref (pool);
+}
+
+static struct charge *
+charge_create (struct client_usage        *usage,
+               struct wl_resource         *object,
+               enum xfway_client_resource  resource,
+               uint64_t                    amount)
+{
+  struct charge *charge = calloc (1, sizeof (struct charge));
+
+  if (charge == NULL)
+    return NULL;
+
+  charge->usage = usage;
+  wl_list_insert (usage->charges.prev, &charge->link);
+  charge->resource = resource;
+  charge->amount = amount;
+  charge->destroy_listener.notify = charge_destroyed;
+  wl_resource_add_destroy_listener (object, &charge->destroy_listener);
+
+  usage_add (usage, resource, amount);
+
+  return charge;
+}
+
+static struct charge *
+charge_from_object (struct wl_resource *object)
+{
+  struct wl_listener *listener;
+  struct charge *charge;
+
+  listener = wl_resource_get_destroy_listener (object, charge_destroyed);
+  if (listener == NULL)
+    return NULL;
+
+  return wl_container_of (listener, charge, destroy_listener);
+}
+
+static void
+handle_resource_created (struct wl_listener *listener,
+                         void               *data)
+{
+  struct client_usage *usage = wl_container_of (listener, usage, resource_created_listener);
+  struct wl_resource *object = data;
+  const char *interface = wl_resource_get_class (object);
+  uint32_t id = wl_resource_get_id (object);
+  struct charge *charge;
+  unsigned int i;
+
+  if (strcmp (interface, "wl_shm_pool") == 0)
+    {
+      charge = charge_create (usage, object, XFWAY_CLIENT_SHM_BYTES,
+                              id == usage->pending_pool_id ? usage->pending_pool_size : 0);
+      if (charge)
+        charge->refs = 1;
+      usage->pending_pool_id = 0;
+      return;
+    }
+
+  for (i = 0; i < sizeof (counted_interfaces) / sizeof (counted_interfaces[0]); i++)
+    {
+      if (strcmp (interface, counted_interfaces[i].interface) == 0)
+        break;
+    }
+  if (i == sizeof (counted_interfaces) / sizeof (counted_interfaces[0]))
+    return;
+
+  charge = charge_create (usage, object, counted_interfaces[i].resource, 1);
+
+  /* a buffer keeps the pool it was made from mapped */
+  if (charge && counted_interfaces[i].resource == XFWAY_CLIENT_BUFFERS &&
+      id == usage->pending_buffer_id && usage->pending_buffer_pool)
+    {
+      charge->pool = usage->pending_buffer_pool;
+      charge->pool->refs++;
+    }
+  usage->pending_buffer_id = 0;
+  usage->pending_buffer_pool = NULL;
+}
+
+static void
+usage_destroy (struct client_usage *usage)
+{
+  struct charge *charge, *tmp;
+
+  /* charges go with their objects, which outlive this */
+  wl_list_for_each_safe (charge, tmp, &usage->charges, link)
+    {
+      charge->usage = NULL;
+      wl_list_remove (&charge->link);
+    }
+
+  wl_list_remove (&usage->link);
+  wl_list_remove (&usage->destroy_listener.link);
+  wl_list_remove (&usage->resource_created_listener.link);
+  free (usage);
+}
+
+static void
+handle_client_destroyed (struct wl_listener *listener,
+                         void               *data)
+{
+  struct client_usage *usage = wl_container_of (listener, usage, destroy_listener);
+
+  usage_destroy (usage);
+}
+
+static void
+handle_client_created (struct wl_listener *listener,
+                       void               *data)
+{
+  struct xfway_client_accounting *accounting =
+    wl_container_of (listener, accounting, client_created_listener);
+  struct wl_client *client = data;
+  struct client_usage *usage = calloc (1, sizeof (struct client_usage));
+
+  if (usage == NULL)
+    return;
+
+  usage->accounting = accounting;
+  usage->public.client = client;
+  wl_client_get_credentials (client, &usage->public.pid, NULL, NULL);
+  xfway_client_get_name (usage->public.pid, usage->public.name,
+                         sizeof (usage->public.name));
+  wl_list_init (&usage->charges);
+  wl_list_insert (accounting->clients.prev, &usage->link);
+
+  usage->destroy_listener.notify = handle_client_destroyed;
+  wl_client_add_destroy_listener (client, &usage->destroy_listener);
+  usage->resource_created_listener.notify = handle_resource_created;
+  wl_client_add_resource_created_listener (client, &usage->resource_created_listener);
+}
+
+static struct client_usage *
+usage_from_client (struct wl_client *client)
+{
+  struct wl_listener *listener;
+  struct client_usage *usage;
+
+  listener = wl_client_get_destroy_listener (client, handle_client_destroyed);
+  if (listener == NULL)
+    return NULL;
+
+  return wl_container_of (listener, usage, destroy_listener);
+}
+
+/* Notes the size of a pool and the pool of a buffer before the request
+ * creating it is dispatched; handle_resource_created picks them up. */
+static void
+protocol_logger (void                                     *user_data,
+                 enum wl_protocol_logger_type              direction,
+                 const struct wl_protocol_logger_message  *message)
+{
+  struct client_usage *usage;
+  struct charge *pool;
+  int32_t size;
+
+  if (direction != WL_PROTOCOL_LOGGER_REQUEST)
+    return;
+
+  if (message->message == &wl_shm_interface.methods[SHM_CREATE_POOL])
+    {
+      usage = usage_from_client (wl_resource_get_client (message->resource));
+      if (usage == NULL)
+        return;
+      usage->pending_pool_id = message->arguments[0].n;
+      usage->pending_pool_size = message->arguments[2].i > 0 ? message->arguments[2].i : 0;
+    }
+  else if (message->message == &wl_shm_pool_interface.methods[SHM_POOL_CREATE_BUFFER])
+    {
+      usage = usage_from_client (wl_resource_get_client (message->resource));
+      if (usage == NULL)
+        return;
+      usage->pending_buffer_id = message->arguments[0].n;
+      usage->pending_buffer_pool = charge_from_object (message->resource);
+    }
+  else if (message->message == &wl_shm_pool_interface.methods[SHM_POOL_RESIZE])
+    {
+      /* libwayland only lets pools grow */
+      pool = charge_from_object (message->resource);
+      size = message->arguments[0].i;
+      if (pool == NULL || size <= 0 || (uint64_t) size <= pool->amount)
+        return;
+
+      if (pool->usage)
+        usage_add (pool->usage, XFWAY_CLIENT_SHM_BYTES, size - pool->amount);
+      pool->amount = size;
+    }
+}
+
+struct xfway_client_accounting *
+xfway_client_accounting_create (struct wl_display *display)
+{
+  struct xfway_client_accounting *accounting =
+    calloc (1, sizeof (struct xfway_client_accounting));
+  struct wl_client *client;
+
+  if (accounting == NULL)
+    return NULL;
+
+  accounting->display = display;
+  wl_list_init (&accounting->clients);
+
+  accounting->client_created_listener.notify = handle_client_created;
+  wl_display_add_client_created_listener (display, &accounting->client_created_listener);
+
+  /* clients from before, whose existing objects go uncounted */
+  wl_client_for_each (client, wl_display_get_client_list (display))
+    handle_client_created (&accounting->client_created_listener, client);
+
+  accounting->logger = wl_display_add_protocol_logger (display, protocol_logger, accounting);
+
+  return accounting;
+}
+
+void
+xfway_client_accounting_destroy (struct xfway_client_accounting *accounting)
+{
+  struct client_usage *usage, *tmp;
+
+  if (accounting->logger)
+    wl_protocol_logger_destroy (accounting->logger);
+  wl_list_remove (&accounting->client_created_listener.link);
+
+  wl_list_for_each_safe (usage, tmp, &accounting->clients, link)
+    usage_destroy (usage);
+
+  free (accounting);
+}
+
+void
+xfway_client_accounting_add (struct xfway_client_accounting *accounting,
+                             struct wl_client               *client,
+                             enum xfway_client_resource      resource,
+                             int64_t                         count)
+{
+  struct client_usage *usage;
+
+  if (accounting == NULL || client == NULL)
+    return;
+
+  usage = usage_from_client (client);
+  if (usage)
+    usage_add (usage, resource, count);
+}
+
+void
+xfway_client_accounting_set_limit (struct xfway_client_accounting *accounting,
+                                   enum xfway_client_resource      resource,
+                                   uint64_t                        limit)
+{
+  struct client_usage *usage;
+
+  accounting->limits[resource] = limit;
+
+  /* clients already over a new limit are told about now */
+  wl_list_for_each (usage, &accounting->clients, link)
+    usage_check_limit (usage, resource);
+}
+
+void
+xfway_client_accounting_set_disconnect (struct xfway_client_accounting *accounting,
+                                        bool                            disconnect)
+{
+  accounting->disconnect = disconnect;
+}
+
+const struct xfway_client_usage *
+xfway_client_accounting_get_usage (struct xfway_client_accounting *accounting,
+                                   struct wl_client               *client)
+{
+  struct client_usage *usage = usage_from_client (client);
+
+  return usage ? &usage->public : NULL;
+}
+
+void
+xfway_client_accounting_for_each (struct xfway_client_accounting *accounting,
+                                  xfway_client_usage_func_t       func,
+                                  void                           *data)
+{
+  struct client_usage *usage, *tmp;
+
+  wl_list_for_each_safe (usage, tmp, &accounting->clients, link)
+    func (&usage->public, data);
+}
+
+void
+xfway_client_accounting_dump (struct xfway_client_accounting *accounting,
+                              FILE                           *f)
+{
+  struct client_usage *usage;
+  int i;
+
+  fprintf (f, "%-8s %-16s", "pid", "client");
+  for (i = 0; i < XFWAY_CLIENT_RESOURCE_COUNT; i++)
+    fprintf (f, " %18s", resource_names[i]);
+  fputc ('\n', f);
+
+  fprintf (f, "%-8s %-16s", "", "limits");
+  for (i = 0; i < XFWAY_CLIENT_RESOURCE_COUNT; i++)
+    fprintf (f, " %18llu", (unsigned long long) accounting->limits[i]);
+  fputc ('\n', f);
+
+  wl_list_for_each (usage, &accounting->clients, link)
+    {
+      fprintf (f, "%-8d %-16s", (int) usage->public.pid, usage->public.name);
+      for (i = 0; i < XFWAY_CLIENT_RESOURCE_COUNT; i++)
+        fprintf (f, " %18llu", (unsigned long long) usage->public.counts[i]);
+      fputc ('\n', f);
+    }
+}
@@ -0,0 +1,102 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __CLIENT_ACCOUNTING_H__
+#define __CLIENT_ACCOUNTING_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <wayland-server.h>
+
+/* What every client holds in the compositor, kept as running totals so
+ * finding the client that bloats it takes no scan.
+ *
+ * Protocol objects are counted as libwayland creates and destroys them:
+ * wl_surface, wl_buffer, foreign toplevel and window switcher objects,
+ * and the bytes of every wl_shm_pool, which stay mapped until the pool
+ * and all the buffers made from it are gone. Pool sizes come from a
+ * protocol logger that looks at wl_shm requests only. The shell reports
+ * the views and layer surfaces it makes for a client itself.
+ *
+ * A resource may have a soft limit. A client going over it is logged
+ * once, and disconnected if set so; it may go over again once it is back
+ * under the limit. */
+
+enum xfway_client_resource
+{
+  XFWAY_CLIENT_SURFACES,
+  XFWAY_CLIENT_VIEWS,
+  XFWAY_CLIENT_SHM_BYTES,
+  XFWAY_CLIENT_BUFFERS, /* wl_buffers not yet destroyed, of any kind */
+  XFWAY_CLIENT_LAYER_SURFACES,
+  XFWAY_CLIENT_TOPLEVEL_RESOURCES, /* foreign toplevel manager and handles */
+  XFWAY_CLIENT_SWITCHER_WINDOWS,
+  XFWAY_CLIENT_RESOURCE_COUNT
+};
+
+struct xfway_client_accounting;
+
+struct xfway_client_usage
+{
+  struct wl_client *client;
+  pid_t pid;
+  char name[16];
+  uint64_t counts[XFWAY_CLIENT_RESOURCE_COUNT];
+};
+
+typedef void (*xfway_client_usage_func_t) (const struct xfway_client_usage *usage,
+                                           void                            *data);
+
+struct xfway_client_accounting *xfway_client_accounting_create (struct wl_display *display);
+
+void xfway_client_accounting_destroy (struct xfway_client_accounting *accounting);
+
+/* For what the compositor makes on behalf of client, count may be
+ * negative. Does nothing for a client being destroyed. */
+void xfway_client_accounting_add (struct xfway_client_accounting *accounting,
+                                  struct wl_client               *client,
+                                  enum xfway_client_resource      resource,
+                                  int64_t                         count);
+
+/* 0 for no limit */
+void xfway_client_accounting_set_limit (struct xfway_client_accounting *accounting,
+                                        enum xfway_client_resource      resource,
+                                        uint64_t                        limit);
+
+/* Disconnect clients going over a limit rather than only logging them */
+void xfway_client_accounting_set_disconnect (struct xfway_client_accounting *accounting,
+                                             bool                            disconnect);
+
+/* NULL for a client being destroyed */
+const struct xfway_client_usage *
+xfway_client_accounting_get_usage (struct xfway_client_accounting *accounting,
+                                   struct wl_client               *client);
+
+/* Clients from the oldest */
+void xfway_client_accounting_for_each (struct xfway_client_accounting *accounting,
+                                       xfway_client_usage_func_t       func,
+                                       void                           *data);
+
+/* Every client with its counts and the limits, as text */
+void xfway_client_accounting_dump (struct xfway_client_accounting *accounting,
+                                   FILE                           *f);
+
+/* "surfaces", "shm_bytes" and so on */
+const char *xfway_client_resource_get_name (enum xfway_client_resource resource);
+
+#endif /* __CLIENT_ACCOUNTING_H__ */
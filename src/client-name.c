@@ -0,0 +1,49 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "client-name.h"
+
+void
+xfway_client_get_name (pid_t   pid,
+                       char   *name,
+                       size_t  size)
+{
+  char path[64];
+  ssize_t len;
+  int fd;
+
+  if (size == 0)
+    return;
+  name[0] = '\0';
+
+  snprintf (path, sizeof (path), "/proc/%d/comm", (int) pid);
+  fd = open (path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+
+  len = read (fd, name, size - 1);
+  close (fd);
+  if (len <= 0)
+    return;
+
+  name[len] = '\0';
+  name[strcspn (name, "\n")] = '\0';
+}
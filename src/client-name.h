@@ -0,0 +1,30 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __CLIENT_NAME_H__
+#define __CLIENT_NAME_H__
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* The command name of pid from /proc/<pid>/comm, without the newline and
+ * truncated to size. Empty if it cannot be read. The kernel keeps 15
+ * bytes of it, so 16 is enough for size. */
+void xfway_client_get_name (pid_t   pid,
+                            char   *name,
+                            size_t  size);
+
+#endif /* __CLIENT_NAME_H__ */
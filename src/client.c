@@ -72,6 +72,7 @@ clientFree (Client *c)
 {
     g_return_if_fail (c != NULL);
 
+    g_slist_free (c->monitors);
     g_free (c);
 }
 
@@ -82,3 +83,25 @@ clientUnframe (Client *c, gboolean remap)
 
   clientFree (c);
 }
+
+void
+clientEnterMonitor (Client *c, const MonitorInfo *info)
+{
+    gpointer name = GUINT_TO_POINTER (info->name);
+
+    g_return_if_fail (c != NULL);
+
+    if (!g_slist_find (c->monitors, name))
+    {
+        c->monitors = g_slist_prepend (c->monitors, name);
+    }
+}
+
+/* name is the registry name of the output */
+void
+clientLeaveMonitor (Client *c, guint32 name)
+{
+    g_return_if_fail (c != NULL);
+
+    c->monitors = g_slist_remove (c->monitors, GUINT_TO_POINTER (name));
+}
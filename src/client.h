@@ -267,11 +267,22 @@ struct _Client
     ScreenInfo *screen_info;
 
     struct zwlr_foreign_toplevel_handle_v1 *toplevel_handle;
+    /* compositor side id, from xfway_shell.toplevel_id */
+    guint32 id;
 
     Client *next;
     Client *prev;
 
+    /* links in ScreenInfo::windows_stack and windows_mru, data is the client */
+    GList stack_link;
+    GList mru_link;
+
     gchar *name;
+    gchar *app_id;
+
+    /* registry names of the outputs the toplevel is on, from the
+     * output_enter and output_leave events */
+    GSList *monitors;
 };
 
 
@@ -285,5 +296,9 @@ Client                  *clientFrame                            (ScreenInfo *,
                                                                  gboolean);
 void                     clientUnframe                          (Client *,
                                                                  gboolean);
+void                     clientEnterMonitor                     (Client *,
+                                                                 const MonitorInfo *);
+void                     clientLeaveMonitor                     (Client *,
+                                                                 guint32);
 
 #endif /* INC_CLIENT_H */
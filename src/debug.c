@@ -0,0 +1,486 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <protocol/xfway-debug-server-protocol.h>
+
+#include "client-name.h"
+#include "debug.h"
+
+/* An output's presentation interval between these many refresh periods
+ * counts as dropped frames; longer ones are taken for the output having
+ * had nothing to show. */
+#define DROPPED_MIN_PERIODS_X2 3
+#define DROPPED_MAX_PERIODS 4
+
+struct debug_output
+{
+  struct xfway_debug *debug;
+  struct weston_output *output;
+  struct wl_list link; /* xfway_debug::outputs */
+  struct wl_listener frame_listener;
+  struct wl_listener destroy_listener;
+
+  uint64_t repaints;
+  uint64_t dropped_frames;
+  struct timespec last_frame_time;
+};
+
+struct debug_client
+{
+  struct xfway_debug *debug;
+  struct wl_list link; /* xfway_debug::clients */
+  struct wl_listener destroy_listener;
+  pid_t pid;
+  char name[16];
+
+  uint64_t commits;
+};
+
+struct xfway_debug
+{
+  struct weston_compositor *compositor;
+  struct wl_global *global;
+  struct wl_list resources;
+
+  struct wl_list outputs;
+  struct wl_listener output_created_listener;
+
+  /* only clients that committed while the global was on */
+  struct wl_list clients;
+
+  struct wl_signal snapshot_signal;
+};
+
+struct xfway_debug_snapshot
+{
+  struct wl_resource *resource;
+};
+
+static const struct
+{
+  uint32_t position;
+  const char *name;
+} layer_names[] = {
+  /* WESTON_LAYER_POSITION_HIDDEN, which xfway does not use otherwise */
+  { WESTON_LAYER_POSITION_BACKGROUND - 1, "black-background" },
+  { WESTON_LAYER_POSITION_BACKGROUND, "background" },
+  { WESTON_LAYER_POSITION_BOTTOM_UI, "bottom" },
+  { WESTON_LAYER_POSITION_NORMAL, "normal" },
+  { WESTON_LAYER_POSITION_UI, "top" },
+  { WESTON_LAYER_POSITION_FULLSCREEN, "fullscreen" },
+  { WESTON_LAYER_POSITION_TOP_UI, "top-ui" },
+  { WESTON_LAYER_POSITION_LOCK, "overlay" },
+  { WESTON_LAYER_POSITION_CURSOR, "cursor" },
+  { WESTON_LAYER_POSITION_FADE, "fade" },
+};
+
+static uint64_t
+timespec_to_ns (const struct timespec *ts)
+{
+  return (uint64_t) ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static void
+debug_output_frame (struct wl_listener *listener,
+                    void               *data)
+{
+  struct debug_output *dout = wl_container_of (listener, dout, frame_listener);
+  struct weston_output *output = dout->output;
+  uint64_t period, interval;
+
+  dout->repaints++;
+
+  /* frame_time is when the previous frame was presented, so successive
+   * repaints see successive presentations */
+  if (output->frame_time.tv_sec == dout->last_frame_time.tv_sec &&
+      output->frame_time.tv_nsec == dout->last_frame_time.tv_nsec)
+    return;
+
+  if (dout->last_frame_time.tv_sec != 0 &&
+      output->current_mode && output->current_mode->refresh > 0)
+    {
+      period = 1000000000000ull / output->current_mode->refresh;
+      interval = timespec_to_ns (&output->frame_time) -
+                 timespec_to_ns (&dout->last_frame_time);
+
+      if (interval * 2 >= period * DROPPED_MIN_PERIODS_X2 &&
+          interval < period * DROPPED_MAX_PERIODS)
+        dout->dropped_frames += (interval + period / 2) / period - 1;
+    }
+
+  dout->last_frame_time = output->frame_time;
+}
+
+static void
+debug_output_destroy (struct debug_output *dout)
+{
+  wl_list_remove (&dout->link);
+  wl_list_remove (&dout->frame_listener.link);
+  wl_list_remove (&dout->destroy_listener.link);
+  free (dout);
+}
+
+static void
+debug_output_destroyed (struct wl_listener *listener,
+                        void               *data)
+{
+  struct debug_output *dout = wl_container_of (listener, dout, destroy_listener);
+
+  debug_output_destroy (dout);
+}
+
+static void
+debug_output_create (struct xfway_debug   *debug,
+                     struct weston_output *output)
+{
+  struct debug_output *dout = calloc (1, sizeof (struct debug_output));
+
+  if (dout == NULL)
+    return;
+
+  dout->debug = debug;
+  dout->output = output;
+  wl_list_insert (debug->outputs.prev, &dout->link);
+
+  dout->frame_listener.notify = debug_output_frame;
+  wl_signal_add (&output->frame_signal, &dout->frame_listener);
+  dout->destroy_listener.notify = debug_output_destroyed;
+  wl_signal_add (&output->destroy_signal, &dout->destroy_listener);
+}
+
+static void
+handle_output_created (struct wl_listener *listener,
+                       void               *data)
+{
+  struct xfway_debug *debug = wl_container_of (listener, debug, output_created_listener);
+
+  debug_output_create (debug, data);
+}
+
+static void
+debug_client_destroy (struct debug_client *dc)
+{
+  wl_list_remove (&dc->link);
+  wl_list_remove (&dc->destroy_listener.link);
+  free (dc);
+}
+
+static void
+debug_client_destroyed (struct wl_listener *listener,
+                        void               *data)
+{
+  struct debug_client *dc = wl_container_of (listener, dc, destroy_listener);
+
+  debug_client_destroy (dc);
+}
+
+static struct debug_client *
+debug_client_get (struct xfway_debug *debug,
+                  struct wl_client   *client)
+{
+  struct wl_listener *listener;
+  struct debug_client *dc;
+
+  listener = wl_client_get_destroy_listener (client, debug_client_destroyed);
+  if (listener)
+    return wl_container_of (listener, dc, destroy_listener);
+
+  dc = calloc (1, sizeof (struct debug_client));
+  if (dc == NULL)
+    return NULL;
+
+  dc->debug = debug;
+  wl_client_get_credentials (client, &dc->pid, NULL, NULL);
+  xfway_client_get_name (dc->pid, dc->name, sizeof (dc->name));
+  wl_list_insert (debug->clients.prev, &dc->link);
+
+  dc->destroy_listener.notify = debug_client_destroyed;
+  wl_client_add_destroy_listener (client, &dc->destroy_listener);
+
+  return dc;
+}
+
+void
+xfway_debug_surface_committed (struct xfway_debug    *debug,
+                               struct weston_surface *surface)
+{
+  struct debug_client *dc;
+
+  if (debug == NULL || debug->global == NULL || surface->resource == NULL)
+    return;
+
+  dc = debug_client_get (debug, wl_resource_get_client (surface->resource));
+  if (dc)
+    dc->commits++;
+}
+
+void
+xfway_debug_snapshot_add (struct xfway_debug_snapshot *snapshot,
+                          const char                  *object,
+                          const char                  *name,
+                          uint64_t                     value)
+{
+  xfway_debug_snapshot_send_counter (snapshot->resource, object, name,
+                                     value >> 32, value & 0xffffffff);
+}
+
+static const char *
+layer_get_name (struct weston_layer *layer,
+                char                *buf,
+                size_t               size)
+{
+  unsigned int i;
+
+  for (i = 0; i < sizeof (layer_names) / sizeof (layer_names[0]); i++)
+    {
+      if (layer_names[i].position == layer->position)
+        return layer_names[i].name;
+    }
+
+  snprintf (buf, size, "%08x", layer->position);
+
+  return buf;
+}
+
+static void
+add_layer_counters (struct xfway_debug          *debug,
+                    struct xfway_debug_snapshot *snapshot)
+{
+  struct weston_layer *layer;
+  struct weston_view *view;
+  uint64_t views, mapped;
+  char object[64], buf[16];
+
+  wl_list_for_each (layer, &debug->compositor->layer_list, link)
+    {
+      views = mapped = 0;
+      wl_list_for_each (view, &layer->view_list.link, layer_link.link)
+        {
+          views++;
+          if (weston_view_is_mapped (view))
+            mapped++;
+        }
+
+      snprintf (object, sizeof (object), "layer %s",
+                layer_get_name (layer, buf, sizeof (buf)));
+      xfway_debug_snapshot_add (snapshot, object, "views", views);
+      xfway_debug_snapshot_add (snapshot, object, "mapped_views", mapped);
+    }
+}
+
+static void
+add_output_counters (struct xfway_debug          *debug,
+                     struct xfway_debug_snapshot *snapshot)
+{
+  struct debug_output *dout;
+  char object[64];
+
+  wl_list_for_each (dout, &debug->outputs, link)
+    {
+      snprintf (object, sizeof (object), "output %s", dout->output->name);
+      xfway_debug_snapshot_add (snapshot, object, "repaints", dout->repaints);
+      xfway_debug_snapshot_add (snapshot, object, "dropped_frames", dout->dropped_frames);
+      if (dout->output->current_mode)
+        xfway_debug_snapshot_add (snapshot, object, "refresh_mhz",
+                                  dout->output->current_mode->refresh);
+    }
+}
+
+static void
+add_client_counters (struct xfway_debug          *debug,
+                     struct xfway_debug_snapshot *snapshot)
+{
+  struct debug_client *dc;
+  char object[64];
+
+  wl_list_for_each (dc, &debug->clients, link)
+    {
+      snprintf (object, sizeof (object), "client %d %s", (int) dc->pid, dc->name);
+      xfway_debug_snapshot_add (snapshot, object, "commits", dc->commits);
+    }
+}
+
+static void
+debug_handle_destroy (struct wl_client   *client,
+                      struct wl_resource *resource)
+{
+  wl_resource_destroy (resource);
+}
+
+static void
+debug_handle_get_counters (struct wl_client   *client,
+                           struct wl_resource *resource,
+                           uint32_t            id)
+{
+  struct xfway_debug *debug = wl_resource_get_user_data (resource);
+  struct xfway_debug_snapshot snapshot;
+  struct weston_output *output;
+  struct wl_client *c;
+  struct timespec now;
+  uint64_t time_ms, n;
+
+  snapshot.resource = wl_resource_create (client, &xfway_debug_snapshot_interface,
+                                          wl_resource_get_version (resource), id);
+  if (snapshot.resource == NULL)
+    {
+      wl_client_post_no_memory (client);
+      return;
+    }
+
+  /* withdrawn objects get an empty snapshot */
+  if (debug)
+    {
+      n = 0;
+      wl_list_for_each (output, &debug->compositor->output_list, link)
+        n++;
+      xfway_debug_snapshot_add (&snapshot, "compositor", "outputs", n);
+
+      n = 0;
+      wl_client_for_each (c, wl_display_get_client_list (debug->compositor->wl_display))
+        n++;
+      xfway_debug_snapshot_add (&snapshot, "compositor", "clients", n);
+
+      add_layer_counters (debug, &snapshot);
+      add_output_counters (debug, &snapshot);
+      add_client_counters (debug, &snapshot);
+
+      wl_signal_emit (&debug->snapshot_signal, &snapshot);
+    }
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  time_ms = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  xfway_debug_snapshot_send_done (snapshot.resource, time_ms >> 32, time_ms & 0xffffffff);
+  wl_resource_destroy (snapshot.resource);
+}
+
+static const struct xfway_debug_interface debug_implementation = {
+  .destroy = debug_handle_destroy,
+  .get_counters = debug_handle_get_counters,
+};
+
+static void
+debug_resource_destroy (struct wl_resource *resource)
+{
+  wl_list_remove (wl_resource_get_link (resource));
+}
+
+static void
+bind_debug (struct wl_client *client,
+            void             *data,
+            uint32_t          version,
+            uint32_t          id)
+{
+  struct xfway_debug *debug = data;
+  struct wl_resource *resource;
+
+  resource = wl_resource_create (client, &xfway_debug_interface, version, id);
+  if (resource == NULL)
+    {
+      wl_client_post_no_memory (client);
+      return;
+    }
+
+  wl_resource_set_implementation (resource, &debug_implementation,
+                                  debug, debug_resource_destroy);
+  wl_list_insert (&debug->resources, wl_resource_get_link (resource));
+}
+
+struct xfway_debug *
+xfway_debug_create (struct weston_compositor *compositor)
+{
+  struct xfway_debug *debug = calloc (1, sizeof (struct xfway_debug));
+  struct weston_output *output;
+
+  if (debug == NULL)
+    return NULL;
+
+  debug->compositor = compositor;
+  wl_list_init (&debug->resources);
+  wl_list_init (&debug->outputs);
+  wl_list_init (&debug->clients);
+  wl_signal_init (&debug->snapshot_signal);
+
+  wl_list_for_each (output, &compositor->output_list, link)
+    debug_output_create (debug, output);
+  debug->output_created_listener.notify = handle_output_created;
+  wl_signal_add (&compositor->output_created_signal, &debug->output_created_listener);
+
+  return debug;
+}
+
+void
+xfway_debug_set_enabled (struct xfway_debug *debug,
+                         bool                enabled)
+{
+  struct wl_resource *resource, *tmp;
+  struct debug_client *dc, *dc_tmp;
+
+  if (enabled == (debug->global != NULL))
+    return;
+
+  if (enabled)
+    {
+      debug->global = wl_global_create (debug->compositor->wl_display,
+                                        &xfway_debug_interface, 1,
+                                        debug, bind_debug);
+      return;
+    }
+
+  wl_global_destroy (debug->global);
+  debug->global = NULL;
+
+  wl_resource_for_each_safe (resource, tmp, &debug->resources)
+    {
+      wl_resource_set_user_data (resource, NULL);
+      wl_list_remove (wl_resource_get_link (resource));
+      wl_list_init (wl_resource_get_link (resource));
+    }
+
+  /* commits are only counted while on */
+  wl_list_for_each_safe (dc, dc_tmp, &debug->clients, link)
+    debug_client_destroy (dc);
+}
+
+bool
+xfway_debug_get_enabled (struct xfway_debug *debug)
+{
+  return debug->global != NULL;
+}
+
+struct wl_signal *
+xfway_debug_get_snapshot_signal (struct xfway_debug *debug)
+{
+  return &debug->snapshot_signal;
+}
+
+void
+xfway_debug_destroy (struct xfway_debug *debug)
+{
+  struct debug_output *dout, *tmp;
+
+  xfway_debug_set_enabled (debug, false);
+
+  wl_list_for_each_safe (dout, tmp, &debug->outputs, link)
+    debug_output_destroy (dout);
+  wl_list_remove (&debug->output_created_listener.link);
+
+  free (debug);
+}
@@ -0,0 +1,64 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __DEBUG_H__
+#define __DEBUG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server.h>
+#include <libweston/libweston.h>
+
+/* The xfway_debug global, from which xfway-debug reads live counters.
+ *
+ * The counters of the compositor as a whole, of its layers, outputs and
+ * clients are kept here. Other modules add their own to every snapshot
+ * from a listener on xfway_debug_get_snapshot_signal, which is emitted
+ * with a struct xfway_debug_snapshot * to pass to
+ * xfway_debug_snapshot_add.
+ *
+ * The global is off by default. Any client of the display may bind it
+ * while it is on, so it is meant for debugging sessions only. */
+
+struct xfway_debug;
+struct xfway_debug_snapshot;
+
+struct xfway_debug *xfway_debug_create (struct weston_compositor *compositor);
+
+void xfway_debug_destroy (struct xfway_debug *debug);
+
+/* Advertises or withdraws the global. Objects already bound stop
+ * reporting counters when it is withdrawn. */
+void xfway_debug_set_enabled (struct xfway_debug *debug,
+                              bool                enabled);
+
+bool xfway_debug_get_enabled (struct xfway_debug *debug);
+
+struct wl_signal *xfway_debug_get_snapshot_signal (struct xfway_debug *debug);
+
+/* object is "shell", "output HDMI-A-1" and the like, see
+ * protocol/xfway-debug.xml */
+void xfway_debug_snapshot_add (struct xfway_debug_snapshot *snapshot,
+                               const char                  *object,
+                               const char                  *name,
+                               uint64_t                     value);
+
+/* Counts a commit of surface against its client. Cheap enough for every
+ * commit, and does nothing while the global is off. */
+void xfway_debug_surface_committed (struct xfway_debug    *debug,
+                                    struct weston_surface *surface);
+
+#endif /* __DEBUG_H__ */
@@ -0,0 +1,203 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "glib-loop.h"
+
+struct xfway_glib_loop
+{
+  struct wl_event_loop *loop;
+  GMainContext *context;
+  struct wl_event_source *timer;
+
+  /* as returned by the last g_main_context_query */
+  GPollFD *fds;
+  int n_fds;
+  int alloc_fds;
+  gint max_priority;
+
+  /* one per entry of fds, rebuilt only when the set changes */
+  struct wl_event_source **sources;
+  GPollFD *watched;
+  int n_watched;
+};
+
+static int glib_loop_fd_ready (int fd, uint32_t mask, void *data);
+
+static uint32_t
+poll_to_mask (gushort events)
+{
+  uint32_t mask = 0;
+
+  if (events & G_IO_IN)
+    mask |= WL_EVENT_READABLE;
+  if (events & G_IO_OUT)
+    mask |= WL_EVENT_WRITABLE;
+
+  return mask;
+}
+
+static void
+glib_loop_unwatch (struct xfway_glib_loop *glib_loop)
+{
+  int i;
+
+  for (i = 0; i < glib_loop->n_watched; i++)
+    wl_event_source_remove (glib_loop->sources[i]);
+  glib_loop->n_watched = 0;
+}
+
+static void
+glib_loop_watch (struct xfway_glib_loop *glib_loop)
+{
+  int i;
+
+  if (glib_loop->n_watched == glib_loop->n_fds)
+    {
+      for (i = 0; i < glib_loop->n_fds; i++)
+        {
+          if (glib_loop->watched[i].fd != glib_loop->fds[i].fd ||
+              glib_loop->watched[i].events != glib_loop->fds[i].events)
+            break;
+        }
+      if (i == glib_loop->n_fds)
+        return;
+    }
+
+  glib_loop_unwatch (glib_loop);
+  glib_loop->sources = realloc (glib_loop->sources,
+                                glib_loop->alloc_fds * sizeof (*glib_loop->sources));
+  glib_loop->watched = realloc (glib_loop->watched,
+                                glib_loop->alloc_fds * sizeof (GPollFD));
+  for (i = 0; i < glib_loop->n_fds; i++)
+    {
+      glib_loop->sources[i] = wl_event_loop_add_fd (glib_loop->loop,
+                                                    glib_loop->fds[i].fd,
+                                                    poll_to_mask (glib_loop->fds[i].events),
+                                                    glib_loop_fd_ready, glib_loop);
+      glib_loop->watched[i] = glib_loop->fds[i];
+    }
+  glib_loop->n_watched = glib_loop->n_fds;
+}
+
+/* The first half of a GLib main loop iteration: after this the compositor
+ * polls in place of g_main_context_iteration. */
+static void
+glib_loop_prepare (struct xfway_glib_loop *glib_loop)
+{
+  gboolean ready;
+  gint timeout;
+  int n;
+
+  ready = g_main_context_prepare (glib_loop->context, &glib_loop->max_priority);
+  for (;;)
+    {
+      n = g_main_context_query (glib_loop->context, glib_loop->max_priority,
+                                &timeout, glib_loop->fds, glib_loop->alloc_fds);
+      if (n <= glib_loop->alloc_fds)
+        break;
+      glib_loop->alloc_fds = n;
+      glib_loop->fds = realloc (glib_loop->fds, n * sizeof (GPollFD));
+    }
+  glib_loop->n_fds = n;
+  glib_loop_watch (glib_loop);
+
+  /* 0 disarms the timer */
+  if (ready)
+    timeout = 1;
+  else if (timeout == 0)
+    timeout = 1;
+  else if (timeout < 0)
+    timeout = 0;
+  wl_event_source_timer_update (glib_loop->timer, timeout);
+}
+
+static void
+glib_loop_dispatch (struct xfway_glib_loop *glib_loop)
+{
+  int i;
+
+  for (i = 0; i < glib_loop->n_fds; i++)
+    glib_loop->fds[i].revents = 0;
+  if (glib_loop->n_fds > 0)
+    poll ((struct pollfd *) glib_loop->fds, glib_loop->n_fds, 0);
+
+  if (g_main_context_check (glib_loop->context, glib_loop->max_priority,
+                            glib_loop->fds, glib_loop->n_fds))
+    g_main_context_dispatch (glib_loop->context);
+
+  glib_loop_prepare (glib_loop);
+}
+
+static int
+glib_loop_fd_ready (int fd, uint32_t mask, void *data)
+{
+  glib_loop_dispatch (data);
+
+  return 0;
+}
+
+static int
+glib_loop_timeout (void *data)
+{
+  glib_loop_dispatch (data);
+
+  return 0;
+}
+
+struct xfway_glib_loop *
+xfway_glib_loop_create (struct wl_event_loop *loop)
+{
+  struct xfway_glib_loop *glib_loop;
+
+  glib_loop = calloc (1, sizeof (*glib_loop));
+  if (!glib_loop)
+    return NULL;
+
+  glib_loop->loop = loop;
+  glib_loop->context = g_main_context_ref (g_main_context_default ());
+  if (!g_main_context_acquire (glib_loop->context))
+    {
+      g_main_context_unref (glib_loop->context);
+      free (glib_loop);
+      return NULL;
+    }
+
+  glib_loop->timer = wl_event_loop_add_timer (loop, glib_loop_timeout, glib_loop);
+  glib_loop_prepare (glib_loop);
+
+  return glib_loop;
+}
+
+void
+xfway_glib_loop_destroy (struct xfway_glib_loop *glib_loop)
+{
+  if (!glib_loop)
+    return;
+
+  glib_loop_unwatch (glib_loop);
+  wl_event_source_remove (glib_loop->timer);
+  g_main_context_release (glib_loop->context);
+  g_main_context_unref (glib_loop->context);
+  free (glib_loop->sources);
+  free (glib_loop->watched);
+  free (glib_loop->fds);
+  free (glib_loop);
+}
@@ -0,0 +1,34 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __GLIB_LOOP_H__
+#define __GLIB_LOOP_H__
+
+#include <wayland-server.h>
+
+struct xfway_glib_loop;
+
+/* Dispatches the default GMainContext from the compositor's event loop,
+ * which is what delivers xfconf's property-changed signals.
+ *
+ * The context is acquired for good, so sources added from other threads
+ * wake it up. A source added from the compositor thread itself is only
+ * noticed the next time the context wakes up or times out. */
+struct xfway_glib_loop *xfway_glib_loop_create (struct wl_event_loop *loop);
+
+void xfway_glib_loop_destroy (struct xfway_glib_loop *glib_loop);
+
+#endif /* __GLIB_LOOP_H__ */
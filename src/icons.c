@@ -0,0 +1,636 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Icons for toplevels, looked up by app_id.
+ *
+ * The app_id is resolved to an icon through its .desktop file, falling
+ * back to using it as an icon name. The .desktop lookup and decoding
+ * happen on a worker thread, with GIO and GdkPixbuf only; finding the
+ * file in the icon theme goes through GtkIconTheme, which belongs to the
+ * main thread, in between. Until an icon is ready, iconCacheLookup
+ * returns NULL and the caller shows a default. Decoded icons stay in
+ * memory for the life of the process, so once a window has been seen its
+ * icon costs a hash lookup. They are also written to
+ * $XDG_CACHE_HOME/xfway/icons, keyed by theme, size and scale and checked
+ * against the mtime of the theme and of the .desktop file, so that a
+ * restarted shell maps them back in instead of decoding SVGs again. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gdesktopappinfo.h>
+#include <gtk/gtk.h>
+
+#include "icons.h"
+
+#define ICON_CACHE_FILE_MAGIC 0x49465758 /* "XWFI" */
+#define ICON_CACHE_FILE_VERSION 1
+
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    gint64 theme_mtime;
+    gint64 desktop_mtime;
+    gint32 width;
+    gint32 height;
+    gint32 stride;
+    gint32 scale;
+} IconCacheFileHeader;
+
+typedef struct
+{
+    /* NULL while pending, and when the app_id has no icon */
+    cairo_surface_t *surface;
+    gboolean pending;
+} IconCacheEntry;
+
+typedef struct
+{
+    IconCache *cache;
+    guint generation;
+    gchar *key;
+    gchar *app_id;
+    gint size;
+    gint scale;
+    gchar *theme;
+    gint64 theme_mtime;
+    gint64 desktop_mtime;
+    /* set on the worker, looked up in the theme on the main thread */
+    GIcon *gicon;
+    /* set on the main thread, loaded on the worker */
+    gchar *icon_path;
+    GdkPixbuf *pixbuf;
+    gboolean resolved;
+    cairo_surface_t *surface;
+} IconJob;
+
+struct _IconCache
+{
+    GdkScreen *gscr;
+    IconCacheReadyFunc ready;
+    gpointer ready_data;
+
+    GHashTable *entries; /* "app_id size@scale" -> IconCacheEntry */
+    GString *scratch;
+    /* bumped when the theme changes, results of older jobs are dropped */
+    guint generation;
+    GThreadPool *pool;
+
+    gchar *theme;
+    gint64 theme_mtime;
+    gchar *cache_dir;
+};
+
+static gint64
+getThemeMtime (const gchar *theme)
+{
+    const gchar * const *dirs;
+    gchar *path;
+    GStatBuf st;
+    gint64 mtime;
+    guint i;
+
+    mtime = 0;
+
+    path = g_build_filename (g_get_user_data_dir (), "icons", theme, "index.theme", NULL);
+    if (g_stat (path, &st) == 0)
+    {
+        mtime = MAX (mtime, (gint64) st.st_mtime);
+    }
+    g_free (path);
+
+    path = g_build_filename (g_get_home_dir (), ".icons", theme, "index.theme", NULL);
+    if (g_stat (path, &st) == 0)
+    {
+        mtime = MAX (mtime, (gint64) st.st_mtime);
+    }
+    g_free (path);
+
+    dirs = g_get_system_data_dirs ();
+    for (i = 0; dirs[i]; i++)
+    {
+        path = g_build_filename (dirs[i], "icons", theme, "index.theme", NULL);
+        if (g_stat (path, &st) == 0)
+        {
+            mtime = MAX (mtime, (gint64) st.st_mtime);
+        }
+        g_free (path);
+    }
+
+    return mtime;
+}
+
+static void
+iconCacheEntryFree (gpointer data)
+{
+    IconCacheEntry *entry = data;
+
+    if (entry->surface)
+    {
+        cairo_surface_destroy (entry->surface);
+    }
+    g_free (entry);
+}
+
+static void
+iconJobFree (IconJob *job)
+{
+    if (job->surface)
+    {
+        cairo_surface_destroy (job->surface);
+    }
+    if (job->gicon)
+    {
+        g_object_unref (job->gicon);
+    }
+    if (job->pixbuf)
+    {
+        g_object_unref (job->pixbuf);
+    }
+    g_free (job->icon_path);
+    g_free (job->key);
+    g_free (job->app_id);
+    g_free (job->theme);
+    g_free (job);
+}
+
+/* Runs on the worker thread from here down to iconJobRun */
+
+static GDesktopAppInfo *
+findDesktopAppInfo (const gchar *app_id)
+{
+    GDesktopAppInfo *info;
+    const gchar *last;
+    gchar *lower, *id;
+
+    id = g_strconcat (app_id, ".desktop", NULL);
+    info = g_desktop_app_info_new (id);
+    g_free (id);
+    if (info)
+    {
+        return info;
+    }
+
+    lower = g_ascii_strdown (app_id, -1);
+    id = g_strconcat (lower, ".desktop", NULL);
+    info = g_desktop_app_info_new (id);
+    g_free (id);
+    g_free (lower);
+    if (info)
+    {
+        return info;
+    }
+
+    /* org.example.App might be installed as app.desktop */
+    last = strrchr (app_id, '.');
+    if (last && last[1])
+    {
+        lower = g_ascii_strdown (last + 1, -1);
+        id = g_strconcat (lower, ".desktop", NULL);
+        info = g_desktop_app_info_new (id);
+        g_free (id);
+        g_free (lower);
+    }
+
+    return info;
+}
+
+static gchar *
+getCacheFilename (IconCache *cache, IconJob *job)
+{
+    gchar *checksum, *name, *path;
+
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, job->app_id, -1);
+    name = g_strdup_printf ("%s-%d@%d", checksum, job->size, job->scale);
+    path = g_build_filename (cache->cache_dir, job->theme, name, NULL);
+    g_free (name);
+    g_free (checksum);
+
+    return path;
+}
+
+static cairo_surface_t *
+readCacheFile (const gchar *filename, IconJob *job)
+{
+    const IconCacheFileHeader *header;
+    cairo_surface_t *surface;
+    struct stat st;
+    guchar *map, *dst;
+    gint fd, y, dst_stride;
+
+    fd = open (filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat (fd, &st) < 0 || st.st_size < (off_t) sizeof (IconCacheFileHeader))
+    {
+        close (fd);
+        return NULL;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    surface = NULL;
+    header = (const IconCacheFileHeader *) map;
+    if (header->magic == ICON_CACHE_FILE_MAGIC &&
+        header->version == ICON_CACHE_FILE_VERSION &&
+        header->theme_mtime == job->theme_mtime &&
+        header->desktop_mtime == job->desktop_mtime &&
+        header->scale == job->scale &&
+        header->width > 0 && header->height > 0 &&
+        header->stride >= header->width * 4 &&
+        (gint64) st.st_size >= (gint64) sizeof (IconCacheFileHeader) +
+                               (gint64) header->stride * header->height)
+    {
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                              header->width, header->height);
+        dst = cairo_image_surface_get_data (surface);
+        dst_stride = cairo_image_surface_get_stride (surface);
+        for (y = 0; y < header->height; y++)
+        {
+            memcpy (dst + (gsize) y * dst_stride,
+                    map + sizeof (IconCacheFileHeader) + (gsize) y * header->stride,
+                    header->width * 4);
+        }
+        cairo_surface_mark_dirty (surface);
+        cairo_surface_set_device_scale (surface, job->scale, job->scale);
+    }
+
+    munmap (map, st.st_size);
+
+    return surface;
+}
+
+static void
+writeCacheFile (const gchar *filename, IconJob *job, cairo_surface_t *surface)
+{
+    IconCacheFileHeader header;
+    gchar *dirname, *contents;
+    gsize size;
+
+    if (cairo_image_surface_get_format (surface) != CAIRO_FORMAT_ARGB32)
+    {
+        return;
+    }
+
+    cairo_surface_flush (surface);
+    header.magic = ICON_CACHE_FILE_MAGIC;
+    header.version = ICON_CACHE_FILE_VERSION;
+    header.theme_mtime = job->theme_mtime;
+    header.desktop_mtime = job->desktop_mtime;
+    header.width = cairo_image_surface_get_width (surface);
+    header.height = cairo_image_surface_get_height (surface);
+    header.stride = cairo_image_surface_get_stride (surface);
+    header.scale = job->scale;
+
+    size = sizeof (header) + (gsize) header.stride * header.height;
+    contents = g_malloc (size);
+    memcpy (contents, &header, sizeof (header));
+    memcpy (contents + sizeof (header), cairo_image_surface_get_data (surface),
+            (gsize) header.stride * header.height);
+
+    dirname = g_path_get_dirname (filename);
+    if (g_mkdir_with_parents (dirname, 0700) == 0)
+    {
+        /* writes a temporary file and renames it over */
+        g_file_set_contents (filename, contents, size, NULL);
+    }
+    g_free (dirname);
+    g_free (contents);
+}
+
+/* What gdk_cairo_set_source_pixbuf does, without GDK */
+static cairo_surface_t *
+pixbufToSurface (GdkPixbuf *pixbuf, gint scale)
+{
+    cairo_surface_t *surface;
+    const guchar *src, *p;
+    guchar *dst;
+    guint32 *q;
+    gint width, height, src_stride, dst_stride, channels, x, y;
+    guint a;
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    channels = gdk_pixbuf_get_n_channels (pixbuf);
+    if (gdk_pixbuf_get_bits_per_sample (pixbuf) != 8 || channels < 3)
+    {
+        return NULL;
+    }
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    src = gdk_pixbuf_read_pixels (pixbuf);
+    src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+    dst = cairo_image_surface_get_data (surface);
+    dst_stride = cairo_image_surface_get_stride (surface);
+
+    for (y = 0; y < height; y++)
+    {
+        p = src + (gsize) y * src_stride;
+        q = (guint32 *) (dst + (gsize) y * dst_stride);
+        for (x = 0; x < width; x++, p += channels)
+        {
+            a = channels == 4 ? p[3] : 0xff;
+            /* premultiplied, as cairo wants it */
+            q[x] = a << 24
+                   | ((p[0] * a + 127) / 255) << 16
+                   | ((p[1] * a + 127) / 255) << 8
+                   | ((p[2] * a + 127) / 255);
+        }
+    }
+    cairo_surface_mark_dirty (surface);
+    cairo_surface_set_device_scale (surface, scale, scale);
+
+    return surface;
+}
+
+static void
+iconJobFind (IconCache *cache, IconJob *job)
+{
+    GDesktopAppInfo *app_info;
+    const gchar *desktop_file;
+    gchar *filename;
+    GStatBuf st;
+
+    app_info = findDesktopAppInfo (job->app_id);
+    if (app_info)
+    {
+        desktop_file = g_desktop_app_info_get_filename (app_info);
+        if (desktop_file && g_stat (desktop_file, &st) == 0)
+        {
+            job->desktop_mtime = st.st_mtime;
+        }
+        job->gicon = g_app_info_get_icon (G_APP_INFO (app_info));
+        if (job->gicon)
+        {
+            g_object_ref (job->gicon);
+        }
+        g_object_unref (app_info);
+    }
+    if (job->gicon == NULL)
+    {
+        /* plenty of applications name their icon after their app_id */
+        job->gicon = g_themed_icon_new (job->app_id);
+    }
+
+    filename = getCacheFilename (cache, job);
+    job->surface = readCacheFile (filename, job);
+    g_free (filename);
+}
+
+static void
+iconJobLoad (IconCache *cache, IconJob *job)
+{
+    GdkPixbuf *pixbuf;
+    gchar *filename;
+    gint pixels;
+
+    pixels = job->size * job->scale;
+    if (job->icon_path)
+    {
+        pixbuf = gdk_pixbuf_new_from_file_at_scale (job->icon_path, pixels, pixels,
+                                                    TRUE, NULL);
+    }
+    else
+    {
+        pixbuf = g_object_ref (job->pixbuf);
+    }
+    if (pixbuf == NULL)
+    {
+        return;
+    }
+
+    job->surface = pixbufToSurface (pixbuf, job->scale);
+    g_object_unref (pixbuf);
+    if (job->surface)
+    {
+        filename = getCacheFilename (cache, job);
+        writeCacheFile (filename, job, job->surface);
+        g_free (filename);
+    }
+}
+
+static gboolean iconJobResolve (gpointer data);
+static gboolean iconJobDone (gpointer data);
+
+/* A job comes through twice: to find the icon and check the on-disk
+ * cache, then, once iconJobResolve has found its file, to decode it */
+static void
+iconJobRun (gpointer data, gpointer user_data)
+{
+    IconJob *job = data;
+    IconCache *cache = user_data;
+
+    if (!job->resolved)
+    {
+        iconJobFind (cache, job);
+        if (job->surface == NULL)
+        {
+            g_idle_add (iconJobResolve, job);
+            return;
+        }
+    }
+    else
+    {
+        iconJobLoad (cache, job);
+    }
+
+    g_idle_add (iconJobDone, job);
+}
+
+/* Back on the main thread */
+
+static gboolean
+iconJobDone (gpointer data)
+{
+    IconJob *job = data;
+    IconCache *cache = job->cache;
+    IconCacheEntry *entry;
+
+    entry = g_hash_table_lookup (cache->entries, job->key);
+    if (job->generation == cache->generation && entry && entry->pending)
+    {
+        entry->surface = job->surface;
+        entry->pending = FALSE;
+        job->surface = NULL;
+
+        if (cache->ready && entry->surface)
+        {
+            cache->ready (job->app_id, cache->ready_data);
+        }
+    }
+
+    iconJobFree (job);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Finds the file of the icon for the worker to decode. Icons without one,
+ * such as those built into GTK, are loaded here. */
+static gboolean
+iconJobResolve (gpointer data)
+{
+    IconJob *job = data;
+    IconCache *cache = job->cache;
+    GtkIconInfo *info;
+    const gchar *filename;
+
+    /* the theme changed and the entry went with it */
+    if (job->generation != cache->generation)
+    {
+        return iconJobDone (job);
+    }
+
+    info = gtk_icon_theme_lookup_by_gicon_for_scale (gtk_icon_theme_get_for_screen (cache->gscr),
+                                                     job->gicon, job->size, job->scale,
+                                                     GTK_ICON_LOOKUP_FORCE_SIZE);
+    if (info == NULL)
+    {
+        return iconJobDone (job);
+    }
+
+    filename = gtk_icon_info_get_filename (info);
+    if (filename)
+    {
+        job->icon_path = g_strdup (filename);
+    }
+    else
+    {
+        job->pixbuf = gtk_icon_info_load_icon (info, NULL);
+    }
+    g_object_unref (info);
+
+    if (job->icon_path == NULL && job->pixbuf == NULL)
+    {
+        return iconJobDone (job);
+    }
+
+    job->resolved = TRUE;
+    g_thread_pool_push (cache->pool, job, NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+cb_icon_theme_changed (GtkSettings *settings, GParamSpec *pspec, gpointer data)
+{
+    IconCache *cache = data;
+    gchar *theme;
+
+    g_object_get (settings, "gtk-icon-theme-name", &theme, NULL);
+    g_free (cache->theme);
+    cache->theme = theme ? theme : g_strdup ("hicolor");
+    cache->theme_mtime = getThemeMtime (cache->theme);
+
+    cache->generation++;
+    g_hash_table_remove_all (cache->entries);
+
+    if (cache->ready)
+    {
+        cache->ready (NULL, cache->ready_data);
+    }
+}
+
+IconCache *
+iconCacheNew (GdkScreen *gscr, IconCacheReadyFunc ready, gpointer data)
+{
+    IconCache *cache;
+    GtkSettings *settings;
+
+    cache = g_new0 (IconCache, 1);
+    cache->gscr = gscr;
+    cache->ready = ready;
+    cache->ready_data = data;
+    cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, iconCacheEntryFree);
+    cache->scratch = g_string_new (NULL);
+    cache->cache_dir = g_build_filename (g_get_user_cache_dir (), "xfway", "icons", NULL);
+
+    /* one thread, icons are decoded in the order they were asked for */
+    cache->pool = g_thread_pool_new (iconJobRun, cache, 1, FALSE, NULL);
+
+    settings = gtk_settings_get_for_screen (gscr);
+    g_object_get (settings, "gtk-icon-theme-name", &cache->theme, NULL);
+    if (cache->theme == NULL)
+    {
+        cache->theme = g_strdup ("hicolor");
+    }
+    cache->theme_mtime = getThemeMtime (cache->theme);
+    g_signal_connect (settings, "notify::gtk-icon-theme-name",
+                      G_CALLBACK (cb_icon_theme_changed), cache);
+
+    return cache;
+}
+
+cairo_surface_t *
+iconCacheLookup (IconCache *cache, const gchar *app_id, gint size, gint scale)
+{
+    IconCacheEntry *entry;
+    IconJob *job;
+
+    g_return_val_if_fail (cache != NULL, NULL);
+
+    if (app_id == NULL || *app_id == '\0' || size <= 0)
+    {
+        return NULL;
+    }
+
+    g_string_printf (cache->scratch, "%s %d@%d", app_id, size, scale);
+    entry = g_hash_table_lookup (cache->entries, cache->scratch->str);
+    if (entry)
+    {
+        return entry->surface;
+    }
+
+    entry = g_new0 (IconCacheEntry, 1);
+    entry->pending = TRUE;
+    g_hash_table_insert (cache->entries, g_strdup (cache->scratch->str), entry);
+
+    job = g_new0 (IconJob, 1);
+    job->cache = cache;
+    job->generation = cache->generation;
+    job->key = g_strdup (cache->scratch->str);
+    job->app_id = g_strdup (app_id);
+    job->size = size;
+    job->scale = MAX (scale, 1);
+    job->theme = g_strdup (cache->theme);
+    job->theme_mtime = cache->theme_mtime;
+    g_thread_pool_push (cache->pool, job, NULL);
+
+    return NULL;
+}
@@ -0,0 +1,42 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef INC_ICONS_H
+#define INC_ICONS_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <cairo.h>
+
+typedef struct _IconCache IconCache;
+
+/* Called on the main thread when the icon of app_id was resolved, or with
+ * a NULL app_id when all icons were dropped because the theme changed. */
+typedef void (*IconCacheReadyFunc) (const gchar *app_id, gpointer data);
+
+IconCache               *iconCacheNew                           (GdkScreen *,
+                                                                 IconCacheReadyFunc,
+                                                                 gpointer);
+cairo_surface_t         *iconCacheLookup                        (IconCache *,
+                                                                 const gchar *,
+                                                                 gint,
+                                                                 gint);
+
+#endif /* INC_ICONS_H */
@@ -0,0 +1,352 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "keybindings.h"
+
+#define MIN_SLOTS 64
+
+static const char *action_names[XFWAY_ACTION_COUNT] =
+{
+  [XFWAY_ACTION_NONE] = NULL,
+  [XFWAY_ACTION_CANCEL] = "cancel_key",
+  [XFWAY_ACTION_DOWN] = "down_key",
+  [XFWAY_ACTION_LEFT] = "left_key",
+  [XFWAY_ACTION_RIGHT] = "right_key",
+  [XFWAY_ACTION_UP] = "up_key",
+  [XFWAY_ACTION_ADD_ADJACENT_WORKSPACE] = "add_adjacent_workspace_key",
+  [XFWAY_ACTION_ADD_WORKSPACE] = "add_workspace_key",
+  [XFWAY_ACTION_CLOSE_WINDOW] = "close_window_key",
+  [XFWAY_ACTION_CYCLE_WINDOWS] = "cycle_windows_key",
+  [XFWAY_ACTION_CYCLE_REVERSE_WINDOWS] = "cycle_reverse_windows_key",
+  [XFWAY_ACTION_DEL_ACTIVE_WORKSPACE] = "del_active_workspace_key",
+  [XFWAY_ACTION_DEL_WORKSPACE] = "del_workspace_key",
+  [XFWAY_ACTION_DOWN_WORKSPACE] = "down_workspace_key",
+  [XFWAY_ACTION_FILL_HORIZ] = "fill_horiz_key",
+  [XFWAY_ACTION_FILL_VERT] = "fill_vert_key",
+  [XFWAY_ACTION_FILL_WINDOW] = "fill_window_key",
+  [XFWAY_ACTION_HIDE_WINDOW] = "hide_window_key",
+  [XFWAY_ACTION_LEFT_WORKSPACE] = "left_workspace_key",
+  [XFWAY_ACTION_LOWER_WINDOW] = "lower_window_key",
+  [XFWAY_ACTION_MAXIMIZE_HORIZ] = "maximize_horiz_key",
+  [XFWAY_ACTION_MAXIMIZE_VERT] = "maximize_vert_key",
+  [XFWAY_ACTION_MAXIMIZE_WINDOW] = "maximize_window_key",
+  [XFWAY_ACTION_MOVE] = "move_window_key",
+  [XFWAY_ACTION_MOVE_DOWN_WORKSPACE] = "move_window_down_workspace_key",
+  [XFWAY_ACTION_MOVE_LEFT_WORKSPACE] = "move_window_left_workspace_key",
+  [XFWAY_ACTION_MOVE_NEXT_WORKSPACE] = "move_window_next_workspace_key",
+  [XFWAY_ACTION_MOVE_PREV_WORKSPACE] = "move_window_prev_workspace_key",
+  [XFWAY_ACTION_MOVE_RIGHT_WORKSPACE] = "move_window_right_workspace_key",
+  [XFWAY_ACTION_MOVE_UP_WORKSPACE] = "move_window_up_workspace_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_1] = "move_window_workspace_1_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_2] = "move_window_workspace_2_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_3] = "move_window_workspace_3_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_4] = "move_window_workspace_4_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_5] = "move_window_workspace_5_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_6] = "move_window_workspace_6_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_7] = "move_window_workspace_7_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_8] = "move_window_workspace_8_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_9] = "move_window_workspace_9_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_10] = "move_window_workspace_10_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_11] = "move_window_workspace_11_key",
+  [XFWAY_ACTION_MOVE_WORKSPACE_12] = "move_window_workspace_12_key",
+  [XFWAY_ACTION_NEXT_WORKSPACE] = "next_workspace_key",
+  [XFWAY_ACTION_POPUP_MENU] = "popup_menu_key",
+  [XFWAY_ACTION_PREV_WORKSPACE] = "prev_workspace_key",
+  [XFWAY_ACTION_RAISE_WINDOW] = "raise_window_key",
+  [XFWAY_ACTION_RAISELOWER_WINDOW] = "raiselower_window_key",
+  [XFWAY_ACTION_RESIZE] = "resize_window_key",
+  [XFWAY_ACTION_RIGHT_WORKSPACE] = "right_workspace_key",
+  [XFWAY_ACTION_SHADE_WINDOW] = "shade_window_key",
+  [XFWAY_ACTION_SHOW_DESKTOP] = "show_desktop_key",
+  [XFWAY_ACTION_STICK_WINDOW] = "stick_window_key",
+  [XFWAY_ACTION_SWITCH_APPLICATION] = "switch_application_key",
+  [XFWAY_ACTION_SWITCH_WINDOW] = "switch_window_key",
+  [XFWAY_ACTION_TILE_DOWN] = "tile_down_key",
+  [XFWAY_ACTION_TILE_LEFT] = "tile_left_key",
+  [XFWAY_ACTION_TILE_RIGHT] = "tile_right_key",
+  [XFWAY_ACTION_TILE_UP] = "tile_up_key",
+  [XFWAY_ACTION_TILE_DOWN_LEFT] = "tile_down_left_key",
+  [XFWAY_ACTION_TILE_DOWN_RIGHT] = "tile_down_right_key",
+  [XFWAY_ACTION_TILE_UP_LEFT] = "tile_up_left_key",
+  [XFWAY_ACTION_TILE_UP_RIGHT] = "tile_up_right_key",
+  [XFWAY_ACTION_TOGGLE_ABOVE] = "above_key",
+  [XFWAY_ACTION_TOGGLE_FULLSCREEN] = "fullscreen_key",
+  [XFWAY_ACTION_UP_WORKSPACE] = "up_workspace_key",
+  [XFWAY_ACTION_WORKSPACE_1] = "workspace_1_key",
+  [XFWAY_ACTION_WORKSPACE_2] = "workspace_2_key",
+  [XFWAY_ACTION_WORKSPACE_3] = "workspace_3_key",
+  [XFWAY_ACTION_WORKSPACE_4] = "workspace_4_key",
+  [XFWAY_ACTION_WORKSPACE_5] = "workspace_5_key",
+  [XFWAY_ACTION_WORKSPACE_6] = "workspace_6_key",
+  [XFWAY_ACTION_WORKSPACE_7] = "workspace_7_key",
+  [XFWAY_ACTION_WORKSPACE_8] = "workspace_8_key",
+  [XFWAY_ACTION_WORKSPACE_9] = "workspace_9_key",
+  [XFWAY_ACTION_WORKSPACE_10] = "workspace_10_key",
+  [XFWAY_ACTION_WORKSPACE_11] = "workspace_11_key",
+  [XFWAY_ACTION_WORKSPACE_12] = "workspace_12_key",
+};
+
+static const struct
+{
+  const char *name;
+  uint32_t modifier;
+} modifier_names[] =
+{
+  { "Primary", XFWAY_MODIFIER_CTRL },
+  { "Control", XFWAY_MODIFIER_CTRL },
+  { "Ctrl", XFWAY_MODIFIER_CTRL },
+  { "Shift", XFWAY_MODIFIER_SHIFT },
+  { "Alt", XFWAY_MODIFIER_ALT },
+  { "Mod1", XFWAY_MODIFIER_ALT },
+  { "Super", XFWAY_MODIFIER_SUPER },
+  { "Mod4", XFWAY_MODIFIER_SUPER },
+};
+
+static uint64_t
+binding_key (xkb_keysym_t keysym,
+             uint32_t     modifiers)
+{
+  return (uint64_t) modifiers << 32 | keysym;
+}
+
+static uint32_t
+binding_hash (uint64_t key)
+{
+  key *= 0x9e3779b97f4a7c15ull;
+
+  return (uint32_t) (key >> 32) ^ (uint32_t) key;
+}
+
+void
+xfway_keybindings_init (struct xfway_keybindings *keybindings)
+{
+  keybindings->slots = NULL;
+  keybindings->n_slots = 0;
+  keybindings->n_bindings = 0;
+}
+
+void
+xfway_keybindings_release (struct xfway_keybindings *keybindings)
+{
+  free (keybindings->slots);
+  xfway_keybindings_init (keybindings);
+}
+
+static struct xfway_keybinding *
+find_slot (const struct xfway_keybindings *keybindings,
+           uint64_t                        key)
+{
+  uint32_t mask = keybindings->n_slots - 1;
+  uint32_t i;
+
+  for (i = binding_hash (key) & mask; keybindings->slots[i].key; i = (i + 1) & mask)
+    {
+      if (keybindings->slots[i].key == key)
+        break;
+    }
+
+  return &keybindings->slots[i];
+}
+
+static bool
+resize (struct xfway_keybindings *keybindings,
+        uint32_t                  n_slots)
+{
+  struct xfway_keybindings old = *keybindings;
+  uint32_t i;
+
+  keybindings->slots = calloc (n_slots, sizeof (struct xfway_keybinding));
+  if (!keybindings->slots)
+    {
+      *keybindings = old;
+      return false;
+    }
+  keybindings->n_slots = n_slots;
+
+  for (i = 0; i < old.n_slots; i++)
+    {
+      if (old.slots[i].key)
+        *find_slot (keybindings, old.slots[i].key) = old.slots[i];
+    }
+  free (old.slots);
+
+  return true;
+}
+
+/* Linear probing: move the entries after a removed one back, so that
+ * lookups never need tombstones. */
+static void
+remove_slot (struct xfway_keybindings *keybindings,
+             struct xfway_keybinding  *slot)
+{
+  uint32_t mask = keybindings->n_slots - 1;
+  uint32_t i, j, home;
+
+  i = slot - keybindings->slots;
+  for (j = (i + 1) & mask; keybindings->slots[j].key; j = (j + 1) & mask)
+    {
+      home = binding_hash (keybindings->slots[j].key) & mask;
+      /* stays if its home is cyclically in (i, j] */
+      if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+        continue;
+
+      keybindings->slots[i] = keybindings->slots[j];
+      i = j;
+    }
+  keybindings->slots[i].key = 0;
+  keybindings->slots[i].action = XFWAY_ACTION_NONE;
+}
+
+enum xfway_action
+xfway_keybindings_set (struct xfway_keybindings *keybindings,
+                       xkb_keysym_t              keysym,
+                       uint32_t                  modifiers,
+                       enum xfway_action         action)
+{
+  struct xfway_keybinding *slot;
+  enum xfway_action previous;
+  uint64_t key = binding_key (keysym, modifiers);
+
+  if (keysym == XKB_KEY_NoSymbol || action >= XFWAY_ACTION_COUNT)
+    return XFWAY_ACTION_NONE;
+
+  if (keybindings->n_slots == 0)
+    {
+      if (action == XFWAY_ACTION_NONE)
+        return XFWAY_ACTION_NONE;
+      if (!resize (keybindings, MIN_SLOTS))
+        return XFWAY_ACTION_NONE;
+    }
+
+  slot = find_slot (keybindings, key);
+  previous = slot->action;
+
+  if (action == XFWAY_ACTION_NONE)
+    {
+      if (slot->key)
+        {
+          remove_slot (keybindings, slot);
+          keybindings->n_bindings--;
+        }
+      return previous;
+    }
+
+  if (!slot->key)
+    {
+      /* keep the load under 3/4 */
+      if ((keybindings->n_bindings + 1) * 4 > keybindings->n_slots * 3)
+        {
+          if (!resize (keybindings, keybindings->n_slots * 2))
+            return XFWAY_ACTION_NONE;
+          slot = find_slot (keybindings, key);
+        }
+      slot->key = key;
+      keybindings->n_bindings++;
+    }
+  slot->action = action;
+
+  return previous;
+}
+
+enum xfway_action
+xfway_keybindings_lookup (const struct xfway_keybindings *keybindings,
+                          xkb_keysym_t                    keysym,
+                          uint32_t                        modifiers)
+{
+  if (keybindings->n_bindings == 0)
+    return XFWAY_ACTION_NONE;
+
+  return find_slot (keybindings, binding_key (keysym, modifiers))->action;
+}
+
+bool
+xfway_keybindings_parse (const char   *accelerator,
+                         xkb_keysym_t *keysym,
+                         uint32_t     *modifiers)
+{
+  const char *p = accelerator, *end;
+  uint32_t mods = 0;
+  xkb_keysym_t sym;
+  size_t i, len;
+
+  if (!p)
+    return false;
+
+  while (*p == '<')
+    {
+      end = strchr (p, '>');
+      if (!end)
+        return false;
+      len = end - p - 1;
+
+      for (i = 0; i < sizeof (modifier_names) / sizeof (modifier_names[0]); i++)
+        {
+          if (strlen (modifier_names[i].name) == len &&
+              strncasecmp (modifier_names[i].name, p + 1, len) == 0)
+            break;
+        }
+      if (i == sizeof (modifier_names) / sizeof (modifier_names[0]))
+        return false;
+
+      mods |= modifier_names[i].modifier;
+      p = end + 1;
+    }
+
+  if (!*p)
+    return false;
+
+  sym = xkb_keysym_from_name (p, XKB_KEYSYM_NO_FLAGS);
+  if (sym == XKB_KEY_NoSymbol)
+    sym = xkb_keysym_from_name (p, XKB_KEYSYM_CASE_INSENSITIVE);
+  if (sym == XKB_KEY_NoSymbol)
+    return false;
+
+  /* letters are bound by their level 0 keysym, see xfway_keybindings */
+  *keysym = xkb_keysym_to_lower (sym);
+  *modifiers = mods;
+
+  return true;
+}
+
+enum xfway_action
+xfway_action_from_name (const char *name)
+{
+  int i;
+
+  if (!name)
+    return XFWAY_ACTION_NONE;
+
+  for (i = XFWAY_ACTION_NONE + 1; i < XFWAY_ACTION_COUNT; i++)
+    {
+      if (strcmp (action_names[i], name) == 0)
+        return i;
+    }
+
+  return XFWAY_ACTION_NONE;
+}
+
+const char *
+xfway_action_get_name (enum xfway_action action)
+{
+  if (action <= XFWAY_ACTION_NONE || action >= XFWAY_ACTION_COUNT)
+    return NULL;
+
+  return action_names[action];
+}
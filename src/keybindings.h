@@ -0,0 +1,160 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __KEYBINDINGS_H__
+#define __KEYBINDINGS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
+
+/* The actions of the KEY_* list in settings.h, see action_names in
+ * keybindings.c for their names in the xfconf channel. */
+enum xfway_action
+{
+  XFWAY_ACTION_NONE = 0,
+  XFWAY_ACTION_CANCEL,
+  XFWAY_ACTION_DOWN,
+  XFWAY_ACTION_LEFT,
+  XFWAY_ACTION_RIGHT,
+  XFWAY_ACTION_UP,
+  XFWAY_ACTION_ADD_ADJACENT_WORKSPACE,
+  XFWAY_ACTION_ADD_WORKSPACE,
+  XFWAY_ACTION_CLOSE_WINDOW,
+  XFWAY_ACTION_CYCLE_WINDOWS,
+  XFWAY_ACTION_CYCLE_REVERSE_WINDOWS,
+  XFWAY_ACTION_DEL_ACTIVE_WORKSPACE,
+  XFWAY_ACTION_DEL_WORKSPACE,
+  XFWAY_ACTION_DOWN_WORKSPACE,
+  XFWAY_ACTION_FILL_HORIZ,
+  XFWAY_ACTION_FILL_VERT,
+  XFWAY_ACTION_FILL_WINDOW,
+  XFWAY_ACTION_HIDE_WINDOW,
+  XFWAY_ACTION_LEFT_WORKSPACE,
+  XFWAY_ACTION_LOWER_WINDOW,
+  XFWAY_ACTION_MAXIMIZE_HORIZ,
+  XFWAY_ACTION_MAXIMIZE_VERT,
+  XFWAY_ACTION_MAXIMIZE_WINDOW,
+  XFWAY_ACTION_MOVE,
+  XFWAY_ACTION_MOVE_DOWN_WORKSPACE,
+  XFWAY_ACTION_MOVE_LEFT_WORKSPACE,
+  XFWAY_ACTION_MOVE_NEXT_WORKSPACE,
+  XFWAY_ACTION_MOVE_PREV_WORKSPACE,
+  XFWAY_ACTION_MOVE_RIGHT_WORKSPACE,
+  XFWAY_ACTION_MOVE_UP_WORKSPACE,
+  XFWAY_ACTION_MOVE_WORKSPACE_1,
+  XFWAY_ACTION_MOVE_WORKSPACE_2,
+  XFWAY_ACTION_MOVE_WORKSPACE_3,
+  XFWAY_ACTION_MOVE_WORKSPACE_4,
+  XFWAY_ACTION_MOVE_WORKSPACE_5,
+  XFWAY_ACTION_MOVE_WORKSPACE_6,
+  XFWAY_ACTION_MOVE_WORKSPACE_7,
+  XFWAY_ACTION_MOVE_WORKSPACE_8,
+  XFWAY_ACTION_MOVE_WORKSPACE_9,
+  XFWAY_ACTION_MOVE_WORKSPACE_10,
+  XFWAY_ACTION_MOVE_WORKSPACE_11,
+  XFWAY_ACTION_MOVE_WORKSPACE_12,
+  XFWAY_ACTION_NEXT_WORKSPACE,
+  XFWAY_ACTION_POPUP_MENU,
+  XFWAY_ACTION_PREV_WORKSPACE,
+  XFWAY_ACTION_RAISE_WINDOW,
+  XFWAY_ACTION_RAISELOWER_WINDOW,
+  XFWAY_ACTION_RESIZE,
+  XFWAY_ACTION_RIGHT_WORKSPACE,
+  XFWAY_ACTION_SHADE_WINDOW,
+  XFWAY_ACTION_SHOW_DESKTOP,
+  XFWAY_ACTION_STICK_WINDOW,
+  XFWAY_ACTION_SWITCH_APPLICATION,
+  XFWAY_ACTION_SWITCH_WINDOW,
+  XFWAY_ACTION_TILE_DOWN,
+  XFWAY_ACTION_TILE_LEFT,
+  XFWAY_ACTION_TILE_RIGHT,
+  XFWAY_ACTION_TILE_UP,
+  XFWAY_ACTION_TILE_DOWN_LEFT,
+  XFWAY_ACTION_TILE_DOWN_RIGHT,
+  XFWAY_ACTION_TILE_UP_LEFT,
+  XFWAY_ACTION_TILE_UP_RIGHT,
+  XFWAY_ACTION_TOGGLE_ABOVE,
+  XFWAY_ACTION_TOGGLE_FULLSCREEN,
+  XFWAY_ACTION_UP_WORKSPACE,
+  XFWAY_ACTION_WORKSPACE_1,
+  XFWAY_ACTION_WORKSPACE_2,
+  XFWAY_ACTION_WORKSPACE_3,
+  XFWAY_ACTION_WORKSPACE_4,
+  XFWAY_ACTION_WORKSPACE_5,
+  XFWAY_ACTION_WORKSPACE_6,
+  XFWAY_ACTION_WORKSPACE_7,
+  XFWAY_ACTION_WORKSPACE_8,
+  XFWAY_ACTION_WORKSPACE_9,
+  XFWAY_ACTION_WORKSPACE_10,
+  XFWAY_ACTION_WORKSPACE_11,
+  XFWAY_ACTION_WORKSPACE_12,
+  XFWAY_ACTION_COUNT
+};
+
+/* The bits of enum weston_keyboard_modifier, so that seat->modifier_state
+ * can be looked up as is. */
+#define XFWAY_MODIFIER_CTRL  (1 << 0)
+#define XFWAY_MODIFIER_ALT   (1 << 1)
+#define XFWAY_MODIFIER_SUPER (1 << 2)
+#define XFWAY_MODIFIER_SHIFT (1 << 3)
+
+struct xfway_keybinding
+{
+  /* modifiers << 32 | keysym, 0 for an empty slot */
+  uint64_t key;
+  enum xfway_action action;
+};
+
+/* Shortcuts compiled into an open addressing table keyed by keysym and
+ * modifiers, so a key press costs one hash whatever the number of
+ * bindings. Keysyms are the level 0 ones: <Shift>Tab is Tab with the
+ * shift modifier, not ISO_Left_Tab. */
+struct xfway_keybindings
+{
+  struct xfway_keybinding *slots;
+  uint32_t n_slots; /* power of two */
+  uint32_t n_bindings;
+};
+
+void xfway_keybindings_init (struct xfway_keybindings *keybindings);
+
+void xfway_keybindings_release (struct xfway_keybindings *keybindings);
+
+/* Binds keysym with exactly modifiers to action, or unbinds it for
+ * XFWAY_ACTION_NONE. Returns the action it was bound to before. */
+enum xfway_action xfway_keybindings_set (struct xfway_keybindings *keybindings,
+                                         xkb_keysym_t              keysym,
+                                         uint32_t                  modifiers,
+                                         enum xfway_action         action);
+
+enum xfway_action xfway_keybindings_lookup (const struct xfway_keybindings *keybindings,
+                                            xkb_keysym_t                    keysym,
+                                            uint32_t                        modifiers);
+
+/* Parses a GTK style accelerator such as "<Primary><Alt>Tab". Returns
+ * false if it has an unknown modifier or no key. */
+bool xfway_keybindings_parse (const char   *accelerator,
+                              xkb_keysym_t *keysym,
+                              uint32_t     *modifiers);
+
+/* Actions are named as in xfwm4, "close_window_key" and so on. Unknown
+ * names are XFWAY_ACTION_NONE. */
+enum xfway_action xfway_action_from_name (const char *name);
+
+const char *xfway_action_get_name (enum xfway_action action);
+
+#endif /* __KEYBINDINGS_H__ */
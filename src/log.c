@@ -0,0 +1,502 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+
+/* 256 kB of lines, a few seconds of a very chatty debug scope */
+#define RING_SIZE 1024
+#define RING_MASK (RING_SIZE - 1)
+
+/* Written out by the writer in batches of about this size */
+#define OUTPUT_BUFFER_SIZE 65536
+
+/* One line of the ring. seq is the position the slot is free for while
+ * empty, and that position plus one once a message has been stored, in
+ * the manner of a bounded MPMC queue; producers claim positions with a
+ * CAS on tail and only the writer consumes. */
+struct log_record
+{
+  uint64_t seq;
+  uint64_t time_ms;
+  uint8_t scope;
+  uint8_t level;
+  uint8_t continuation;
+  uint8_t pad;
+  uint32_t len;
+  char text[XFWAY_LOG_LINE_MAX];
+};
+
+static struct
+{
+  struct log_record ring[RING_SIZE];
+  uint64_t tail __attribute__ ((aligned (64)));
+  uint64_t head __attribute__ ((aligned (64)));
+  uint64_t dropped;
+
+  /* set by the writer before it sleeps, cleared by the producer that
+   * wakes it */
+  int writer_sleeping;
+  int wakeup_fd;
+  bool running;
+  bool stop;
+  pthread_t writer;
+  int fd;
+
+  char output[OUTPUT_BUFFER_SIZE];
+  size_t output_len;
+  bool at_line_start;
+
+  /* localtime of last_second, most messages come in the same one */
+  time_t last_second;
+  struct tm last_tm;
+} log_state = {
+  .wakeup_fd = -1,
+  .fd = 2,
+  .at_line_start = true,
+};
+
+int xfway_log_levels[XFWAY_LOG_SCOPE_COUNT] =
+{
+  [XFWAY_LOG_SCOPE_WESTON] = XFWAY_LOG_INFO,
+  [XFWAY_LOG_SCOPE_CORE] = XFWAY_LOG_INFO,
+  [XFWAY_LOG_SCOPE_SHELL] = XFWAY_LOG_INFO,
+  [XFWAY_LOG_SCOPE_LAYER_SHELL] = XFWAY_LOG_INFO,
+  [XFWAY_LOG_SCOPE_FOREIGN_TOPLEVEL] = XFWAY_LOG_INFO,
+  [XFWAY_LOG_SCOPE_SWITCHER] = XFWAY_LOG_INFO,
+};
+
+static const char *scope_names[XFWAY_LOG_SCOPE_COUNT] =
+{
+  [XFWAY_LOG_SCOPE_WESTON] = "weston",
+  [XFWAY_LOG_SCOPE_CORE] = "core",
+  [XFWAY_LOG_SCOPE_SHELL] = "shell",
+  [XFWAY_LOG_SCOPE_LAYER_SHELL] = "layer-shell",
+  [XFWAY_LOG_SCOPE_FOREIGN_TOPLEVEL] = "foreign-toplevel",
+  [XFWAY_LOG_SCOPE_SWITCHER] = "switcher",
+};
+
+static const char *level_names[] =
+{
+  [XFWAY_LOG_ERROR] = "error",
+  [XFWAY_LOG_WARNING] = "warning",
+  [XFWAY_LOG_INFO] = "info",
+  [XFWAY_LOG_DEBUG] = "debug",
+};
+
+static uint64_t
+now_ms (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_REALTIME, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void
+output_flush (void)
+{
+  size_t done = 0;
+  ssize_t n;
+
+  while (done < log_state.output_len)
+    {
+      n = write (log_state.fd, log_state.output + done, log_state.output_len - done);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      done += n;
+    }
+
+  log_state.output_len = 0;
+}
+
+static void
+output_append (const char *text,
+               size_t      len)
+{
+  if (log_state.output_len + len > sizeof (log_state.output))
+    output_flush ();
+
+  memcpy (log_state.output + log_state.output_len, text, len);
+  log_state.output_len += len;
+  if (len > 0)
+    log_state.at_line_start = text[len - 1] == '\n';
+}
+
+/* Lines get a time and their scope; continuations carry on the line they
+ * continue, whatever came in between. */
+static void
+output_message (uint64_t    time_ms,
+                int         scope,
+                bool        continuation,
+                const char *text,
+                size_t      len)
+{
+  char prefix[64];
+  time_t t;
+  int n;
+
+  if (!continuation)
+    {
+      if (!log_state.at_line_start)
+        output_append ("\n", 1);
+
+      /* libweston likes to start messages with blank lines */
+      while (len > 0 && *text == '\n')
+        {
+          text++;
+          len--;
+        }
+
+      t = time_ms / 1000;
+      if (t != log_state.last_second)
+        {
+          localtime_r (&t, &log_state.last_tm);
+          log_state.last_second = t;
+        }
+      n = snprintf (prefix, sizeof (prefix), "[%02d:%02d:%02d.%03d] %s: ",
+                    log_state.last_tm.tm_hour, log_state.last_tm.tm_min,
+                    log_state.last_tm.tm_sec, (int) (time_ms % 1000),
+                    scope_names[scope]);
+      if (n >= (int) sizeof (prefix))
+        n = sizeof (prefix) - 1;
+      output_append (prefix, n);
+    }
+
+  output_append (text, len);
+}
+
+static void
+report_dropped (uint64_t *reported)
+{
+  uint64_t dropped = __atomic_load_n (&log_state.dropped, __ATOMIC_RELAXED);
+  char text[64];
+  int n;
+
+  if (dropped == *reported)
+    return;
+
+  n = snprintf (text, sizeof (text), "dropped %" PRIu64 " messages, the log was full\n",
+                dropped - *reported);
+  output_message (now_ms (), XFWAY_LOG_SCOPE_CORE, false, text, n);
+  *reported = dropped;
+}
+
+/* Writes out everything stored so far. Returns false if the ring was
+ * empty. */
+static bool
+drain (uint64_t *reported)
+{
+  struct log_record *record;
+  bool any = false;
+
+  for (;;)
+    {
+      record = &log_state.ring[log_state.head & RING_MASK];
+      if (__atomic_load_n (&record->seq, __ATOMIC_ACQUIRE) != log_state.head + 1)
+        break;
+
+      output_message (record->time_ms, record->scope, record->continuation,
+                      record->text, record->len);
+
+      __atomic_store_n (&record->seq, log_state.head + RING_SIZE, __ATOMIC_RELEASE);
+      log_state.head++;
+      any = true;
+    }
+
+  report_dropped (reported);
+  output_flush ();
+
+  return any;
+}
+
+static void *
+writer_thread (void *data)
+{
+  struct pollfd pfd = { .fd = log_state.wakeup_fd, .events = POLLIN };
+  uint64_t reported = 0;
+  uint64_t value;
+  sigset_t mask;
+
+  /* signals are for the compositor's event loop */
+  sigfillset (&mask);
+  pthread_sigmask (SIG_BLOCK, &mask, NULL);
+
+  for (;;)
+    {
+      if (drain (&reported))
+        continue;
+
+      __atomic_store_n (&log_state.writer_sleeping, 1, __ATOMIC_SEQ_CST);
+      __atomic_thread_fence (__ATOMIC_SEQ_CST);
+
+      /* a message stored before the flag was seen is picked up here */
+      if (drain (&reported))
+        {
+          __atomic_store_n (&log_state.writer_sleeping, 0, __ATOMIC_RELAXED);
+          continue;
+        }
+      if (__atomic_load_n (&log_state.stop, __ATOMIC_ACQUIRE))
+        break;
+
+      if (poll (&pfd, 1, -1) > 0)
+        while (read (log_state.wakeup_fd, &value, sizeof (value)) > 0)
+          ;
+    }
+
+  return NULL;
+}
+
+static void
+wake_writer (void)
+{
+  uint64_t one = 1;
+
+  if (__atomic_exchange_n (&log_state.writer_sleeping, 0, __ATOMIC_SEQ_CST))
+    while (write (log_state.wakeup_fd, &one, sizeof (one)) < 0 && errno == EINTR)
+      ;
+}
+
+bool
+xfway_log_init (int fd)
+{
+  if (log_state.running)
+    return true;
+
+  log_state.fd = fd;
+  log_state.wakeup_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (log_state.wakeup_fd < 0)
+    return false;
+
+  for (uint64_t i = 0; i < RING_SIZE; i++)
+    log_state.ring[i].seq = i;
+  log_state.head = 0;
+  log_state.tail = 0;
+  log_state.stop = false;
+
+  if (pthread_create (&log_state.writer, NULL, writer_thread, NULL) != 0)
+    {
+      close (log_state.wakeup_fd);
+      log_state.wakeup_fd = -1;
+      return false;
+    }
+
+  __atomic_store_n (&log_state.running, true, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+void
+xfway_log_shutdown (void)
+{
+  uint64_t one = 1;
+
+  if (!log_state.running)
+    return;
+
+  __atomic_store_n (&log_state.running, false, __ATOMIC_RELEASE);
+  __atomic_store_n (&log_state.stop, true, __ATOMIC_RELEASE);
+  while (write (log_state.wakeup_fd, &one, sizeof (one)) < 0 && errno == EINTR)
+    ;
+  pthread_join (log_state.writer, NULL);
+
+  close (log_state.wakeup_fd);
+  log_state.wakeup_fd = -1;
+}
+
+int
+xfway_log_writev (enum xfway_log_scope  scope,
+                  enum xfway_log_level  level,
+                  bool                  continuation,
+                  const char           *fmt,
+                  va_list               ap)
+{
+  struct log_record *record;
+  uint64_t pos, seq;
+  int64_t diff;
+  int len;
+
+  if (!__atomic_load_n (&log_state.running, __ATOMIC_ACQUIRE))
+    return vdprintf (log_state.fd, fmt, ap);
+
+  pos = __atomic_load_n (&log_state.tail, __ATOMIC_RELAXED);
+  for (;;)
+    {
+      record = &log_state.ring[pos & RING_MASK];
+      seq = __atomic_load_n (&record->seq, __ATOMIC_ACQUIRE);
+      diff = (int64_t) (seq - pos);
+
+      if (diff == 0)
+        {
+          if (__atomic_compare_exchange_n (&log_state.tail, &pos, pos + 1, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+        }
+      else if (diff < 0)
+        {
+          /* the writer has not freed this slot yet */
+          __atomic_fetch_add (&log_state.dropped, 1, __ATOMIC_RELAXED);
+          return 0;
+        }
+      else
+        {
+          pos = __atomic_load_n (&log_state.tail, __ATOMIC_RELAXED);
+        }
+    }
+
+  len = vsnprintf (record->text, sizeof (record->text), fmt, ap);
+  if (len < 0)
+    record->len = 0;
+  else if (len >= (int) sizeof (record->text))
+    record->len = sizeof (record->text) - 1;
+  else
+    record->len = len;
+  record->time_ms = now_ms ();
+  record->scope = scope;
+  record->level = level;
+  record->continuation = continuation;
+
+  __atomic_store_n (&record->seq, pos + 1, __ATOMIC_SEQ_CST);
+  wake_writer ();
+
+  return len;
+}
+
+void
+xfway_log_write (enum xfway_log_scope  scope,
+                 enum xfway_log_level  level,
+                 const char           *fmt,
+                 ...)
+{
+  va_list ap;
+
+  va_start (ap, fmt);
+  xfway_log_writev (scope, level, false, fmt, ap);
+  va_end (ap);
+}
+
+static int
+level_from_name (const char *name)
+{
+  char *end;
+  long value;
+  int i;
+
+  for (i = 0; i < (int) (sizeof (level_names) / sizeof (level_names[0])); i++)
+    if (strcasecmp (name, level_names[i]) == 0)
+      return i;
+
+  value = strtol (name, &end, 10);
+  if (end != name && *end == '\0' && value >= XFWAY_LOG_ERROR && value <= XFWAY_LOG_DEBUG)
+    return value;
+
+  return -1;
+}
+
+bool
+xfway_log_set_level (const char *scope,
+                     const char *level)
+{
+  int value = level_from_name (level);
+  int i;
+
+  if (value < 0)
+    return false;
+
+  for (i = 0; i < XFWAY_LOG_SCOPE_COUNT; i++)
+    {
+      if (strcmp (scope, scope_names[i]) == 0)
+        {
+          __atomic_store_n (&xfway_log_levels[i], value, __ATOMIC_RELAXED);
+          return true;
+        }
+    }
+
+  return false;
+}
+
+void
+xfway_log_set_levels (const char *spec)
+{
+  char *copy, *entry, *saveptr = NULL, *colon;
+  int value, i;
+
+  if (spec == NULL)
+    return;
+
+  copy = strdup (spec);
+  if (copy == NULL)
+    return;
+
+  for (entry = strtok_r (copy, ", ", &saveptr); entry != NULL;
+       entry = strtok_r (NULL, ", ", &saveptr))
+    {
+      colon = strchr (entry, ':');
+      if (colon != NULL)
+        {
+          *colon = '\0';
+          xfway_log_set_level (entry, colon + 1);
+          continue;
+        }
+
+      value = level_from_name (entry);
+      if (value < 0)
+        continue;
+      for (i = 0; i < XFWAY_LOG_SCOPE_COUNT; i++)
+        __atomic_store_n (&xfway_log_levels[i], value, __ATOMIC_RELAXED);
+    }
+
+  free (copy);
+}
+
+uint64_t
+xfway_log_get_dropped (void)
+{
+  return __atomic_load_n (&log_state.dropped, __ATOMIC_RELAXED);
+}
+
+const char *
+xfway_log_scope_get_name (enum xfway_log_scope scope)
+{
+  if (scope >= XFWAY_LOG_SCOPE_COUNT)
+    return NULL;
+
+  return scope_names[scope];
+}
+
+const char *
+xfway_log_level_get_name (enum xfway_log_level level)
+{
+  if (level > XFWAY_LOG_DEBUG)
+    return NULL;
+
+  return level_names[level];
+}
@@ -0,0 +1,116 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+/* Messages are formatted into a fixed ring of lines by the thread that
+ * logs them and written out by a background thread, so a slow stderr
+ * (journald, a serial console) never blocks the compositor. When the ring
+ * is full the message is dropped and counted instead; the writer reports
+ * the count once it catches up.
+ *
+ * Every message belongs to a scope with its own level, which may be
+ * changed at any time from any thread. Messages above the level of their
+ * scope cost one load and are never formatted. */
+
+enum xfway_log_level
+{
+  XFWAY_LOG_ERROR,
+  XFWAY_LOG_WARNING,
+  XFWAY_LOG_INFO,
+  XFWAY_LOG_DEBUG,
+};
+
+enum xfway_log_scope
+{
+  XFWAY_LOG_SCOPE_WESTON, /* libweston and whatever else uses weston_log */
+  XFWAY_LOG_SCOPE_CORE,
+  XFWAY_LOG_SCOPE_SHELL,
+  XFWAY_LOG_SCOPE_LAYER_SHELL,
+  XFWAY_LOG_SCOPE_FOREIGN_TOPLEVEL,
+  XFWAY_LOG_SCOPE_SWITCHER,
+  XFWAY_LOG_SCOPE_COUNT
+};
+
+/* Longest message kept, longer ones are truncated */
+#define XFWAY_LOG_LINE_MAX 232
+
+extern int xfway_log_levels[XFWAY_LOG_SCOPE_COUNT];
+
+#define xfway_log_enabled(scope, level) \
+  (__atomic_load_n (&xfway_log_levels[scope], __ATOMIC_RELAXED) >= (int) (level))
+
+#define xfway_log(scope, level, ...) \
+  do { \
+    if (xfway_log_enabled (scope, level)) \
+      xfway_log_write (scope, level, __VA_ARGS__); \
+  } while (0)
+
+/* For va_list callers such as weston_log's handlers, 0 when disabled */
+#define xfway_logv(scope, level, continuation, fmt, ap) \
+  (xfway_log_enabled (scope, level) \
+   ? xfway_log_writev (scope, level, continuation, fmt, ap) : 0)
+
+#define xfway_log_error(scope, ...) xfway_log (scope, XFWAY_LOG_ERROR, __VA_ARGS__)
+#define xfway_log_warning(scope, ...) xfway_log (scope, XFWAY_LOG_WARNING, __VA_ARGS__)
+#define xfway_log_info(scope, ...) xfway_log (scope, XFWAY_LOG_INFO, __VA_ARGS__)
+#define xfway_log_debug(scope, ...) xfway_log (scope, XFWAY_LOG_DEBUG, __VA_ARGS__)
+
+/* Starts the writer thread on fd. Until then, and after
+ * xfway_log_shutdown, messages are written synchronously. */
+bool xfway_log_init (int fd);
+
+/* Writes out what is left in the ring and stops the writer */
+void xfway_log_shutdown (void);
+
+void xfway_log_write (enum xfway_log_scope  scope,
+                      enum xfway_log_level  level,
+                      const char           *fmt,
+                      ...) WL_PRINTF (3, 4);
+
+/* With continuation, the text carries on the previous message rather than
+ * starting a new line, as weston_log_continue does. Returns the length of
+ * the formatted text. Does not check the level, see xfway_logv. */
+int xfway_log_writev (enum xfway_log_scope  scope,
+                      enum xfway_log_level  level,
+                      bool                  continuation,
+                      const char           *fmt,
+                      va_list               ap);
+
+/* Scope and level names are those of xfway_log_scope_get_name and
+ * xfway_log_level_get_name, levels may also be given as numbers. Returns
+ * false if either is unknown. */
+bool xfway_log_set_level (const char *scope,
+                          const char *level);
+
+/* A comma separated list of scope:level, as in XFWAY_LOG="shell:debug".
+ * A level alone applies to every scope. Unknown entries are skipped. */
+void xfway_log_set_levels (const char *spec);
+
+/* Messages dropped because the ring was full, since startup */
+uint64_t xfway_log_get_dropped (void);
+
+const char *xfway_log_scope_get_name (enum xfway_log_scope scope);
+
+const char *xfway_log_level_get_name (enum xfway_log_level level);
+
+#endif /* __LOG_H__ */
@@ -16,18 +16,44 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <wayland-client.h>
 #include <protocol/xfway-shell-client-protocol.h>
 #include <protocol/wlr-foreign-toplevel-management-unstable-v1-client-protocol.h>
 #include "screen.h"
 #include "client.h"
+#include "stacking.h"
+#include "tabwin.h"
+#include "window-table.h"
 #include "../util/libgwater-wayland.h"
 
 struct wl_display *display = NULL;
 static struct wl_registry *registry = NULL;
+static GWaterWaylandSource *display_source = NULL;
+static struct xfway_shell *xfway_shell = NULL;
+
+/* GTK is only brought up once there is something to show, see gtk_setup */
+static int shell_argc;
+static char **shell_argv;
+static gboolean gtk_ready = FALSE;
+static gint64 exec_time = 0;
 
 static Client *focus = NULL;
 
+/* switcher kept up to date from the toplevel events, shown by tabwin_list */
+static Tabwin *tabwin = NULL;
+static GList *tabwin_clients = NULL;
+static guint32 tabwin_key_time = 0;
+/* one widget per monitor, remade once hidden when that count changes */
+static gboolean tabwin_rebuild = FALSE;
+
+/* window table shared by the compositor, see window-table.h */
+static void *window_table = NULL;
+static uint32_t window_table_size = 0;
+static struct xfway_window_table_entry *window_table_entries = NULL;
+static char *window_table_strings = NULL;
+
 enum toplevel_state_field {
 	TOPLEVEL_STATE_MAXIMIZED = (1 << 0),
 	TOPLEVEL_STATE_MINIMIZED = (1 << 1),
@@ -36,6 +62,20 @@ enum toplevel_state_field {
 	TOPLEVEL_STATE_INVALID = (1 << 4),
 };
 
+static void
+icon_ready (const gchar *app_id, gpointer data)
+{
+  ScreenInfo *screen_info = data;
+  Client *c;
+  guint i;
+
+  for (i = 0, c = screen_info->clients; i < screen_info->client_count; i++, c = c->next)
+    {
+      if (app_id == NULL || g_strcmp0 (c->app_id, app_id) == 0)
+        tabwinUpdateClient (tabwin, c);
+    }
+}
+
 static void shell_handle_tabwin (void *data, struct xfway_shell *shell)
 {
 
@@ -46,15 +86,282 @@ static void shell_handle_tabwin_next (void *data, struct xfway_shell *shell)
 
 }
 
+/* Cells are added most recently active first, the order Alt+Tab lists
+ * them in, so their icons are requested in that order too */
+static void
+tabwin_create (ScreenInfo *screen_info)
+{
+  GList *link;
+
+  tabwin = tabwinNew (screen_info, FALSE);
+  for (link = screen_info->windows_mru.head; link; link = link->next)
+    tabwinAddClient (tabwin, link->data);
+}
+
+static void
+tabwin_check_rebuild (ScreenInfo *screen_info)
+{
+  if (!tabwin || tabwin->visible || !tabwin_rebuild)
+    return;
+  tabwin_rebuild = FALSE;
+
+  if ((gint) g_list_length (tabwin->tabwin_list) == myScreenGetNumMonitors (screen_info))
+    {
+      tabwinMonitorsChanged (tabwin);
+      return;
+    }
+
+  tabwinDestroy (tabwin);
+  g_free (tabwin);
+  tabwin_create (screen_info);
+}
+
 static void shell_handle_tabwin_destroy (void *data, struct xfway_shell *shell)
 {
+  if (tabwin && tabwin->visible)
+    tabwinHide (tabwin);
+
+  g_list_free (tabwin_clients);
+  tabwin_clients = NULL;
+
+  tabwin_check_rebuild (data);
+}
+
+static void shell_handle_toplevel_id (void                                   *data,
+                                      struct xfway_shell                     *shell,
+                                      struct zwlr_foreign_toplevel_handle_v1 *toplevel,
+                                      uint32_t                                id)
+{
+  Client *c = clientGetFromHandle (data, toplevel);
+
+  if (c)
+    clientSetId (c, id);
+}
+
+static void shell_handle_window_table (void               *data,
+                                       struct xfway_shell *shell,
+                                       int32_t             fd,
+                                       uint32_t            size)
+{
+  void *map;
+
+  map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      g_warning ("could not map the window table");
+      return;
+    }
+
+  if (window_table)
+    munmap (window_table, window_table_size);
+  window_table = map;
+  window_table_size = size;
+
+  if (!window_table_entries)
+    {
+      window_table_entries = g_new (struct xfway_window_table_entry,
+                                    XFWAY_WINDOW_TABLE_MAX_WINDOWS);
+      window_table_strings = g_malloc (XFWAY_WINDOW_TABLE_STRINGS_SIZE);
+    }
+}
+
+/* Bring the titles of the clients up to date from the window table. The
+ * compositor rate limits title events, the table always has the latest. */
+static void
+window_table_refresh (ScreenInfo *screen_info)
+{
+  struct xfway_window_table_entry *entry;
+  const char *title;
+  Client *c;
+  int i, n;
+
+  if (!window_table)
+    return;
+
+  n = xfway_window_table_read (window_table, window_table_entries,
+                               XFWAY_WINDOW_TABLE_MAX_WINDOWS,
+                               window_table_strings,
+                               XFWAY_WINDOW_TABLE_STRINGS_SIZE);
+
+  for (i = 0; i < n; i++)
+    {
+      entry = &window_table_entries[i];
+      if (entry->id == 0 || entry->title == 0)
+        continue;
+
+      c = clientGetFromId (screen_info, entry->id);
+      if (!c)
+        continue;
+
+      title = window_table_strings + entry->title;
+      if (g_strcmp0 (c->name, title) != 0)
+        {
+          g_free (c->name);
+          c->name = g_strdup (title);
+          if (tabwin)
+            tabwinUpdateClient (tabwin, c);
+        }
+    }
+}
+
+/* Bring up GTK, the theme and the switcher. Not needed to follow the
+ * toplevels, so it stays off the startup path: it runs once the shell is
+ * idle, or right away if Alt+Tab comes first. */
+static gboolean
+gtk_setup (ScreenInfo *screen_info)
+{
+  GdkScreen *screen;
+  gint64 start;
+
+  if (gtk_ready)
+    return tabwin != NULL;
+  gtk_ready = TRUE;
+
+  start = g_get_monotonic_time ();
+  if (!gtk_init_check (&shell_argc, &shell_argv))
+    {
+      g_warning ("could not initialize GTK, the switcher is disabled");
+      return FALSE;
+    }
+
+  screen = gdk_screen_get_default ();
+  screen_info->gscr = screen;
+  screen_info->icon_cache = iconCacheNew (screen, icon_ready, screen_info);
+
+  /* realized up front so Alt+Tab only has to map it */
+  tabwin_create (screen_info);
+  tabwin_rebuild = FALSE;
+
+  g_debug ("GTK set up in %.1f ms",
+           (g_get_monotonic_time () - start) / 1000.0);
+
+  return TRUE;
+}
+
+static gboolean
+gtk_setup_idle (gpointer data)
+{
+  gtk_setup (data);
 
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+tabwin_first_draw (GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+  guint32 now = g_get_monotonic_time () / 1000;
+
+  g_debug ("tabwin drawn %u ms after key press", now - tabwin_key_time);
+  g_signal_handlers_disconnect_by_func (widget, tabwin_first_draw, data);
+
+  return FALSE;
+}
+
+static void
+monitor_changed (Monitors          *monitors,
+                 const MonitorInfo *info,
+                 gpointer           data)
+{
+  if (tabwin)
+    tabwinMonitorsChanged (tabwin);
+}
+
+static void
+monitor_added_or_removed (Monitors          *monitors,
+                          const MonitorInfo *info,
+                          gpointer           data)
+{
+  g_debug ("output %u (%s %s): %dx%d+%d+%d scale %d, %d monitors",
+           info->name, info->make, info->model,
+           info->geometry.width, info->geometry.height,
+           info->geometry.x, info->geometry.y, info->scale,
+           monitorsGetCount (monitors));
+
+  tabwin_rebuild = TRUE;
+  tabwin_check_rebuild (data);
+}
+
+static void
+monitor_removed (Monitors          *monitors,
+                 const MonitorInfo *info,
+                 gpointer           data)
+{
+  ScreenInfo *screen_info = data;
+  GList *link;
+
+  /* The compositor sends no output_leave for an output that goes away */
+  for (link = screen_info->windows_stack.head; link; link = link->next)
+    clientLeaveMonitor (link->data, info->name);
+
+  monitor_added_or_removed (monitors, info, data);
+}
+
+static void shell_handle_tabwin_list (void               *data,
+                                      struct xfway_shell *shell,
+                                      uint32_t            time,
+                                      struct wl_array    *windows,
+                                      uint32_t            selected)
+{
+  ScreenInfo *screen_info = data;
+  GList *selected_link = NULL, *list;
+  uint32_t *id;
+
+  shell_handle_tabwin_destroy (data, shell);
+  if (!gtk_setup (screen_info))
+    return;
+  window_table_refresh (screen_info);
+
+  wl_array_for_each (id, windows)
+    {
+      Client *c = clientGetFromId (screen_info, *id);
+
+      if (!c)
+        continue;
+
+      tabwin_clients = g_list_prepend (tabwin_clients, c);
+      if (*id == selected)
+        selected_link = tabwin_clients;
+    }
+  tabwin_clients = g_list_reverse (tabwin_clients);
+
+  if (!tabwin_clients)
+    return;
+
+  tabwin_key_time = time;
+  for (list = tabwin->tabwin_list; list; list = g_list_next (list))
+    {
+      g_signal_handlers_disconnect_by_func (list->data, tabwin_first_draw, NULL);
+      g_signal_connect_after (list->data, "draw",
+                              G_CALLBACK (tabwin_first_draw), NULL);
+    }
+
+  tabwinShow (tabwin, &tabwin_clients,
+              selected_link ? selected_link : tabwin_clients);
+}
+
+static void shell_handle_tabwin_select (void               *data,
+                                        struct xfway_shell *shell,
+                                        uint32_t            id)
+{
+  Client *c;
+
+  if (!tabwin || !tabwin->visible)
+    return;
+
+  c = clientGetFromId (data, id);
+  if (c)
+    tabwinSelectClient (tabwin, c);
 }
 
 struct xfway_shell_listener shell_impl = {
   shell_handle_tabwin,
   shell_handle_tabwin_next,
   shell_handle_tabwin_destroy,
+  shell_handle_toplevel_id,
+  shell_handle_tabwin_list,
+  shell_handle_tabwin_select,
+  shell_handle_window_table,
 };
 
 static void toplevel_handle_title(void *data,
@@ -65,13 +372,24 @@ static void toplevel_handle_title(void *data,
   if (c->name)
     g_free (c->name);
   c->name = g_strdup (title);
+  if (tabwin)
+    tabwinUpdateClient (tabwin, c);
 }
 
 static void toplevel_handle_app_id(void *data,
 		struct zwlr_foreign_toplevel_handle_v1 *zwlr_toplevel,
 		const char *app_id)
 {
+  Client *c = data;
 
+  if (g_strcmp0 (c->app_id, app_id) == 0)
+    return;
+
+  g_free (c->app_id);
+  c->app_id = g_strdup (app_id);
+  /* also starts loading the icon, well before the next Alt+Tab */
+  if (tabwin)
+    tabwinUpdateClient (tabwin, c);
 }
 
 static uint32_t array_to_state(struct wl_array *array) {
@@ -98,7 +416,35 @@ static void toplevel_handle_state(void *data,
 	uint32_t s = array_to_state(state);
 
   if (s & TOPLEVEL_STATE_ACTIVATED)
-    focus = c;
+    {
+      focus = c;
+      clientRaise (c);
+      clientSetLastActive (c);
+    }
+}
+
+static void toplevel_handle_output_enter(void *data,
+		struct zwlr_foreign_toplevel_handle_v1 *zwlr_toplevel,
+		struct wl_output *output)
+{
+  Client *c = data;
+  const MonitorInfo *info;
+
+  info = monitorsFindByOutput (c->screen_info->monitors, output);
+  if (info)
+    clientEnterMonitor (c, info);
+}
+
+static void toplevel_handle_output_leave(void *data,
+		struct zwlr_foreign_toplevel_handle_v1 *zwlr_toplevel,
+		struct wl_output *output)
+{
+  Client *c = data;
+  const MonitorInfo *info;
+
+  info = monitorsFindByOutput (c->screen_info->monitors, output);
+  if (info)
+    clientLeaveMonitor (c, info->name);
 }
 
 static void toplevel_handle_done(void *data,
@@ -112,8 +458,12 @@ static void toplevel_handle_closed(void *data,
 {
   Client *c = data;
 
+  if (tabwin)
+    tabwinRemoveClient (tabwin, c);
+
   if (c->name)
     g_free (c->name);
+  g_free (c->app_id);
 
   clientUnframe (c, FALSE);
 }
@@ -121,8 +471,8 @@ static void toplevel_handle_closed(void *data,
 static const struct zwlr_foreign_toplevel_handle_v1_listener toplevel_impl = {
 	.title = toplevel_handle_title,
 	.app_id = toplevel_handle_app_id,
-	.output_enter = NULL,
-	.output_leave = NULL,
+	.output_enter = toplevel_handle_output_enter,
+	.output_leave = toplevel_handle_output_leave,
 	.state = toplevel_handle_state,
 	.done = toplevel_handle_done,
 	.closed = toplevel_handle_closed,
@@ -136,6 +486,8 @@ static void toplevel_manager_handle_toplevel(void *data,
   Client *c;
 
   c = clientFrame (screen_info, zwlr_toplevel, FALSE);
+  if (tabwin)
+    tabwinAddClient (tabwin, c);
 
   zwlr_foreign_toplevel_handle_v1_add_listener (zwlr_toplevel, &toplevel_impl,
                                                 c);
@@ -161,10 +513,12 @@ void global_add (void               *data,
 
   if (strcmp (interface, "xfway_shell") == 0)
     {
-      struct xfway_shell *shell = NULL;
-      shell = wl_registry_bind (registry, name, &xfway_shell_interface, 1);
+      xfway_shell = wl_registry_bind (registry, name, &xfway_shell_interface,
+                                      MIN (version, 3));
 
-      xfway_shell_add_listener (shell, &shell_impl, NULL);
+      xfway_shell_add_listener (xfway_shell, &shell_impl, screen_info);
+      if (xfway_shell_get_version (xfway_shell) >= XFWAY_SHELL_GET_WINDOW_TABLE_SINCE_VERSION)
+        xfway_shell_get_window_table (xfway_shell);
     }
   else if (strcmp(interface,
 			"zwlr_foreign_toplevel_manager_v1") == 0) {
@@ -175,12 +529,18 @@ void global_add (void               *data,
     zwlr_foreign_toplevel_manager_v1_add_listener(screen_info->toplevel_manager,
 				&toplevel_manager_impl, screen_info);
       }
+  else if (strcmp (interface, "wl_output") == 0)
+    {
+      monitorsAddOutput (screen_info->monitors, registry, name, version);
+    }
 }
 void global_remove (void               *data,
                     struct wl_registry *registry,
                     uint32_t            name)
 {
+  ScreenInfo *screen_info = data;
 
+  monitorsRemoveOutput (screen_info->monitors, name);
 }
 
 struct wl_registry_listener registry_listener =
@@ -189,35 +549,103 @@ struct wl_registry_listener registry_listener =
   .global_remove = global_remove
 };
 
+/* The compositor answers the sync once it has announced its globals, so
+ * xfway_shell is bound by now: from here on an Alt+Tab is handled. */
+static void registry_done (void               *data,
+                           struct wl_callback *callback,
+                           uint32_t            serial)
+{
+  ScreenInfo *screen_info = data;
+  gint64 now = g_get_monotonic_time ();
+
+  wl_callback_destroy (callback);
+
+  if (!xfway_shell)
+    g_warning ("the compositor does not advertise xfway_shell");
+
+  /* GTK comes up later, gtk_setup logs how long that took */
+  if (exec_time > 0)
+    g_debug ("taking Alt+Tab %.1f ms after exec, GTK not set up yet",
+             (now - exec_time) / 1000.0);
+  else
+    g_debug ("taking Alt+Tab, GTK not set up yet");
+
+  g_idle_add_full (G_PRIORITY_LOW, gtk_setup_idle, screen_info, NULL);
+}
+
+static const struct wl_callback_listener registry_done_listener = {
+  registry_done,
+};
+
+/* The connection is gone, along with the compositor */
+static gboolean
+display_lost (gpointer user_data)
+{
+  GMainLoop *loop = user_data;
+  const GWaterWaylandSourceStats *stats;
+
+  stats = g_water_wayland_source_get_stats (display_source);
+  g_debug ("%" G_GUINT64_FORMAT " events in %" G_GUINT64_FORMAT " wakeups, "
+           "at most %" G_GUINT64_FORMAT " in one, %" G_GUINT64_FORMAT
+           " yields to GTK, %" G_GUINT64_FORMAT " flushes",
+           stats->events, stats->wakeups, stats->max_events, stats->yields,
+           stats->flushes);
+
+  g_main_loop_quit (loop);
+
+  return G_SOURCE_REMOVE;
+}
+
 int main (int    argc,
           char **argv)
 {
   ScreenInfo *screen_info;
-  GdkScreen *screen;
-  GWaterWaylandSource *source;
+  struct wl_callback *callback;
+  GMainLoop *loop;
+  const gchar *env;
+
+  /* set by the compositor right before exec */
+  env = g_getenv ("XFWAY_EXEC_TIME");
+  if (env)
+    exec_time = g_ascii_strtoll (env, NULL, 10);
+
   display = wl_display_connect (NULL);
 
   if (display == NULL)
     {
       fprintf (stderr, "Can't connect to display");
+      return 1;
     }
 
-  gtk_init (&argc, &argv);
-
-  screen = gdk_screen_get_default ();
+  shell_argc = argc;
+  shell_argv = argv;
 
-  screen_info = myScreenInit (screen);
+  screen_info = myScreenInit (NULL);
+  g_signal_connect (screen_info->monitors, "monitor-added",
+                    G_CALLBACK (monitor_added_or_removed), screen_info);
+  g_signal_connect (screen_info->monitors, "monitor-removed",
+                    G_CALLBACK (monitor_removed), screen_info);
+  g_signal_connect (screen_info->monitors, "monitor-changed",
+                    G_CALLBACK (monitor_changed), screen_info);
 
+  /* No roundtrips: globals are bound as they come in, from the main loop */
   registry = wl_display_get_registry (display);
-
   wl_registry_add_listener (registry, &registry_listener, screen_info);
+  callback = wl_display_sync (display);
+  wl_callback_add_listener (callback, &registry_done_listener, screen_info);
 
-  wl_display_roundtrip (display);
-  wl_display_roundtrip (display);
+  loop = g_main_loop_new (NULL, FALSE);
 
-  source = g_water_wayland_source_new_for_display (NULL, display);
+  display_source = g_water_wayland_source_new_for_display (NULL, display);
+  g_water_wayland_source_set_error_callback (display_source, display_lost,
+                                             loop, NULL);
+  /* events dispatched in a row before GTK gets a turn, 0 for no limit */
+  env = g_getenv ("XFWAY_DISPATCH_BUDGET");
+  if (env)
+    g_water_wayland_source_set_dispatch_budget (display_source,
+                                                g_ascii_strtoull (env, NULL, 10));
 
-  gtk_main ();
+  g_main_loop_run (loop);
 
   return 0;
 }
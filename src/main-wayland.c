@@ -33,7 +33,12 @@
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <assert.h>
+#include <time.h>
+#include <signal.h>
 #include "os-compatibility.h"
+#include "glib-loop.h"
+#include "log.h"
+#include "trace.h"
 #include "../util/helpers.h"
 
 struct wet_layoutput;
@@ -85,13 +90,59 @@ struct wet_layoutput {
 static int vlog (const char *fmt,
                  va_list     ap)
 {
-  return vfprintf (stderr, fmt, ap);
+  return xfway_logv (XFWAY_LOG_SCOPE_WESTON, XFWAY_LOG_INFO, false, fmt, ap);
 }
 
 static int vlog_continue (const char *fmt,
                           va_list     argp)
 {
-  return vfprintf (stderr, fmt, argp);
+  return xfway_logv (XFWAY_LOG_SCOPE_WESTON, XFWAY_LOG_INFO, true, fmt, argp);
+}
+
+/* "/log/<scope>" holds the level of a log scope, by name or number */
+static void
+log_level_changed (XfconfChannel *channel,
+                   const gchar   *property,
+                   const GValue  *value,
+                   gpointer       data)
+{
+  GValue level = G_VALUE_INIT;
+  const char *scope;
+
+  if (!g_str_has_prefix (property, "/log/"))
+    return;
+  scope = property + strlen ("/log/");
+
+  g_value_init (&level, G_TYPE_STRING);
+  if (value && G_IS_VALUE (value) && g_value_transform (value, &level)
+      && g_value_get_string (&level))
+    xfway_log_set_level (scope, g_value_get_string (&level));
+  else
+    xfway_log_set_level (scope, xfway_log_level_get_name (XFWAY_LOG_INFO));
+  g_value_unset (&level);
+}
+
+static void
+log_levels_init (XfconfChannel *channel)
+{
+  GHashTable *properties;
+  GHashTableIter iter;
+  gpointer property, value;
+
+  properties = xfconf_channel_get_properties (channel, "/log");
+  if (properties)
+    {
+      g_hash_table_iter_init (&iter, properties);
+      while (g_hash_table_iter_next (&iter, &property, &value))
+        log_level_changed (channel, property, value, NULL);
+      g_hash_table_destroy (properties);
+    }
+
+  /* the environment wins, it is what one sets to debug a session */
+  xfway_log_set_levels (getenv ("XFWAY_LOG"));
+
+  g_signal_connect (channel, "property-changed",
+                    G_CALLBACK (log_level_changed), NULL);
 }
 
 static void
@@ -668,6 +719,8 @@ drm_heads_changed(struct wl_listener *listener, void *arg)
 	bool changed;
 	bool forced;
 
+	XFWAY_TRACE_FUNC();
+
 	/* We need to collect all cloned heads into outputs before enabling the
 	 * output.
 	 */
@@ -692,6 +745,228 @@ drm_heads_changed(struct wl_listener *listener, void *arg)
 		wet->init_failed = true;
 }
 
+static void
+apply_client_limit (struct xfway_client_accounting *accounting,
+                    struct xfway_settings          *settings,
+                    enum xfway_setting              setting)
+{
+  switch (setting)
+    {
+    case XFWAY_SETTING_LIMIT_SURFACES:
+      xfway_client_accounting_set_limit (accounting, XFWAY_CLIENT_SURFACES,
+                                         settings->limit_surfaces);
+      break;
+    case XFWAY_SETTING_LIMIT_VIEWS:
+      xfway_client_accounting_set_limit (accounting, XFWAY_CLIENT_VIEWS,
+                                         settings->limit_views);
+      break;
+    case XFWAY_SETTING_LIMIT_SHM_MEGABYTES:
+      xfway_client_accounting_set_limit (accounting, XFWAY_CLIENT_SHM_BYTES,
+                                         (uint64_t) settings->limit_shm_megabytes << 20);
+      break;
+    case XFWAY_SETTING_LIMIT_BUFFERS:
+      xfway_client_accounting_set_limit (accounting, XFWAY_CLIENT_BUFFERS,
+                                         settings->limit_buffers);
+      break;
+    case XFWAY_SETTING_LIMIT_LAYER_SURFACES:
+      xfway_client_accounting_set_limit (accounting, XFWAY_CLIENT_LAYER_SURFACES,
+                                         settings->limit_layer_surfaces);
+      break;
+    case XFWAY_SETTING_LIMIT_TOPLEVEL_RESOURCES:
+      xfway_client_accounting_set_limit (accounting, XFWAY_CLIENT_TOPLEVEL_RESOURCES,
+                                         settings->limit_toplevel_resources);
+      break;
+    case XFWAY_SETTING_LIMIT_SWITCHER_WINDOWS:
+      xfway_client_accounting_set_limit (accounting, XFWAY_CLIENT_SWITCHER_WINDOWS,
+                                         settings->limit_switcher_windows);
+      break;
+    default:
+      break;
+    }
+}
+
+/* Applies a setting of the compositor itself, the shell follows the
+ * others. */
+static void
+apply_setting (xfwmDisplay        *server,
+               enum xfway_setting  setting)
+{
+  struct weston_compositor *compositor = server->compositor;
+  struct xfway_settings *settings = &server->settings;
+
+  switch (setting)
+    {
+    case XFWAY_SETTING_REPAINT_MSEC:
+      compositor->repaint_msec = settings->repaint_msec;
+      break;
+    case XFWAY_SETTING_IDLE_TIME:
+      compositor->idle_time = settings->idle_time;
+      break;
+    /* sent to keyboards as they are bound */
+    case XFWAY_SETTING_KB_REPEAT_RATE:
+      compositor->kb_repeat_rate = settings->kb_repeat_rate;
+      break;
+    case XFWAY_SETTING_KB_REPEAT_DELAY:
+      compositor->kb_repeat_delay = settings->kb_repeat_delay;
+      break;
+    case XFWAY_SETTING_PROTOCOL_STATS:
+      if (server->protocol_stats)
+        xfway_protocol_stats_set_enabled (server->protocol_stats, settings->protocol_stats);
+      break;
+    case XFWAY_SETTING_PROTOCOL_SAMPLE_INTERVAL:
+      if (server->protocol_stats)
+        xfway_protocol_stats_set_sample_interval (server->protocol_stats,
+                                                  settings->protocol_sample_interval);
+      break;
+    case XFWAY_SETTING_DEBUG_PROTOCOL:
+      if (server->debug)
+        xfway_debug_set_enabled (server->debug, settings->debug_protocol);
+      break;
+    case XFWAY_SETTING_LIMIT_SURFACES:
+    case XFWAY_SETTING_LIMIT_VIEWS:
+    case XFWAY_SETTING_LIMIT_SHM_MEGABYTES:
+    case XFWAY_SETTING_LIMIT_BUFFERS:
+    case XFWAY_SETTING_LIMIT_LAYER_SURFACES:
+    case XFWAY_SETTING_LIMIT_TOPLEVEL_RESOURCES:
+    case XFWAY_SETTING_LIMIT_SWITCHER_WINDOWS:
+      if (server->accounting)
+        apply_client_limit (server->accounting, settings, setting);
+      break;
+    case XFWAY_SETTING_LIMIT_DISCONNECT:
+      if (server->accounting)
+        xfway_client_accounting_set_disconnect (server->accounting, settings->limit_disconnect);
+      break;
+    default:
+      break;
+    }
+}
+
+/* kill -USR2 writes out what has been recorded so far: the protocol
+ * counters while they are enabled, what every client holds, and trace
+ * spans when built in */
+static int
+dump_diagnostics (int   signal_number,
+                  void *data)
+{
+  xfwmDisplay *server = data;
+  static unsigned int n_dumps;
+  const char *dir = getenv ("XDG_RUNTIME_DIR");
+  char *path;
+  FILE *f;
+
+  if (!dir)
+    dir = "/tmp";
+
+  if (server->protocol_stats && xfway_protocol_stats_get_enabled (server->protocol_stats))
+    {
+      path = g_strdup_printf ("%s/xfway-protocol-%d-%u.txt", dir, (int) getpid (), n_dumps);
+      f = fopen (path, "w");
+      if (f)
+        {
+          xfway_protocol_stats_dump (server->protocol_stats, f);
+          fclose (f);
+          xfway_log_info (XFWAY_LOG_SCOPE_CORE, "protocol counters written to %s\n", path);
+        }
+      else
+        {
+          xfway_log_error (XFWAY_LOG_SCOPE_CORE, "cannot write protocol counters to %s: %m\n",
+                           path);
+        }
+      g_free (path);
+    }
+
+  if (server->accounting)
+    {
+      path = g_strdup_printf ("%s/xfway-clients-%d-%u.txt", dir, (int) getpid (), n_dumps);
+      f = fopen (path, "w");
+      if (f)
+        {
+          xfway_client_accounting_dump (server->accounting, f);
+          fclose (f);
+          xfway_log_info (XFWAY_LOG_SCOPE_CORE, "client usage written to %s\n", path);
+        }
+      else
+        {
+          xfway_log_error (XFWAY_LOG_SCOPE_CORE, "cannot write client usage to %s: %m\n",
+                           path);
+        }
+      g_free (path);
+    }
+
+#ifdef XFWAY_ENABLE_TRACING
+  path = g_strdup_printf ("%s/xfway-trace-%d-%u.json", dir, (int) getpid (), n_dumps);
+  if (xfway_trace_dump (path))
+    xfway_log_info (XFWAY_LOG_SCOPE_CORE, "trace written to %s\n", path);
+  else
+    xfway_log_error (XFWAY_LOG_SCOPE_CORE, "cannot write trace to %s: %m\n", path);
+  g_free (path);
+#endif
+
+  n_dumps++;
+
+  return 1;
+}
+
+static void
+debug_snapshot_client (const struct xfway_client_usage *usage,
+                       void                            *data)
+{
+  struct xfway_debug_snapshot *snapshot = data;
+  char object[64];
+  int i;
+
+  snprintf (object, sizeof (object), "client %d %s", (int) usage->pid, usage->name);
+  for (i = 0; i < XFWAY_CLIENT_RESOURCE_COUNT; i++)
+    xfway_debug_snapshot_add (snapshot, object, xfway_client_resource_get_name (i),
+                              usage->counts[i]);
+}
+
+/* counters of the modules the shell does not own */
+static void
+debug_snapshot (struct wl_listener *listener,
+                void               *data)
+{
+  xfwmDisplay *server = wl_container_of (listener, server, debug_snapshot_listener);
+  struct xfway_debug_snapshot *snapshot = data;
+  struct xfway_worker_pool_stats stats;
+
+  xfway_debug_snapshot_add (snapshot, "compositor", "log_dropped", xfway_log_get_dropped ());
+
+  if (server->workers)
+    {
+      xfway_worker_pool_get_stats (server->workers, &stats);
+      xfway_debug_snapshot_add (snapshot, "workers", "submitted", stats.submitted);
+      xfway_debug_snapshot_add (snapshot, "workers", "completed", stats.completed);
+      xfway_debug_snapshot_add (snapshot, "workers", "cancelled", stats.cancelled);
+      xfway_debug_snapshot_add (snapshot, "workers", "queue_depth", stats.queue_depth);
+      xfway_debug_snapshot_add (snapshot, "workers", "max_wait_us", stats.max_wait_us);
+    }
+
+  if (server->protocol_stats && xfway_protocol_stats_get_enabled (server->protocol_stats))
+    xfway_debug_snapshot_add (snapshot, "compositor", "protocol_overflow",
+                              xfway_protocol_stats_get_overflow (server->protocol_stats));
+
+  if (server->accounting)
+    xfway_client_accounting_for_each (server->accounting, debug_snapshot_client, snapshot);
+}
+
+static void
+settings_changed (struct wl_listener *listener,
+                  void               *data)
+{
+  xfwmDisplay *server = wl_container_of (listener, server, settings_listener);
+  enum xfway_setting *setting = data;
+
+  apply_setting (server, *setting);
+
+  /* re-arms the idle timer with the new timeout */
+  if (*setting == XFWAY_SETTING_IDLE_TIME)
+    weston_compositor_wake (server->compositor);
+
+  xfway_log_debug (XFWAY_LOG_SCOPE_CORE, "setting %s changed\n",
+                   xfway_settings_get_property (*setting));
+}
+
 static int load_drm_backend (xfwmDisplay *server, int32_t use_pixman)
 {
   struct weston_drm_backend_config config = {{ 0, }};
@@ -699,7 +974,7 @@ static int load_drm_backend (xfwmDisplay *server, int32_t use_pixman)
 
   config.base.struct_version = WESTON_DRM_BACKEND_CONFIG_VERSION;
 	config.base.struct_size = sizeof (struct weston_drm_backend_config);
-  config.use_pixman = xfconf_channel_get_bool (server->channel, "/use-pixman", FALSE);
+  config.use_pixman = use_pixman || server->settings.use_pixman;
 
   server->heads_changed_listener.notify = drm_heads_changed;
 	weston_compositor_add_heads_changed_listener(server->compositor,
@@ -721,7 +996,7 @@ static int load_wayland_backend (xfwmDisplay *server, int32_t use_pixman)
 
 	config.cursor_size = 32;
 	config.display_name = 0;
-	config.use_pixman = xfconf_channel_get_bool (server->channel, "/use-pixman", FALSE);
+	config.use_pixman = use_pixman || server->settings.use_pixman;
 	config.sprawl = 0;
 	config.fullscreen = 0;
 	config.cursor_theme = NULL;
@@ -804,6 +1079,7 @@ child_client_exec(int sockfd, const char *path)
 	int clientfd;
 	char s[32];
 	sigset_t allsigs;
+	struct timespec now;
 
 	/* do not give our signal mask to the new process */
 	sigfillset(&allsigs);
@@ -826,6 +1102,13 @@ child_client_exec(int sockfd, const char *path)
 	snprintf(s, sizeof s, "%d", clientfd);
 	setenv("WAYLAND_SOCKET", s, 1);
 
+	/* lets the client tell how long it took to get going, in
+	 * CLOCK_MONOTONIC microseconds */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	snprintf(s, sizeof s, "%lld",
+		 (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000);
+	setenv("XFWAY_EXEC_TIME", s, 1);
+
 	if (execl(path, path, NULL) < 0)
 		weston_log("compositor: executing '%s' failed: %m\n",
 			path);
@@ -959,9 +1242,24 @@ int main (int    argc,
   struct weston_output *output;
   GError *error = NULL;
   struct weston_log_context *log_ctx = NULL;
+  struct xfway_glib_loop *glib_loop;
+  struct wl_event_source *diagnostics_signal;
+  sigset_t diagnostics_mask;
+
+  /* wl_event_loop_add_signal blocks SIGUSR2 in the calling thread only.
+   * Block it before the log writer and the GDBus thread of xfconf start,
+   * they inherit the mask and the default action would kill us. */
+  sigemptyset (&diagnostics_mask);
+  sigaddset (&diagnostics_mask, SIGUSR2);
+  pthread_sigmask (SIG_BLOCK, &diagnostics_mask, NULL);
 
   server = malloc (sizeof(xfwmDisplay));
 
+  /* nothing below may block on stderr */
+  if (!xfway_log_init (STDERR_FILENO))
+    fprintf (stderr, "failed to start the log writer, logging synchronously\n");
+  weston_log_set_handler (vlog, vlog_continue);
+
   if (!xfconf_init (&error))
     {
       g_critical ("Failed to initialize xfconf: %s", error->message);
@@ -971,6 +1269,8 @@ int main (int    argc,
     }
 
   server->channel = xfconf_channel_get ("xfway");
+  xfway_settings_init (&server->settings, server->channel);
+  log_levels_init (server->channel);
 
   wl_list_init(&server->layoutput_list);
   
@@ -997,6 +1297,16 @@ int main (int    argc,
 
 	display = wl_display_create ();
 
+  /* xfconf notifies changes from the GLib main context */
+  glib_loop = xfway_glib_loop_create (wl_display_get_event_loop (display));
+  if (!glib_loop)
+    g_warning ("GLib sources will not be dispatched, settings changes need a restart");
+
+  server->protocol_stats = xfway_protocol_stats_create (display);
+  server->accounting = xfway_client_accounting_create (display);
+  diagnostics_signal = wl_event_loop_add_signal (wl_display_get_event_loop (display), SIGUSR2,
+                                                 dump_diagnostics, server);
+
   wl_list_init(&child_process_list);
 
 	server->compositor = weston_compositor_create (display, log_ctx, server);
@@ -1008,7 +1318,13 @@ int main (int    argc,
 	if (!server->compositor)
 		return 0;
 
-  weston_log_set_handler (vlog, vlog_continue);
+  server->debug = xfway_debug_create (server->compositor);
+  if (server->debug)
+    {
+      server->debug_snapshot_listener.notify = debug_snapshot;
+      wl_signal_add (xfway_debug_get_snapshot_signal (server->debug),
+                     &server->debug_snapshot_listener);
+    }
 
   int i;
   int32_t use_pixman = 0;
@@ -1022,11 +1338,10 @@ int main (int    argc,
 	server->compositor->default_pointer_grab = NULL;
 	server->compositor->vt_switching = true;
 
-	server->compositor->repaint_msec = 16;
-	server->compositor->idle_time = 300;
-
-  server->compositor->kb_repeat_rate = 40;
-  server->compositor->kb_repeat_delay = 400;
+  for (i = 0; i < XFWAY_SETTING_COUNT; i++)
+    apply_setting (server, i);
+  server->settings_listener.notify = settings_changed;
+  wl_signal_add (&server->settings.changed_signal, &server->settings_listener);
 
 
   wl_list_init (&server->outputs);
@@ -1068,12 +1383,32 @@ int main (int    argc,
     unsetenv ("DISPLAY");
   }
 
+  server->workers = xfway_worker_pool_create (wl_display_get_event_loop (display), 0);
+  if (!server->workers)
+    xfway_log_warning (XFWAY_LOG_SCOPE_CORE,
+                       "failed to start worker threads, doing all work on the main thread\n");
+
   xfway_server_shell_init (server, &argc, &argv);
 
   weston_compositor_wake (server->compositor);
   wl_display_run (display);
 
+  wl_list_remove (&server->settings_listener.link);
+  xfway_settings_release (&server->settings);
+  if (server->workers)
+    xfway_worker_pool_destroy (server->workers);
+  if (server->protocol_stats)
+    xfway_protocol_stats_destroy (server->protocol_stats);
+  if (server->debug)
+    xfway_debug_destroy (server->debug);
+  if (server->accounting)
+    xfway_client_accounting_destroy (server->accounting);
   weston_compositor_destroy (server->compositor);
+  xfway_glib_loop_destroy (glib_loop);
+  g_signal_handlers_disconnect_by_func (server->channel, log_level_changed, NULL);
+  if (diagnostics_signal)
+    wl_event_source_remove (diagnostics_signal);
+  xfway_log_shutdown ();
     //}
 
 	return 0;
@@ -0,0 +1,403 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* libweston has no xdg-output, so the logical geometry is worked out
+ * from the wl_output mode, scale and transform. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <wayland-client.h>
+
+#include "monitors.h"
+
+enum
+{
+    MONITOR_ADDED,
+    MONITOR_REMOVED,
+    MONITOR_CHANGED,
+    LAST_SIGNAL
+};
+
+/* A wl_output and what it sent since its last done event */
+typedef struct
+{
+    MonitorInfo info;
+    Monitors *monitors;
+    guint32 version;
+    gint x;
+    gint y;
+    gint mode_width;
+    gint mode_height;
+    gint scale;
+    gint refresh;
+    gint transform;
+    gchar *make;
+    gchar *model;
+} MonitorOutput;
+
+static guint monitors_signals[LAST_SIGNAL] = { 0 };
+
+static void monitors_class_init (MonitorsClass *klass, gpointer data);
+static void monitors_init (Monitors *monitors, gpointer data);
+
+static GType
+monitors_get_type (void)
+{
+    static GType type = G_TYPE_INVALID;
+
+    if (G_UNLIKELY (type == G_TYPE_INVALID))
+    {
+        static const GTypeInfo info =
+        {
+            sizeof (MonitorsClass),
+            NULL,
+            NULL,
+            (GClassInitFunc) monitors_class_init,
+            NULL,
+            NULL,
+            sizeof (Monitors),
+            0,
+            (GInstanceInitFunc) monitors_init,
+            NULL,
+        };
+
+        type = g_type_register_static (G_TYPE_OBJECT, "XfwmMonitors", &info, 0);
+    }
+
+    return type;
+}
+
+static void
+monitors_class_init (MonitorsClass *klass, gpointer data)
+{
+    monitors_signals[MONITOR_ADDED] =
+        g_signal_new ("monitor-added", G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                      g_cclosure_marshal_VOID__POINTER,
+                      G_TYPE_NONE, 1, G_TYPE_POINTER);
+    monitors_signals[MONITOR_REMOVED] =
+        g_signal_new ("monitor-removed", G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                      g_cclosure_marshal_VOID__POINTER,
+                      G_TYPE_NONE, 1, G_TYPE_POINTER);
+    monitors_signals[MONITOR_CHANGED] =
+        g_signal_new ("monitor-changed", G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                      g_cclosure_marshal_VOID__POINTER,
+                      G_TYPE_NONE, 1, G_TYPE_POINTER);
+}
+
+static void
+monitors_init (Monitors *monitors, gpointer data)
+{
+    monitors->monitors = g_ptr_array_new ();
+    monitors->outputs = g_hash_table_new (g_direct_hash, g_direct_equal);
+    monitors->min_width = 0;
+    monitors->min_height = 0;
+}
+
+/* Only runs when an output comes, goes or changes, so that the switcher
+ * gets its size without looking at every monitor. */
+static void
+updateMinSize (Monitors *monitors)
+{
+    MonitorInfo *info;
+    guint i;
+
+    monitors->min_width = 0;
+    monitors->min_height = 0;
+    for (i = 0; i < monitors->monitors->len; i++)
+    {
+        info = g_ptr_array_index (monitors->monitors, i);
+        if (monitors->min_width == 0 || info->geometry.width < monitors->min_width)
+        {
+            monitors->min_width = info->geometry.width;
+        }
+        if (monitors->min_height == 0 || info->geometry.height < monitors->min_height)
+        {
+            monitors->min_height = info->geometry.height;
+        }
+    }
+}
+
+static void
+output_handle_geometry (void             *data,
+                        struct wl_output *wl_output,
+                        int32_t           x,
+                        int32_t           y,
+                        int32_t           physical_width,
+                        int32_t           physical_height,
+                        int32_t           subpixel,
+                        const char       *make,
+                        const char       *model,
+                        int32_t           transform)
+{
+    MonitorOutput *output = data;
+
+    output->x = x;
+    output->y = y;
+    output->transform = transform;
+    g_free (output->make);
+    output->make = g_strdup (make);
+    g_free (output->model);
+    output->model = g_strdup (model);
+}
+
+static void
+output_handle_mode (void             *data,
+                    struct wl_output *wl_output,
+                    uint32_t          flags,
+                    int32_t           width,
+                    int32_t           height,
+                    int32_t           refresh)
+{
+    MonitorOutput *output = data;
+
+    if (!(flags & WL_OUTPUT_MODE_CURRENT))
+    {
+        return;
+    }
+
+    output->mode_width = width;
+    output->mode_height = height;
+    output->refresh = refresh;
+}
+
+static void
+output_handle_done (void             *data,
+                    struct wl_output *wl_output)
+{
+    MonitorOutput *output = data;
+    MonitorInfo *info = &output->info;
+    Monitors *monitors = output->monitors;
+    GdkRectangle geometry;
+    gint scale;
+
+    scale = MAX (output->scale, 1);
+    geometry.x = output->x;
+    geometry.y = output->y;
+    /* the odd transforms are rotated by 90 or 270 degrees */
+    if (output->transform & 1)
+    {
+        geometry.width = output->mode_height / scale;
+        geometry.height = output->mode_width / scale;
+    }
+    else
+    {
+        geometry.width = output->mode_width / scale;
+        geometry.height = output->mode_height / scale;
+    }
+
+    if (info->ready &&
+        gdk_rectangle_equal (&info->geometry, &geometry) &&
+        info->scale == scale &&
+        info->refresh == output->refresh &&
+        info->transform == output->transform &&
+        g_strcmp0 (info->make, output->make) == 0 &&
+        g_strcmp0 (info->model, output->model) == 0)
+    {
+        return;
+    }
+
+    info->geometry = geometry;
+    info->scale = scale;
+    info->refresh = output->refresh;
+    info->transform = output->transform;
+    if (g_strcmp0 (info->make, output->make) != 0)
+    {
+        g_free (info->make);
+        info->make = g_strdup (output->make);
+    }
+    if (g_strcmp0 (info->model, output->model) != 0)
+    {
+        g_free (info->model);
+        info->model = g_strdup (output->model);
+    }
+
+    if (!info->ready)
+    {
+        info->ready = TRUE;
+        info->index = monitors->monitors->len;
+        g_ptr_array_add (monitors->monitors, info);
+        updateMinSize (monitors);
+        g_signal_emit (monitors, monitors_signals[MONITOR_ADDED], 0, info);
+    }
+    else
+    {
+        updateMinSize (monitors);
+        g_signal_emit (monitors, monitors_signals[MONITOR_CHANGED], 0, info);
+    }
+}
+
+static void
+output_handle_scale (void             *data,
+                     struct wl_output *wl_output,
+                     int32_t           factor)
+{
+    MonitorOutput *output = data;
+
+    output->scale = factor;
+}
+
+static const struct wl_output_listener output_listener = {
+    output_handle_geometry,
+    output_handle_mode,
+    output_handle_done,
+    output_handle_scale,
+};
+
+static void
+freeOutput (MonitorOutput *output)
+{
+    if (output->version >= WL_OUTPUT_RELEASE_SINCE_VERSION)
+    {
+        wl_output_release (output->info.output);
+    }
+    else
+    {
+        wl_output_destroy (output->info.output);
+    }
+    g_free (output->make);
+    g_free (output->model);
+    g_free (output->info.make);
+    g_free (output->info.model);
+    g_free (output);
+}
+
+Monitors *
+monitorsNew (void)
+{
+    return g_object_new (monitors_get_type (), NULL);
+}
+
+void
+monitorsAddOutput (Monitors *monitors, struct wl_registry *registry,
+                   guint32 name, guint32 version)
+{
+    MonitorOutput *output;
+
+    g_return_if_fail (monitors != NULL);
+
+    output = g_new0 (MonitorOutput, 1);
+    output->monitors = monitors;
+    /* v2 brings the done and scale events, v3 release */
+    output->version = MIN (version, 3);
+    output->scale = 1;
+    output->info.name = name;
+    output->info.index = -1;
+    output->info.output = wl_registry_bind (registry, name, &wl_output_interface,
+                                            output->version);
+    wl_output_add_listener (output->info.output, &output_listener, output);
+
+    g_hash_table_insert (monitors->outputs, GUINT_TO_POINTER (name), output);
+}
+
+/* Returns FALSE if name is not a wl_output */
+gboolean
+monitorsRemoveOutput (Monitors *monitors, guint32 name)
+{
+    MonitorOutput *output;
+    MonitorInfo *info;
+    guint i;
+
+    g_return_val_if_fail (monitors != NULL, FALSE);
+
+    output = g_hash_table_lookup (monitors->outputs, GUINT_TO_POINTER (name));
+    if (!output)
+    {
+        return FALSE;
+    }
+    g_hash_table_remove (monitors->outputs, GUINT_TO_POINTER (name));
+
+    info = &output->info;
+    if (info->ready)
+    {
+        g_ptr_array_remove_index (monitors->monitors, info->index);
+        for (i = info->index; i < monitors->monitors->len; i++)
+        {
+            ((MonitorInfo *) g_ptr_array_index (monitors->monitors, i))->index = i;
+        }
+        updateMinSize (monitors);
+        g_signal_emit (monitors, monitors_signals[MONITOR_REMOVED], 0, info);
+    }
+
+    freeOutput (output);
+
+    return TRUE;
+}
+
+gint
+monitorsGetCount (Monitors *monitors)
+{
+    g_return_val_if_fail (monitors != NULL, 0);
+
+    return monitors->monitors->len;
+}
+
+const MonitorInfo *
+monitorsGet (Monitors *monitors, gint index)
+{
+    g_return_val_if_fail (monitors != NULL, NULL);
+
+    if (index < 0 || index >= (gint) monitors->monitors->len)
+    {
+        return NULL;
+    }
+
+    return g_ptr_array_index (monitors->monitors, index);
+}
+
+const MonitorInfo *
+monitorsFindAtPoint (Monitors *monitors, gint x, gint y)
+{
+    MonitorInfo *info;
+    guint i;
+
+    g_return_val_if_fail (monitors != NULL, NULL);
+
+    for (i = 0; i < monitors->monitors->len; i++)
+    {
+        info = g_ptr_array_index (monitors->monitors, i);
+        if (x >= info->geometry.x && x < info->geometry.x + info->geometry.width &&
+            y >= info->geometry.y && y < info->geometry.y + info->geometry.height)
+        {
+            return info;
+        }
+    }
+
+    return NULL;
+}
+
+/* Also finds outputs that have not sent their first done event yet. Only
+ * monitorsAddOutput binds wl_outputs on the shell's connection, so the
+ * MonitorOutput is the listener data of every one the compositor names. */
+const MonitorInfo *
+monitorsFindByOutput (Monitors *monitors, struct wl_output *wl_output)
+{
+    MonitorOutput *output;
+
+    g_return_val_if_fail (monitors != NULL, NULL);
+    g_return_val_if_fail (wl_output != NULL, NULL);
+
+    output = wl_output_get_user_data (wl_output);
+
+    return output ? &output->info : NULL;
+}
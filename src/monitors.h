@@ -0,0 +1,87 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef INC_MONITORS_H
+#define INC_MONITORS_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib-object.h>
+#include <gdk/gdk.h>
+#include <wayland-client.h>
+
+typedef struct _Monitors Monitors;
+typedef struct _MonitorsClass MonitorsClass;
+typedef struct _MonitorInfo MonitorInfo;
+
+/* One wl_output, as of its last done event */
+struct _MonitorInfo
+{
+    struct wl_output *output;
+    guint32 name; /* in the registry */
+    gint index; /* in Monitors::monitors */
+    GdkRectangle geometry; /* logical, in compositor space */
+    gint scale;
+    gint refresh; /* mHz */
+    gint transform;
+    gchar *make;
+    gchar *model;
+    /* seen its first done event */
+    gboolean ready;
+};
+
+/*
+ * The outputs of the compositor, kept from the wl_output events so that
+ * asking about them costs nothing. Emits "monitor-added",
+ * "monitor-removed" and "monitor-changed" with the MonitorInfo once an
+ * output is complete, went away or changed.
+ */
+struct _Monitors
+{
+    GObject __parent__;
+
+    GPtrArray *monitors; /* MonitorInfo, in the order they were added */
+    /* registry name -> every bound wl_output, complete or not */
+    GHashTable *outputs;
+    /* smallest logical size of all monitors, for the switcher */
+    gint min_width;
+    gint min_height;
+};
+
+struct _MonitorsClass
+{
+    GObjectClass __parent__;
+};
+
+Monitors                *monitorsNew                            (void);
+void                     monitorsAddOutput                      (Monitors *,
+                                                                 struct wl_registry *,
+                                                                 guint32,
+                                                                 guint32);
+gboolean                 monitorsRemoveOutput                   (Monitors *,
+                                                                 guint32);
+gint                     monitorsGetCount                       (Monitors *);
+const MonitorInfo       *monitorsGet                            (Monitors *,
+                                                                 gint);
+const MonitorInfo       *monitorsFindAtPoint                    (Monitors *,
+                                                                 gint,
+                                                                 gint);
+const MonitorInfo       *monitorsFindByOutput                   (Monitors *,
+                                                                 struct wl_output *);
+
+#endif /* INC_MONITORS_H */
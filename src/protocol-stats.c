@@ -0,0 +1,772 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "client-name.h"
+#include "protocol-stats.h"
+
+/* Clients seen at once; the slot of a client that has gone is reused for
+ * a new one, the oldest first */
+#define CLIENTS_SIZE 256
+
+/* One counter per client, interface and message in use, kept below 3/4
+ * full so probes stay short. The counters of a client that has gone are
+ * folded into those of XFWAY_PROTOCOL_STATS_GONE_CLIENT when its slot is
+ * reused or the table is full, the oldest client first. */
+#define COUNTERS_BITS 12
+#define COUNTERS_SIZE (1 << COUNTERS_BITS)
+#define COUNTERS_MASK (COUNTERS_SIZE - 1)
+#define COUNTERS_MAX (COUNTERS_SIZE / 4 * 3)
+
+#define SAMPLES_SIZE 256
+#define SAMPLE_TEXT_MAX 160
+
+struct stats_client
+{
+  struct xfway_protocol_stats *stats;
+  struct wl_client *client; /* NULL once gone */
+  struct wl_listener destroy_listener;
+  uint32_t id; /* 0 for a slot never used or already folded */
+  pid_t pid;
+  char name[16];
+};
+
+struct stats_counter
+{
+  /* the wl_message is unique to interface, opcode and direction */
+  const struct wl_message *message;
+  const char *interface;
+  uint32_t client_id;
+  uint16_t client_slot;
+  bool event;
+  uint64_t count;
+  uint64_t bytes;
+  uint64_t dispatch_ns;
+  uint64_t max_dispatch_ns;
+};
+
+struct stats_sample
+{
+  uint64_t time_ns;
+  uint32_t client_id;
+  char text[SAMPLE_TEXT_MAX];
+};
+
+struct xfway_protocol_stats
+{
+  struct wl_display *display;
+  struct wl_protocol_logger *logger;
+
+  struct stats_client clients[CLIENTS_SIZE];
+  uint32_t next_client_id;
+
+  struct stats_counter counters[COUNTERS_SIZE];
+  unsigned int n_counters;
+  uint64_t overflow;
+
+  /* the request being dispatched, until the next one or the loop idles */
+  struct stats_counter *pending;
+  uint64_t pending_start;
+  struct wl_event_source *pending_idle;
+
+  uint32_t sample_interval;
+  uint32_t sample_countdown;
+  struct stats_sample samples[SAMPLES_SIZE];
+  uint64_t n_samples;
+};
+
+static uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void close_pending (struct xfway_protocol_stats *stats,
+                           uint64_t                     now);
+
+static void
+stats_client_destroyed (struct wl_listener *listener,
+                        void               *data)
+{
+  struct stats_client *sc = wl_container_of (listener, sc, destroy_listener);
+
+  wl_list_remove (&sc->destroy_listener.link);
+  sc->client = NULL;
+}
+
+static unsigned int
+counter_home (const struct wl_message *message,
+              uint32_t                 client_id,
+              bool                     event)
+{
+  uint64_t hash;
+
+  hash = ((uint64_t) (uintptr_t) message ^ ((uint64_t) client_id << 32) ^ event)
+         * 0x9e3779b97f4a7c15ull;
+
+  return hash >> (64 - COUNTERS_BITS);
+}
+
+/* NULL if the counter is new and the table full */
+static struct stats_counter *
+stats_counter_lookup (struct xfway_protocol_stats *stats,
+                      const struct wl_message     *message,
+                      const char                  *interface,
+                      uint32_t                     client_id,
+                      uint16_t                     client_slot,
+                      bool                         event)
+{
+  struct stats_counter *counter;
+  unsigned int i;
+
+  for (i = counter_home (message, client_id, event); ; i = (i + 1) & COUNTERS_MASK)
+    {
+      counter = &stats->counters[i];
+
+      if (counter->message == NULL)
+        break;
+      if (counter->message == message && counter->client_id == client_id
+          && counter->event == event)
+        return counter;
+    }
+
+  if (stats->n_counters >= COUNTERS_MAX)
+    return NULL;
+
+  counter->message = message;
+  counter->interface = interface;
+  counter->client_id = client_id;
+  counter->client_slot = client_slot;
+  counter->event = event;
+  stats->n_counters++;
+
+  return counter;
+}
+
+/* Shifts back the counters probing past the hole, so no lookup stops
+ * short of them */
+static void
+stats_counter_remove (struct xfway_protocol_stats *stats,
+                      unsigned int                 hole)
+{
+  struct stats_counter *counter;
+  unsigned int i, home;
+
+  for (i = (hole + 1) & COUNTERS_MASK; ; i = (i + 1) & COUNTERS_MASK)
+    {
+      counter = &stats->counters[i];
+      if (counter->message == NULL)
+        break;
+
+      home = counter_home (counter->message, counter->client_id, counter->event);
+      if (((i - home) & COUNTERS_MASK) >= ((i - hole) & COUNTERS_MASK))
+        {
+          stats->counters[hole] = *counter;
+          hole = i;
+        }
+    }
+
+  memset (&stats->counters[hole], 0, sizeof (struct stats_counter));
+  stats->n_counters--;
+}
+
+/* Adds the counters of a client that has gone to the (gone) ones and
+ * frees its slot */
+static void
+stats_client_fold (struct xfway_protocol_stats *stats,
+                   struct stats_client         *sc)
+{
+  struct stats_counter old, *gone;
+  unsigned int i;
+
+  /* counters move, the pending one with them */
+  close_pending (stats, now_ns ());
+
+  for (i = 0; i < COUNTERS_SIZE; i++)
+    {
+      /* whatever was shifted back into i is looked at again */
+      while (stats->counters[i].message != NULL
+             && stats->counters[i].client_id == sc->id)
+        {
+          old = stats->counters[i];
+          stats_counter_remove (stats, i);
+
+          gone = stats_counter_lookup (stats, old.message, old.interface,
+                                       XFWAY_PROTOCOL_STATS_GONE_CLIENT, 0, old.event);
+          gone->count += old.count;
+          gone->bytes += old.bytes;
+          gone->dispatch_ns += old.dispatch_ns;
+          if (old.max_dispatch_ns > gone->max_dispatch_ns)
+            gone->max_dispatch_ns = old.max_dispatch_ns;
+        }
+    }
+
+  sc->id = 0;
+}
+
+static bool
+stats_fold_oldest_client (struct xfway_protocol_stats *stats)
+{
+  struct stats_client *sc, *oldest = NULL;
+  unsigned int i;
+
+  for (i = 0; i < CLIENTS_SIZE; i++)
+    {
+      sc = &stats->clients[i];
+      if (sc->client == NULL && sc->id != 0 && (oldest == NULL || sc->id < oldest->id))
+        oldest = sc;
+    }
+  if (oldest == NULL)
+    return false;
+
+  stats_client_fold (stats, oldest);
+
+  return true;
+}
+
+/* The slot of client, taking one on first sight. NULL if every slot holds
+ * a live client. */
+static struct stats_client *
+stats_client_get (struct xfway_protocol_stats *stats,
+                  struct wl_client            *client)
+{
+  struct stats_client *sc, *oldest = NULL;
+  struct wl_listener *listener;
+  unsigned int i;
+
+  listener = wl_client_get_destroy_listener (client, stats_client_destroyed);
+  if (listener != NULL)
+    return wl_container_of (listener, sc, destroy_listener);
+
+  for (i = 0; i < CLIENTS_SIZE; i++)
+    {
+      sc = &stats->clients[i];
+      if (sc->client == NULL && (oldest == NULL || sc->id < oldest->id))
+        oldest = sc;
+    }
+  if (oldest == NULL)
+    return NULL;
+
+  sc = oldest;
+  if (sc->id != 0)
+    stats_client_fold (stats, sc);
+
+  sc->stats = stats;
+  sc->client = client;
+  sc->id = ++stats->next_client_id;
+  wl_client_get_credentials (client, &sc->pid, NULL, NULL);
+  xfway_client_get_name (sc->pid, sc->name, sizeof (sc->name));
+
+  sc->destroy_listener.notify = stats_client_destroyed;
+  wl_client_add_destroy_listener (client, &sc->destroy_listener);
+
+  return sc;
+}
+
+static struct stats_counter *
+stats_counter_get (struct xfway_protocol_stats *stats,
+                   struct stats_client         *sc,
+                   struct wl_resource          *resource,
+                   const struct wl_message     *message,
+                   bool                         event)
+{
+  uint32_t client_id = sc ? sc->id : 0;
+  uint16_t client_slot = sc ? sc - stats->clients : 0;
+  struct stats_counter *counter;
+
+  for (;;)
+    {
+      counter = stats_counter_lookup (stats, message, wl_resource_get_class (resource),
+                                      client_id, client_slot, event);
+      if (counter != NULL || !stats_fold_oldest_client (stats))
+        return counter;
+    }
+}
+
+/* Size on the wire; fds go out of band */
+static uint32_t
+message_size (const struct wl_protocol_logger_message *message)
+{
+  const char *signature = message->message->signature;
+  const union wl_argument *arg = message->arguments;
+  uint32_t size = 8;
+
+  for (; *signature; signature++)
+    {
+      switch (*signature)
+        {
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'o':
+        case 'n':
+          size += 4;
+          arg++;
+          break;
+        case 's':
+          size += 4 + (arg->s ? (strlen (arg->s) + 1 + 3) & ~3u : 0);
+          arg++;
+          break;
+        case 'a':
+          size += 4 + (arg->a ? (arg->a->size + 3) & ~3u : 0);
+          arg++;
+          break;
+        case 'h':
+          arg++;
+          break;
+        default:
+          /* '?' and the since version */
+          break;
+        }
+    }
+
+  return size;
+}
+
+static void append (char *buf, size_t size, size_t *len, const char *fmt, ...) WL_PRINTF (4, 5);
+
+static void
+append (char       *buf,
+        size_t      size,
+        size_t     *len,
+        const char *fmt,
+        ...)
+{
+  va_list ap;
+  int n;
+
+  if (*len >= size - 1)
+    return;
+
+  va_start (ap, fmt);
+  n = vsnprintf (buf + *len, size - *len, fmt, ap);
+  va_end (ap);
+
+  if (n > 0)
+    *len = *len + n < size - 1 ? *len + n : size - 1;
+}
+
+static void
+append_object (char               *buf,
+               size_t              size,
+               size_t             *len,
+               struct wl_resource *resource)
+{
+  if (resource == NULL)
+    append (buf, size, len, "nil");
+  else
+    append (buf, size, len, "%s@%u", wl_resource_get_class (resource),
+            wl_resource_get_id (resource));
+}
+
+/* As WAYLAND_DEBUG prints it */
+static void
+format_message (char                                    *buf,
+                size_t                                   size,
+                const struct wl_protocol_logger_message *message,
+                bool                                     event)
+{
+  const char *signature = message->message->signature;
+  const union wl_argument *arg = message->arguments;
+  size_t len = 0;
+  bool first = true;
+
+  append (buf, size, &len, "%s", event ? "-> " : "");
+  append_object (buf, size, &len, message->resource);
+  append (buf, size, &len, ".%s(", message->message->name);
+
+  for (; *signature; signature++)
+    {
+      if (strchr ("iufsonah", *signature) == NULL)
+        continue;
+
+      append (buf, size, &len, "%s", first ? "" : ", ");
+      first = false;
+
+      switch (*signature)
+        {
+        case 'i':
+          append (buf, size, &len, "%d", arg->i);
+          break;
+        case 'u':
+          append (buf, size, &len, "%u", arg->u);
+          break;
+        case 'f':
+          append (buf, size, &len, "%f", wl_fixed_to_double (arg->f));
+          break;
+        case 's':
+          if (arg->s)
+            append (buf, size, &len, "\"%s\"", arg->s);
+          else
+            append (buf, size, &len, "nil");
+          break;
+        case 'o':
+          append_object (buf, size, &len, (struct wl_resource *) arg->o);
+          break;
+        case 'n':
+          /* created by the client, or already by the compositor */
+          if (event)
+            append_object (buf, size, &len, (struct wl_resource *) arg->o);
+          else
+            append (buf, size, &len, "new id %u", arg->n);
+          break;
+        case 'a':
+          append (buf, size, &len, "array[%zu]", arg->a ? arg->a->size : 0);
+          break;
+        case 'h':
+          append (buf, size, &len, "fd %d", arg->h);
+          break;
+        }
+      arg++;
+    }
+
+  append (buf, size, &len, ")");
+}
+
+static void
+close_pending (struct xfway_protocol_stats *stats,
+               uint64_t                     now)
+{
+  uint64_t elapsed;
+
+  if (stats->pending == NULL)
+    return;
+
+  elapsed = now - stats->pending_start;
+  stats->pending->dispatch_ns += elapsed;
+  if (elapsed > stats->pending->max_dispatch_ns)
+    stats->pending->max_dispatch_ns = elapsed;
+  stats->pending = NULL;
+}
+
+static void
+pending_idle (void *data)
+{
+  struct xfway_protocol_stats *stats = data;
+
+  stats->pending_idle = NULL;
+  close_pending (stats, now_ns ());
+}
+
+static void
+protocol_logged (void                                    *user_data,
+                 enum wl_protocol_logger_type             direction,
+                 const struct wl_protocol_logger_message *message)
+{
+  struct xfway_protocol_stats *stats = user_data;
+  bool event = direction == WL_PROTOCOL_LOGGER_EVENT;
+  uint64_t now = now_ns ();
+  struct stats_counter *counter;
+  struct stats_sample *sample;
+  struct stats_client *sc;
+
+  /* the previous request is done once the next one comes in */
+  if (!event)
+    close_pending (stats, now);
+
+  sc = stats_client_get (stats, wl_resource_get_client (message->resource));
+  counter = stats_counter_get (stats, sc, message->resource, message->message, event);
+  if (counter == NULL)
+    {
+      stats->overflow++;
+      return;
+    }
+
+  counter->count++;
+  counter->bytes += message_size (message);
+
+  if (!event)
+    {
+      stats->pending = counter;
+      stats->pending_start = now;
+      if (stats->pending_idle == NULL)
+        stats->pending_idle =
+          wl_event_loop_add_idle (wl_display_get_event_loop (stats->display),
+                                  pending_idle, stats);
+    }
+
+  if (stats->sample_interval && --stats->sample_countdown == 0)
+    {
+      stats->sample_countdown = stats->sample_interval;
+      sample = &stats->samples[stats->n_samples++ % SAMPLES_SIZE];
+      sample->time_ns = now;
+      sample->client_id = counter->client_id;
+      format_message (sample->text, sizeof (sample->text), message, event);
+    }
+}
+
+struct xfway_protocol_stats *
+xfway_protocol_stats_create (struct wl_display *display)
+{
+  struct xfway_protocol_stats *stats;
+
+  stats = calloc (1, sizeof (struct xfway_protocol_stats));
+  if (stats == NULL)
+    return NULL;
+
+  stats->display = display;
+
+  return stats;
+}
+
+void
+xfway_protocol_stats_destroy (struct xfway_protocol_stats *stats)
+{
+  unsigned int i;
+
+  xfway_protocol_stats_set_enabled (stats, false);
+
+  for (i = 0; i < CLIENTS_SIZE; i++)
+    if (stats->clients[i].client != NULL)
+      wl_list_remove (&stats->clients[i].destroy_listener.link);
+
+  free (stats);
+}
+
+void
+xfway_protocol_stats_set_enabled (struct xfway_protocol_stats *stats,
+                                  bool                         enabled)
+{
+  if (enabled == (stats->logger != NULL))
+    return;
+
+  if (enabled)
+    {
+      stats->logger = wl_display_add_protocol_logger (stats->display, protocol_logged, stats);
+      return;
+    }
+
+  wl_protocol_logger_destroy (stats->logger);
+  stats->logger = NULL;
+
+  close_pending (stats, now_ns ());
+  if (stats->pending_idle != NULL)
+    wl_event_source_remove (stats->pending_idle);
+  stats->pending_idle = NULL;
+}
+
+bool
+xfway_protocol_stats_get_enabled (struct xfway_protocol_stats *stats)
+{
+  return stats->logger != NULL;
+}
+
+void
+xfway_protocol_stats_set_sample_interval (struct xfway_protocol_stats *stats,
+                                          uint32_t                     interval)
+{
+  stats->sample_interval = interval;
+  stats->sample_countdown = interval;
+}
+
+void
+xfway_protocol_stats_reset (struct xfway_protocol_stats *stats)
+{
+  memset (stats->counters, 0, sizeof (stats->counters));
+  stats->n_counters = 0;
+  stats->overflow = 0;
+  stats->pending = NULL;
+  stats->n_samples = 0;
+  stats->sample_countdown = stats->sample_interval;
+}
+
+void
+xfway_protocol_stats_for_each_counter (struct xfway_protocol_stats   *stats,
+                                       xfway_protocol_counter_func_t  func,
+                                       void                          *data)
+{
+  struct xfway_protocol_counter out;
+  struct stats_counter *counter;
+  struct stats_client *sc;
+  unsigned int i;
+
+  for (i = 0; i < COUNTERS_SIZE; i++)
+    {
+      counter = &stats->counters[i];
+      if (counter->message == NULL)
+        continue;
+
+      sc = &stats->clients[counter->client_slot];
+      /* the slot may have been taken by another client since */
+      if (counter->client_id != 0 && sc->id == counter->client_id)
+        {
+          out.pid = sc->pid;
+          out.client_name = sc->client != NULL ? sc->name : NULL;
+        }
+      else
+        {
+          out.pid = 0;
+          out.client_name = NULL;
+        }
+
+      out.client_id = counter->client_id;
+      out.interface = counter->interface;
+      out.message = counter->message->name;
+      out.event = counter->event;
+      out.count = counter->count;
+      out.bytes = counter->bytes;
+      out.dispatch_ns = counter->dispatch_ns;
+      out.max_dispatch_ns = counter->max_dispatch_ns;
+
+      func (&out, data);
+    }
+}
+
+void
+xfway_protocol_stats_for_each_sample (struct xfway_protocol_stats  *stats,
+                                      xfway_protocol_sample_func_t  func,
+                                      void                         *data)
+{
+  struct stats_sample *sample;
+  uint64_t i;
+
+  i = stats->n_samples > SAMPLES_SIZE ? stats->n_samples - SAMPLES_SIZE : 0;
+  for (; i < stats->n_samples; i++)
+    {
+      sample = &stats->samples[i % SAMPLES_SIZE];
+      func (sample->time_ns, sample->client_id, sample->text, data);
+    }
+}
+
+uint64_t
+xfway_protocol_stats_get_overflow (struct xfway_protocol_stats *stats)
+{
+  return stats->overflow;
+}
+
+struct dump_state
+{
+  struct xfway_protocol_counter *counters;
+  unsigned int n_counters;
+  FILE *f;
+};
+
+static void
+collect_counter (const struct xfway_protocol_counter *counter,
+                 void                                *data)
+{
+  struct dump_state *state = data;
+
+  state->counters[state->n_counters++] = *counter;
+}
+
+static int
+compare_client_then_count (const void *a,
+                           const void *b)
+{
+  const struct xfway_protocol_counter *ca = a, *cb = b;
+
+  if (ca->client_id != cb->client_id)
+    return ca->client_id < cb->client_id ? -1 : 1;
+  if (ca->count != cb->count)
+    return ca->count > cb->count ? -1 : 1;
+  return 0;
+}
+
+static int
+compare_count (const void *a,
+               const void *b)
+{
+  const struct xfway_protocol_counter *ca = a, *cb = b;
+
+  if (ca->count != cb->count)
+    return ca->count > cb->count ? -1 : 1;
+  return 0;
+}
+
+static void
+dump_sample (uint64_t    time_ns,
+             uint32_t    client_id,
+             const char *text,
+             void       *data)
+{
+  struct dump_state *state = data;
+
+  fprintf (state->f, "[%10.3f] client %u %s\n", time_ns / 1e6, client_id, text);
+}
+
+static const char *
+counter_client_name (const struct xfway_protocol_counter *counter)
+{
+  if (counter->client_id == 0)
+    return "(clients table full)";
+  if (counter->client_id == XFWAY_PROTOCOL_STATS_GONE_CLIENT)
+    return "(gone)";
+  return counter->client_name ? counter->client_name : "(gone)";
+}
+
+void
+xfway_protocol_stats_dump (struct xfway_protocol_stats *stats,
+                           FILE                        *f)
+{
+  struct dump_state state = { NULL, 0, f };
+  const struct xfway_protocol_counter *c;
+  uint64_t count, bytes, dispatch_ns;
+  unsigned int i, j;
+
+  state.counters = calloc (COUNTERS_SIZE, sizeof (struct xfway_protocol_counter));
+  if (state.counters == NULL)
+    return;
+  xfway_protocol_stats_for_each_counter (stats, collect_counter, &state);
+
+  fprintf (f, "# %u counters, %llu messages did not fit\n",
+           state.n_counters, (unsigned long long) stats->overflow);
+  fprintf (f, "# dispatch times are upper bounds: each runs until the next "
+           "request or until the event loop goes idle\n");
+
+  /* per client totals */
+  qsort (state.counters, state.n_counters, sizeof (*state.counters),
+         compare_client_then_count);
+  fprintf (f, "\n# client pid name messages bytes dispatch_us\n");
+  for (i = 0; i < state.n_counters; i = j)
+    {
+      count = bytes = dispatch_ns = 0;
+      for (j = i; j < state.n_counters && state.counters[j].client_id == state.counters[i].client_id; j++)
+        {
+          count += state.counters[j].count;
+          bytes += state.counters[j].bytes;
+          dispatch_ns += state.counters[j].dispatch_ns;
+        }
+      c = &state.counters[i];
+      fprintf (f, "%u %d %s %llu %llu %.1f\n", c->client_id, (int) c->pid,
+               counter_client_name (c), (unsigned long long) count,
+               (unsigned long long) bytes, dispatch_ns / 1e3);
+    }
+
+  qsort (state.counters, state.n_counters, sizeof (*state.counters), compare_count);
+  fprintf (f, "\n# client message count bytes dispatch_us max_dispatch_us\n");
+  for (i = 0; i < state.n_counters; i++)
+    {
+      c = &state.counters[i];
+      fprintf (f, "%u %s%s.%s %llu %llu %.1f %.1f\n", c->client_id,
+               c->event ? "-> " : "", c->interface, c->message,
+               (unsigned long long) c->count, (unsigned long long) c->bytes,
+               c->dispatch_ns / 1e3, c->max_dispatch_ns / 1e3);
+    }
+
+  fprintf (f, "\n# samples, one message in %u\n", stats->sample_interval);
+  xfway_protocol_stats_for_each_sample (stats, dump_sample, &state);
+
+  free (state.counters);
+}
@@ -0,0 +1,103 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __PROTOCOL_STATS_H__
+#define __PROTOCOL_STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <wayland-server.h>
+
+/* Counts the Wayland messages of every client per interface and message,
+ * from libwayland-server's protocol logger, for finding chatty clients
+ * without WAYLAND_DEBUG. All tables have a fixed size; what does not fit
+ * is counted as overflow rather than growing them. Clients that have
+ * gone are merged into one when room is needed.
+ *
+ * libwayland tells the logger when a request is about to be dispatched
+ * but not when it is done, so a request's dispatch time runs until the
+ * next request or until the event loop next goes idle, whichever comes
+ * first. It is an upper bound.
+ *
+ * Every sample_interval-th message may also be kept in full, in the
+ * manner of WAYLAND_DEBUG, in a ring of the most recent ones. */
+
+struct xfway_protocol_stats;
+
+/* The client_id of the counters of every client that has gone, once they
+ * had to make room */
+#define XFWAY_PROTOCOL_STATS_GONE_CLIENT UINT32_MAX
+
+/* One line of the tables, for xfway_protocol_stats_for_each_counter */
+struct xfway_protocol_counter
+{
+  uint32_t client_id; /* 0 when the client table was full */
+  pid_t pid;
+  const char *client_name; /* NULL once the client is gone */
+  const char *interface;
+  const char *message;
+  bool event; /* sent by the compositor, not a request */
+  uint64_t count;
+  uint64_t bytes;
+  uint64_t dispatch_ns; /* requests only */
+  uint64_t max_dispatch_ns;
+};
+
+typedef void (*xfway_protocol_counter_func_t) (const struct xfway_protocol_counter *counter,
+                                               void                                *data);
+
+typedef void (*xfway_protocol_sample_func_t) (uint64_t    time_ns,
+                                              uint32_t    client_id,
+                                              const char *text,
+                                              void       *data);
+
+struct xfway_protocol_stats *xfway_protocol_stats_create (struct wl_display *display);
+
+void xfway_protocol_stats_destroy (struct xfway_protocol_stats *stats);
+
+/* Adds or removes the protocol logger. The tables are kept while
+ * disabled. */
+void xfway_protocol_stats_set_enabled (struct xfway_protocol_stats *stats,
+                                       bool                         enabled);
+
+bool xfway_protocol_stats_get_enabled (struct xfway_protocol_stats *stats);
+
+/* Keep one message in interval in full, 0 for none */
+void xfway_protocol_stats_set_sample_interval (struct xfway_protocol_stats *stats,
+                                               uint32_t                     interval);
+
+void xfway_protocol_stats_reset (struct xfway_protocol_stats *stats);
+
+/* Counters in no particular order, then samples from oldest to newest */
+void xfway_protocol_stats_for_each_counter (struct xfway_protocol_stats   *stats,
+                                            xfway_protocol_counter_func_t  func,
+                                            void                          *data);
+
+void xfway_protocol_stats_for_each_sample (struct xfway_protocol_stats  *stats,
+                                           xfway_protocol_sample_func_t  func,
+                                           void                         *data);
+
+/* Messages that found no room in the counter table */
+uint64_t xfway_protocol_stats_get_overflow (struct xfway_protocol_stats *stats);
+
+/* Per-client totals, then every counter from the busiest, then the
+ * samples, as text */
+void xfway_protocol_stats_dump (struct xfway_protocol_stats *stats,
+                                FILE                        *f);
+
+#endif /* __PROTOCOL_STATS_H__ */
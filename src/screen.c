@@ -14,6 +14,8 @@
  * along with this library; if not, see <http://www.gnu.org/licenses/>
  */
 
+#include <common/xfwm-common.h>
+
 #include "screen.h"
 
 ScreenInfo *
@@ -27,9 +29,13 @@ myScreenInit (GdkScreen *gscr)
     screen_info->gscr = gscr;
 
     screen_info->toplevel_manager = NULL;
+    screen_info->icon_cache = NULL;
+    screen_info->monitors = monitorsNew ();
 
-    screen_info->windows_stack = NULL;
-    screen_info->windows = NULL;
+    g_queue_init (&screen_info->windows_stack);
+    g_queue_init (&screen_info->windows_mru);
+    screen_info->clients_by_handle = g_hash_table_new (g_direct_hash, g_direct_equal);
+    screen_info->clients_by_id = g_hash_table_new (g_direct_hash, g_direct_equal);
 
     screen_info->clients = NULL;
     screen_info->client_count = 0;
@@ -40,11 +46,54 @@ myScreenInit (GdkScreen *gscr)
 gint
 myScreenGetNumMonitors (ScreenInfo *screen_info)
 {
-    return 1;
+    /* Until the first output is done, GDK still knows about one */
+    return MAX (monitorsGetCount (screen_info->monitors), 1);
 }
 
 gint
 myScreenGetMonitorIndex (ScreenInfo *screen_info, gint idx)
 {
-    return 1;
+    return idx;
+}
+
+void
+myScreenFindMonitorAtPoint (ScreenInfo *screen_info, gint x, gint y, GdkRectangle *rect)
+{
+    const MonitorInfo *info;
+
+    g_return_if_fail (screen_info != NULL);
+    g_return_if_fail (rect != NULL);
+
+    info = monitorsFindAtPoint (screen_info->monitors, x, y);
+    if (!info)
+    {
+        info = monitorsGet (screen_info->monitors, 0);
+    }
+    if (info)
+    {
+        *rect = info->geometry;
+    }
+    else
+    {
+        xfwm_get_monitor_geometry (screen_info->gscr, 0, rect, FALSE);
+    }
+}
+
+void
+myScreenGetXineramaMonitorGeometry (ScreenInfo *screen_info, gint monitor_num, GdkRectangle *rect)
+{
+    const MonitorInfo *info;
+
+    g_return_if_fail (screen_info != NULL);
+    g_return_if_fail (rect != NULL);
+
+    info = monitorsGet (screen_info->monitors, monitor_num);
+    if (info)
+    {
+        *rect = info->geometry;
+    }
+    else
+    {
+        xfwm_get_monitor_geometry (screen_info->gscr, monitor_num, rect, FALSE);
+    }
 }
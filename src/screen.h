@@ -52,6 +52,8 @@
 //#include "mywindow.h"
 //#include "mypixmap.h"
 #include "client.h"
+#include "icons.h"
+#include "monitors.h"
 //#include "hints.h"
 #include <protocol/wlr-foreign-toplevel-management-unstable-v1-client-protocol.h>
 
@@ -93,10 +95,13 @@ struct _ScreenInfo
     /* The display this screen belongs to */
     //DisplayInfo *display_info;
 
-    /* Window stacking, per screen */
-    GList *windows_stack;
+    /* Window stacking, per screen; both queues link Client::stack_link and
+     * Client::mru_link so that adding, removing and raising are O(1) */
+    GQueue windows_stack; /* bottom to top */
+    GQueue windows_mru;   /* most recently activated first */
+    GHashTable *clients_by_handle;
+    GHashTable *clients_by_id;
     Client *last_raise;
-    GList *windows;
     Client *clients;
     guint client_count;
     unsigned long client_serial;
@@ -143,10 +148,8 @@ struct _ScreenInfo
     guint current_ws;
     guint previous_ws;
 
-    /* Monitor search caching */
-    GdkRectangle cache_monitor;
-    gint num_monitors;
-    GArray *monitors_index;
+    /* Outputs of the compositor */
+    Monitors *monitors;
 
     /* Workspace definitions */
     guint workspace_count;
@@ -172,6 +175,7 @@ struct _ScreenInfo
     /* tabwin css provider */
     gboolean tabwin_provider_ready;
     GtkCssProvider *tabwin_provider;
+    IconCache *icon_cache;
 
 #ifdef ENABLE_KDE_SYSTRAY_PROXY
     /* There can be one systray per screen */
@@ -0,0 +1,219 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "server-settings.h"
+
+enum setting_type
+{
+  SETTING_BOOL,
+  SETTING_INT,
+};
+
+static const struct
+{
+  const char *property;
+  enum setting_type type;
+  size_t offset;
+  int32_t default_value;
+  int32_t min;
+  int32_t max;
+} settings_info[XFWAY_SETTING_COUNT] =
+{
+  [XFWAY_SETTING_USE_PIXMAN] =
+    { "/use-pixman", SETTING_BOOL,
+      offsetof (struct xfway_settings, use_pixman), false, false, true },
+  [XFWAY_SETTING_REPAINT_MSEC] =
+    { "/repaint-msec", SETTING_INT,
+      offsetof (struct xfway_settings, repaint_msec), 16, 1, 1000 },
+  [XFWAY_SETTING_IDLE_TIME] =
+    { "/idle-time", SETTING_INT,
+      offsetof (struct xfway_settings, idle_time), 300, 0, 24 * 3600 },
+  [XFWAY_SETTING_KB_REPEAT_RATE] =
+    { "/kb-repeat-rate", SETTING_INT,
+      offsetof (struct xfway_settings, kb_repeat_rate), 40, 0, 1000 },
+  [XFWAY_SETTING_KB_REPEAT_DELAY] =
+    { "/kb-repeat-delay", SETTING_INT,
+      offsetof (struct xfway_settings, kb_repeat_delay), 400, 0, 10000 },
+  [XFWAY_SETTING_TITLE_UPDATE_INTERVAL] =
+    { "/title-update-interval", SETTING_INT,
+      offsetof (struct xfway_settings, title_update_interval), 100, 0, 60000 },
+  [XFWAY_SETTING_SWITCHER_THUMBNAIL_INTERVAL] =
+    { "/switcher-thumbnail-interval", SETTING_INT,
+      offsetof (struct xfway_settings, switcher_thumbnail_interval), 500, 0, 60000 },
+  [XFWAY_SETTING_PROTOCOL_STATS] =
+    { "/debug/protocol-stats", SETTING_BOOL,
+      offsetof (struct xfway_settings, protocol_stats), false, false, true },
+  [XFWAY_SETTING_PROTOCOL_SAMPLE_INTERVAL] =
+    { "/debug/protocol-sample-interval", SETTING_INT,
+      offsetof (struct xfway_settings, protocol_sample_interval), 0, 0, 1000000 },
+  [XFWAY_SETTING_DEBUG_PROTOCOL] =
+    { "/debug/debug-protocol", SETTING_BOOL,
+      offsetof (struct xfway_settings, debug_protocol), false, false, true },
+  [XFWAY_SETTING_LIMIT_SURFACES] =
+    { "/limits/surfaces", SETTING_INT,
+      offsetof (struct xfway_settings, limit_surfaces), 0, 0, 1000000 },
+  [XFWAY_SETTING_LIMIT_VIEWS] =
+    { "/limits/views", SETTING_INT,
+      offsetof (struct xfway_settings, limit_views), 0, 0, 1000000 },
+  [XFWAY_SETTING_LIMIT_SHM_MEGABYTES] =
+    { "/limits/shm-megabytes", SETTING_INT,
+      offsetof (struct xfway_settings, limit_shm_megabytes), 0, 0, 1024 * 1024 },
+  [XFWAY_SETTING_LIMIT_BUFFERS] =
+    { "/limits/buffers", SETTING_INT,
+      offsetof (struct xfway_settings, limit_buffers), 0, 0, 1000000 },
+  [XFWAY_SETTING_LIMIT_LAYER_SURFACES] =
+    { "/limits/layer-surfaces", SETTING_INT,
+      offsetof (struct xfway_settings, limit_layer_surfaces), 0, 0, 1000000 },
+  [XFWAY_SETTING_LIMIT_TOPLEVEL_RESOURCES] =
+    { "/limits/toplevel-resources", SETTING_INT,
+      offsetof (struct xfway_settings, limit_toplevel_resources), 0, 0, 1000000 },
+  [XFWAY_SETTING_LIMIT_SWITCHER_WINDOWS] =
+    { "/limits/switcher-windows", SETTING_INT,
+      offsetof (struct xfway_settings, limit_switcher_windows), 0, 0, 1000000 },
+  [XFWAY_SETTING_LIMIT_DISCONNECT] =
+    { "/limits/disconnect", SETTING_BOOL,
+      offsetof (struct xfway_settings, limit_disconnect), false, false, true },
+};
+
+/* Returns true if the stored value changed */
+static bool
+store_setting (struct xfway_settings *settings,
+               enum xfway_setting     setting,
+               int32_t                value)
+{
+  char *field = (char *) settings + settings_info[setting].offset;
+
+  value = CLAMP (value, settings_info[setting].min, settings_info[setting].max);
+
+  if (settings_info[setting].type == SETTING_BOOL)
+    {
+      bool *b = (bool *) field;
+
+      if (*b == (value != 0))
+        return false;
+      __atomic_store_n (b, value != 0, __ATOMIC_RELAXED);
+    }
+  else
+    {
+      int32_t *i = (int32_t *) field;
+
+      if (*i == value)
+        return false;
+      __atomic_store_n (i, value, __ATOMIC_RELAXED);
+    }
+
+  return true;
+}
+
+/* The value of a GValue from the channel, the default if it was reset or
+ * does not hold a number */
+static int32_t
+value_to_setting (enum xfway_setting  setting,
+                  const GValue       *value)
+{
+  GValue converted = G_VALUE_INIT;
+  int32_t result = settings_info[setting].default_value;
+
+  if (!value || !G_IS_VALUE (value))
+    return result;
+
+  if (settings_info[setting].type == SETTING_BOOL)
+    {
+      g_value_init (&converted, G_TYPE_BOOLEAN);
+      if (g_value_transform (value, &converted))
+        result = g_value_get_boolean (&converted);
+    }
+  else
+    {
+      g_value_init (&converted, G_TYPE_INT);
+      if (g_value_transform (value, &converted))
+        result = g_value_get_int (&converted);
+    }
+  g_value_unset (&converted);
+
+  return result;
+}
+
+static void
+property_changed (XfconfChannel *channel,
+                  const gchar   *property,
+                  const GValue  *value,
+                  gpointer       data)
+{
+  struct xfway_settings *settings = data;
+  enum xfway_setting setting;
+
+  for (setting = 0; setting < XFWAY_SETTING_COUNT; setting++)
+    {
+      if (strcmp (settings_info[setting].property, property) == 0)
+        break;
+    }
+  if (setting == XFWAY_SETTING_COUNT)
+    return;
+
+  if (store_setting (settings, setting, value_to_setting (setting, value)))
+    wl_signal_emit (&settings->changed_signal, &setting);
+}
+
+void
+xfway_settings_init (struct xfway_settings *settings,
+                     XfconfChannel         *channel)
+{
+  enum xfway_setting setting;
+  GValue value = G_VALUE_INIT;
+
+  memset (settings, 0, sizeof (*settings));
+  wl_signal_init (&settings->changed_signal);
+  settings->channel = channel;
+
+  for (setting = 0; setting < XFWAY_SETTING_COUNT; setting++)
+    {
+      /* numbers may have been stored with any integer type */
+      if (xfconf_channel_get_property (channel, settings_info[setting].property, &value))
+        {
+          store_setting (settings, setting, value_to_setting (setting, &value));
+          g_value_unset (&value);
+        }
+      else
+        {
+          store_setting (settings, setting, settings_info[setting].default_value);
+        }
+    }
+
+  settings->property_changed_id = g_signal_connect (channel, "property-changed",
+                                                    G_CALLBACK (property_changed),
+                                                    settings);
+}
+
+void
+xfway_settings_release (struct xfway_settings *settings)
+{
+  if (settings->property_changed_id)
+    g_signal_handler_disconnect (settings->channel, settings->property_changed_id);
+  settings->property_changed_id = 0;
+}
+
+const char *
+xfway_settings_get_property (enum xfway_setting setting)
+{
+  if (setting >= XFWAY_SETTING_COUNT)
+    return NULL;
+
+  return settings_info[setting].property;
+}
@@ -0,0 +1,92 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __SERVER_SETTINGS_H__
+#define __SERVER_SETTINGS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server.h>
+#include <xfconf/xfconf.h>
+
+enum xfway_setting
+{
+  XFWAY_SETTING_USE_PIXMAN,
+  XFWAY_SETTING_REPAINT_MSEC,
+  XFWAY_SETTING_IDLE_TIME,
+  XFWAY_SETTING_KB_REPEAT_RATE,
+  XFWAY_SETTING_KB_REPEAT_DELAY,
+  XFWAY_SETTING_TITLE_UPDATE_INTERVAL,
+  XFWAY_SETTING_SWITCHER_THUMBNAIL_INTERVAL,
+  XFWAY_SETTING_PROTOCOL_STATS,
+  XFWAY_SETTING_PROTOCOL_SAMPLE_INTERVAL,
+  XFWAY_SETTING_DEBUG_PROTOCOL,
+  XFWAY_SETTING_LIMIT_SURFACES,
+  XFWAY_SETTING_LIMIT_VIEWS,
+  XFWAY_SETTING_LIMIT_SHM_MEGABYTES,
+  XFWAY_SETTING_LIMIT_BUFFERS,
+  XFWAY_SETTING_LIMIT_LAYER_SURFACES,
+  XFWAY_SETTING_LIMIT_TOPLEVEL_RESOURCES,
+  XFWAY_SETTING_LIMIT_SWITCHER_WINDOWS,
+  XFWAY_SETTING_LIMIT_DISCONNECT,
+  XFWAY_SETTING_COUNT
+};
+
+/* The compositor's settings from the xfway xfconf channel, kept as plain
+ * fields so hot paths read them without going to xfconf. They follow the
+ * channel: when a property changes the field is updated and
+ * changed_signal is emitted with a pointer to its enum xfway_setting.
+ *
+ * Only the compositor thread writes them, with relaxed atomic stores, so
+ * other threads may read them with __atomic_load_n. */
+struct xfway_settings
+{
+  /* only used at startup, the renderer is chosen once */
+  bool use_pixman;
+  int32_t repaint_msec;
+  int32_t idle_time; /* seconds */
+  int32_t kb_repeat_rate; /* for keyboards bound after a change */
+  int32_t kb_repeat_delay;
+  int32_t title_update_interval; /* ms between title events per toplevel */
+  int32_t switcher_thumbnail_interval; /* ms between thumbnail refreshes */
+  bool protocol_stats; /* count every client's messages */
+  int32_t protocol_sample_interval; /* keep one message in so many, 0 for none */
+  bool debug_protocol; /* advertise the xfway_debug global */
+  /* soft limits per client, 0 for none */
+  int32_t limit_surfaces;
+  int32_t limit_views;
+  int32_t limit_shm_megabytes;
+  int32_t limit_buffers;
+  int32_t limit_layer_surfaces;
+  int32_t limit_toplevel_resources;
+  int32_t limit_switcher_windows;
+  bool limit_disconnect; /* disconnect clients over a limit, not only log them */
+
+  struct wl_signal changed_signal;
+
+  XfconfChannel *channel;
+  gulong property_changed_id;
+};
+
+void xfway_settings_init (struct xfway_settings *settings,
+                          XfconfChannel         *channel);
+
+void xfway_settings_release (struct xfway_settings *settings);
+
+/* The xfconf property of setting, "/repaint-msec" and so on */
+const char *xfway_settings_get_property (enum xfway_setting setting);
+
+#endif /* __SERVER_SETTINGS_H__ */
@@ -34,6 +34,11 @@
 #include <xfconf/xfconf.h>
 #include <protocol/wlr-foreign-toplevel-management-unstable-v1-protocol.h>
 #include "wlr_foreign_toplevel_management_v1.h"
+#include "server-settings.h"
+#include "worker-pool.h"
+#include "protocol-stats.h"
+#include "debug.h"
+#include "client-accounting.h"
 
 struct weston_window_switcher;
 
@@ -50,6 +55,22 @@ struct _xfwmDisplay
     } api;
 
   XfconfChannel *channel;
+  /* typed cache of channel, follows its changes */
+  struct xfway_settings settings;
+  struct wl_listener settings_listener;
+
+  /* background work whose results come back on the event loop */
+  struct xfway_worker_pool *workers;
+
+  /* message counts per client, while enabled in the settings */
+  struct xfway_protocol_stats *protocol_stats;
+
+  /* what each client holds, with the soft limits from the settings */
+  struct xfway_client_accounting *accounting;
+
+  /* the xfway_debug global, advertised while enabled in the settings */
+  struct xfway_debug *debug;
+  struct wl_listener debug_snapshot_listener;
 
   struct weston_layer black_background_layer;
   struct weston_layer background_layer;
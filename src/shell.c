@@ -22,6 +22,10 @@
 #include <protocol/wlr-layer-shell-unstable-v1-protocol.h>
 #include "wlr_foreign_toplevel_management_v1.h"
 #include "wlr_layer_shell_v1.h"
+#include "window-table.h"
+#include "keybindings.h"
+#include "log.h"
+#include "trace.h"
 #include <util/helpers.h>
 
 struct _Shell
@@ -32,8 +36,33 @@ struct _Shell
 
   struct wlr_layer_shell_v1 *layer_shell;
 
+  struct weston_window_switcher *switcher;
+
   struct wl_list focus_list;
 
+  uint32_t next_window_id;
+  struct wl_listener toplevel_resource_listener;
+
+  /* created on the first xfway_shell.get_window_table */
+  struct xfway_window_table *window_table;
+  uint32_t mru_clock;
+
+  struct wl_listener output_created_listener;
+  struct wl_listener output_moved_listener;
+  struct wl_listener settings_listener;
+
+  /* reported in xfway_debug snapshots */
+  struct wl_listener debug_snapshot_listener;
+  uint64_t focus_changes;
+  uint64_t grabs_started;
+  uint64_t grab_motions;
+
+  /* shortcuts of the xfconf channel, see shell_keybindings_init */
+  struct xfway_keybindings keybindings;
+  struct wl_list key_grabs;
+  struct xkb_keymap *keymap;
+  gulong shortcuts_changed_id;
+
   struct {
 		struct wl_client *client;
 		struct wl_resource *desktop_shell;
@@ -67,12 +96,23 @@ struct _CWindowWayland
   struct weston_output *output;
   struct wl_listener output_destroy_listener;
 
+  /* stable id shared with the shell client through xfway_shell */
+  uint32_t id;
+
   struct wlr_foreign_toplevel_handle_v1 *toplevel_handle;
   struct wl_listener toplevel_handle_request_activate;
   struct wl_listener toplevel_handle_request_close;
+  struct wl_listener toplevel_handle_done;
+
+  /* activation stamp from Shell::mru_clock */
+  uint32_t mru_rank;
+  int window_table_index;
 
   struct wl_listener desktop_surface_metadata_signal;
 
+  /* from weston_window_switcher_surface_added, NULL without a switcher */
+  struct weston_window_switcher_window *switcher_window;
+
   bool maximized;
 };
 
@@ -102,14 +142,32 @@ struct ShellMoveGrab
   wl_fixed_t dx, dy;
 };
 
+struct weston_window_switcher_window;
+
 WL_EXPORT int
 weston_window_switcher_module_init (struct weston_compositor *compositor,
                                     struct weston_window_switcher **out_switcher,
                                     int argc, char *argv[]);
 
+struct weston_window_switcher_window *
+weston_window_switcher_surface_added (struct weston_window_switcher *switcher,
+                                      struct weston_desktop_surface *dsurface);
+
+void
+weston_window_switcher_surface_removed (struct weston_window_switcher        *switcher,
+                                        struct weston_window_switcher_window *window);
+
+void
+weston_window_switcher_surface_committed (struct weston_window_switcher        *switcher,
+                                          struct weston_window_switcher_window *window);
+
+void
+weston_window_switcher_set_thumbnail_interval (struct weston_window_switcher *switcher,
+                                               uint32_t                       interval);
+
 void
-_weston_window_switcher_window_create (struct weston_window_switcher *switcher,
-                                       struct weston_surface         *surface);
+weston_window_switcher_set_worker_pool (struct weston_window_switcher *switcher,
+                                        struct xfway_worker_pool      *workers);
 
 void
 activate (Shell *shell,
@@ -294,6 +352,83 @@ get_shell_surface(struct weston_surface *surface)
 	return NULL;
 }
 
+/* Tell taskbars which outputs the window is on. The view transform is
+ * brought up to date first so its output mask reflects the new geometry
+ * rather than the one from the last repaint. */
+static void
+shell_surface_update_toplevel_outputs (CWindowWayland *cw)
+{
+  if (!cw->toplevel_handle || !weston_view_is_mapped (cw->view))
+    return;
+
+  weston_view_update_transform (cw->view);
+  wlr_foreign_toplevel_handle_v1_set_output_mask (cw->toplevel_handle,
+                                                  cw->view->output_mask);
+}
+
+static void
+handle_outputs_changed (Shell *shell)
+{
+  struct weston_view *view;
+
+  wl_list_for_each (view, &shell->xfwm_display->surfaces_layer.view_list.link,
+                    layer_link.link)
+    {
+      CWindowWayland *cw = get_shell_surface (view->surface);
+
+      if (cw && cw->view == view)
+        shell_surface_update_toplevel_outputs (cw);
+    }
+}
+
+#ifdef XFWAY_ENABLE_TRACING
+/* libweston has no hook around a repaint, so the backend's own is wrapped.
+ * All outputs of a backend share the same one. */
+static int (*backend_output_repaint) (struct weston_output *output,
+                                      pixman_region32_t    *damage,
+                                      void                 *repaint_data);
+
+static int
+traced_output_repaint (struct weston_output *output,
+                       pixman_region32_t    *damage,
+                       void                 *repaint_data)
+{
+  XFWAY_TRACE_SPAN ("repaint");
+
+  return backend_output_repaint (output, damage, repaint_data);
+}
+
+static void
+trace_output_repaint (struct weston_output *output)
+{
+  if (output->repaint == traced_output_repaint)
+    return;
+
+  backend_output_repaint = output->repaint;
+  output->repaint = traced_output_repaint;
+}
+#endif
+
+static void
+handle_output_created (struct wl_listener *listener, void *data)
+{
+  Shell *shell = wl_container_of (listener, shell, output_created_listener);
+
+#ifdef XFWAY_ENABLE_TRACING
+  trace_output_repaint (data);
+#endif
+
+  handle_outputs_changed (shell);
+}
+
+static void
+handle_output_moved (struct wl_listener *listener, void *data)
+{
+  Shell *shell = wl_container_of (listener, shell, output_moved_listener);
+
+  handle_outputs_changed (shell);
+}
+
 static void handle_toplevel_handle_request_activate (struct wl_listener *listener,
                                                      void               *data)
 {
@@ -317,6 +452,35 @@ static void handle_toplevel_handle_request_close (struct wl_listener *listener,
   weston_desktop_surface_close (cw->desktop_surface);
 }
 
+static void
+shell_surface_publish (CWindowWayland *cw)
+{
+  struct wlr_foreign_toplevel_handle_v1 *toplevel = cw->toplevel_handle;
+  Shell *shell = cw->shell;
+
+  if (!shell->window_table || !toplevel)
+    return;
+
+  cw->window_table_index = xfway_window_table_set (shell->window_table,
+                                                   cw->window_table_index,
+                                                   cw->id,
+                                                   toplevel->state,
+                                                   cw->mru_rank,
+                                                   toplevel->output_mask,
+                                                   toplevel->title,
+                                                   toplevel->app_id);
+}
+
+/* the table follows the coalesced done events, and titles as they
+ * change, see handle_desktop_surface_metadata_signal */
+static void handle_toplevel_handle_done (struct wl_listener *listener,
+                                         void               *data)
+{
+  CWindowWayland *cw = wl_container_of (listener, cw, toplevel_handle_done);
+
+  shell_surface_publish (cw);
+}
+
 static void handle_desktop_surface_metadata_signal (struct wl_listener *listener,
                                                     void               *data)
 {
@@ -324,6 +488,8 @@ static void handle_desktop_surface_metadata_signal (struct wl_listener *listener
 
   CWindowWayland *cw = wl_container_of (listener, cw, desktop_surface_metadata_signal);
 
+  /* unchanged fields are dropped by the foreign toplevel handle, and the
+   * rest go out together with the next done event */
   title = weston_desktop_surface_get_title (cw->desktop_surface);
   if (title)
     wlr_foreign_toplevel_handle_v1_set_title (cw->toplevel_handle, title);
@@ -331,6 +497,55 @@ static void handle_desktop_surface_metadata_signal (struct wl_listener *listener
   app_id = weston_desktop_surface_get_app_id (cw->desktop_surface);
   if (app_id)
     wlr_foreign_toplevel_handle_v1_set_app_id (cw->toplevel_handle, app_id);
+
+  /* A title held back by the rate limiter gets no done event until its
+   * timer fires, but the handle already has it. Writing the table costs
+   * no event, so it gets every title. */
+  shell_surface_publish (cw);
+}
+
+static uint32_t
+shell_desktop_shell_version (Shell *shell)
+{
+  if (!shell->child.desktop_shell)
+    return 0;
+
+  return wl_resource_get_version (shell->child.desktop_shell);
+}
+
+static void
+send_toplevel_id (Shell              *shell,
+                  CWindowWayland     *cw,
+                  struct wl_resource *resource)
+{
+  if (shell_desktop_shell_version (shell) < XFWAY_SHELL_TOPLEVEL_ID_SINCE_VERSION)
+    return;
+
+  if (wl_resource_get_client (resource) != shell->child.client)
+    return;
+
+  xfway_shell_send_toplevel_id (shell->child.desktop_shell, resource, cw->id);
+}
+
+static void
+handle_toplevel_resource (struct wl_listener *listener,
+                          void               *data)
+{
+  Shell *shell = wl_container_of (listener, shell, toplevel_resource_listener);
+  struct wlr_foreign_toplevel_handle_v1_resource_event *event = data;
+
+  /* NULL while surface_added is still creating the handle; it sends the
+   * id itself once the handle is set up */
+  if (event->toplevel->data)
+    send_toplevel_id (shell, event->toplevel->data, event->resource);
+}
+
+/* The desktop client outlives its surfaces, unlike the wl_surface
+ * resource */
+static struct wl_client *
+shell_surface_get_client (CWindowWayland *cw)
+{
+  return weston_desktop_client_get_client (weston_desktop_surface_get_client (cw->desktop_surface));
 }
 
 void surface_added (struct weston_desktop_surface *desktop_surface,
@@ -355,11 +570,20 @@ void surface_added (struct weston_desktop_surface *desktop_surface,
 
   self->surface = weston_desktop_surface_get_surface (self->desktop_surface);
   self->view = weston_desktop_surface_create_view (self->desktop_surface);
+  xfway_client_accounting_add (xfwm_display->accounting,
+                               shell_surface_get_client (self), XFWAY_CLIENT_VIEWS, 1);
 
   weston_surface_damage (self->surface);
   weston_compositor_schedule_repaint (xfwm_display->compositor);
 
+  self->id = ++shell->next_window_id;
+  self->window_table_index = -1;
   self->toplevel_handle = wlr_foreign_toplevel_handle_v1_create (shell->manager);
+  self->toplevel_handle->data = self;
+
+  struct wl_resource *resource;
+  wl_resource_for_each (resource, &self->toplevel_handle->resources)
+    send_toplevel_id (shell, self, resource);
 
   self->toplevel_handle_request_activate.notify =
     handle_toplevel_handle_request_activate;
@@ -369,11 +593,18 @@ void surface_added (struct weston_desktop_surface *desktop_surface,
     handle_toplevel_handle_request_close;
   wl_signal_add (&self->toplevel_handle->events.request_close,
                  &self->toplevel_handle_request_close);
+  self->toplevel_handle_done.notify = handle_toplevel_handle_done;
+  wl_signal_add (&self->toplevel_handle->events.done,
+                 &self->toplevel_handle_done);
 
   self->desktop_surface_metadata_signal.notify = handle_desktop_surface_metadata_signal;
   weston_desktop_surface_add_metadata_listener (desktop_surface,
                                                 &self->desktop_surface_metadata_signal);
 
+  if (shell->switcher)
+    self->switcher_window = weston_window_switcher_surface_added (shell->switcher,
+                                                                  desktop_surface);
+
 
 
   weston_desktop_surface_set_activated (desktop_surface, true);
@@ -402,14 +633,24 @@ void surface_removed (struct weston_desktop_surface *desktop_surface,
 
   wl_signal_emit (&self->destroy_signal, self);
 
+  if (shell->switcher)
+    weston_window_switcher_surface_removed (shell->switcher, self->switcher_window);
+  self->switcher_window = NULL;
+
+  if (shell->window_table)
+    xfway_window_table_remove (shell->window_table, self->window_table_index);
+
   if (self->toplevel_handle)
     {
+      wl_list_remove (&self->toplevel_handle_done.link);
       wlr_foreign_toplevel_handle_v1_destroy (self->toplevel_handle);
       self->toplevel_handle = NULL;
     }
 
   weston_desktop_surface_unlink_view (self->view);
   weston_view_destroy (self->view);
+  xfway_client_accounting_add (server->accounting,
+                               shell_surface_get_client (self), XFWAY_CLIENT_VIEWS, -1);
   weston_desktop_surface_set_user_data (desktop_surface, NULL);
 
   if (self->output_destroy_listener.notify)
@@ -489,6 +730,7 @@ map(xfwmDisplay *shell, CWindowWayland *cw,
   if (app_id)
     wlr_foreign_toplevel_handle_v1_set_app_id (cw->toplevel_handle, app_id);
 
+  shell_surface_update_toplevel_outputs (cw);
 }
 
 static void
@@ -505,9 +747,16 @@ desktop_surface_committed(struct weston_desktop_surface *desktop_surface,
 	bool was_fullscreen;
 	bool was_maximized;
 
+	XFWAY_TRACE_FUNC();
+
+	xfway_debug_surface_committed (xfwm_display->debug, surface);
+
 	if (surface->width == 0)
 		return;
 
+  if (shell->switcher)
+    weston_window_switcher_surface_committed (shell->switcher, cw->switcher_window);
+
   was_maximized = cw->maximized;
 
   cw->maximized =
@@ -544,6 +793,7 @@ desktop_surface_committed(struct weston_desktop_surface *desktop_surface,
   cw->last_width = surface->width;
 	cw->last_height = surface->height;
 
+  shell_surface_update_toplevel_outputs (cw);
 }
 
 static void
@@ -661,6 +911,8 @@ activate (Shell *shell,
   struct focus_state *state;
   struct weston_surface *old_es;
 
+  XFWAY_TRACE_FUNC ();
+
   main_surface = weston_surface_get_main_surface (view->surface);
   cw = get_shell_surface (main_surface);
   if (cw == NULL)
@@ -694,6 +946,10 @@ activate (Shell *shell,
     }
 
     focus_state_set_focus (state, view->surface);
+  shell->focus_changes++;
+
+  cw->mru_rank = ++shell->mru_clock;
+  shell_surface_publish (cw);
 
       weston_view_geometry_dirty (cw->view);
       weston_layer_entry_remove (&cw->view->layer_link);
@@ -748,6 +1004,7 @@ shell_grab_start (struct ShellGrab                     *grab,
   wl_signal_add (&cw->destroy_signal,
                  &grab->shsurf_destroy_listener);
   cw->grabbed = 1;
+  cw->shell->grabs_started++;
 
   weston_pointer_start_grab (pointer, &grab->grab);
 }
@@ -805,15 +1062,19 @@ move_grab_motion(struct weston_pointer_grab *grab,
 	struct weston_surface *surface;
 	int cx, cy;
 
+	XFWAY_TRACE_FUNC();
+
 	weston_pointer_move(pointer, event);
 	if (!cw)
 		return;
+	cw->shell->grab_motions++;
 
 	surface = weston_desktop_surface_get_surface(cw->desktop_surface);
 
 	constrain_position(move, &cx, &cy);
 
 	weston_view_set_position(cw->view, cx, cy);
+	shell_surface_update_toplevel_outputs(cw);
 
 	weston_compositor_schedule_repaint(surface->compositor);
 }
@@ -911,10 +1172,13 @@ resize_grab_motion(struct weston_pointer_grab *grab,
 	wl_fixed_t from_x, from_y;
 	wl_fixed_t to_x, to_y;
 
+	XFWAY_TRACE_FUNC();
+
 	weston_pointer_move(pointer, event);
 
 	if (!shsurf)
 		return;
+	shsurf->shell->grab_motions++;
 
 	weston_view_from_global_fixed(shsurf->view,
 				      pointer->grab_x, pointer->grab_y,
@@ -1156,6 +1420,7 @@ struct switcher {
 	struct wl_listener listener;
 	struct weston_keyboard_grab grab;
 	struct wl_array minimized_array;
+	bool announced;
 };
 
 static void
@@ -1176,7 +1441,10 @@ switcher_next(struct switcher *switcher)
 		*minimized = view;
 	}*/
 
-  xfway_shell_send_tabwin_next (switcher->shell->child.desktop_shell);
+	XFWAY_TRACE_FUNC();
+
+  if (shell_desktop_shell_version (switcher->shell) == 1)
+    xfway_shell_send_tabwin_next (switcher->shell->child.desktop_shell);
 
 	wl_list_for_each(view, &switcher->shell->xfwm_display->surfaces_layer.view_list.link, layer_link.link) {
 		shsurf = get_shell_surface(view->surface);
@@ -1212,6 +1480,9 @@ switcher_next(struct switcher *switcher)
 		view->alpha = 1.0;
 
 	shsurf = get_shell_surface(switcher->current->surface);
+	if (shsurf && switcher->announced &&
+	    shell_desktop_shell_version (switcher->shell) >= XFWAY_SHELL_TABWIN_SELECT_SINCE_VERSION)
+		xfway_shell_send_tabwin_select (switcher->shell->child.desktop_shell, shsurf->id);
 	//if (shsurf && weston_desktop_surface_get_fullscreen(shsurf->desktop_surface))
 		//shsurf->fullscreen.black_view->alpha = 1.0;
 }
@@ -1263,7 +1534,8 @@ switcher_destroy(struct switcher *switcher)
 	}
 	wl_array_release(&switcher->minimized_array);*/
 
-  xfway_shell_send_tabwin_destroy (switcher->shell->child.desktop_shell);
+  if (switcher->shell->child.desktop_shell)
+    xfway_shell_send_tabwin_destroy (switcher->shell->child.desktop_shell);
 
 	free(switcher);
 }
@@ -1305,6 +1577,45 @@ static const struct weston_keyboard_grab_interface switcher_grab = {
 	switcher_cancel,
 };
 
+/* Send the whole switcher state in one event, windows in stacking order,
+ * which activation keeps most recently used first. */
+static void
+send_tabwin_list (struct switcher       *switcher,
+                  const struct timespec *time)
+{
+  Shell *shell = switcher->shell;
+  struct weston_view *view;
+  CWindowWayland *cw;
+  struct wl_array windows;
+  uint32_t *id, selected = 0;
+
+  wl_array_init (&windows);
+
+  wl_list_for_each (view, &shell->xfwm_display->surfaces_layer.view_list.link, layer_link.link)
+    {
+      cw = get_shell_surface (view->surface);
+      if (!cw || cw->view != view)
+        continue;
+
+      id = wl_array_add (&windows, sizeof (*id));
+      if (!id)
+        break;
+      *id = cw->id;
+    }
+
+  if (switcher->current)
+    {
+      cw = get_shell_surface (switcher->current->surface);
+      if (cw)
+        selected = cw->id;
+    }
+
+  xfway_shell_send_tabwin_list (shell->child.desktop_shell,
+                                time->tv_sec * 1000 + time->tv_nsec / 1000000,
+                                &windows, selected);
+  wl_array_release (&windows);
+}
+
 static void
 tabwin_binding (struct weston_keyboard *keyboard,
                 const struct timespec  *time,
@@ -1317,6 +1628,7 @@ tabwin_binding (struct weston_keyboard *keyboard,
 	switcher = malloc(sizeof *switcher);
 	switcher->shell = shell;
 	switcher->current = NULL;
+	switcher->announced = false;
 	switcher->listener.notify = switcher_handle_view_destroy;
 	wl_list_init(&switcher->listener.link);
 	wl_array_init(&switcher->minimized_array);
@@ -1327,13 +1639,46 @@ tabwin_binding (struct weston_keyboard *keyboard,
 	weston_keyboard_set_focus(keyboard, NULL);
 	switcher_next(switcher);
 
-  xfway_shell_send_tabwin (shell->child.desktop_shell);
+  if (shell_desktop_shell_version (shell) >= XFWAY_SHELL_TABWIN_LIST_SINCE_VERSION)
+    send_tabwin_list (switcher, time);
+  else if (shell->child.desktop_shell)
+    xfway_shell_send_tabwin (shell->child.desktop_shell);
+
+  switcher->announced = true;
 }
 
-/*static const struct xfway_shell_interface xfway_desktop_shell_implementation =
+static void
+desktop_shell_get_window_table (struct wl_client   *client,
+                                struct wl_resource *resource)
 {
+  Shell *shell = wl_resource_get_user_data (resource);
+  struct wlr_foreign_toplevel_handle_v1 *toplevel;
 
-};*/
+  if (!shell->window_table)
+    {
+      shell->window_table = xfway_window_table_create ();
+      if (!shell->window_table)
+        {
+          wl_client_post_no_memory (client);
+          return;
+        }
+
+      wl_list_for_each (toplevel, &shell->manager->toplevels, link)
+        {
+          if (toplevel->data)
+            shell_surface_publish (toplevel->data);
+        }
+    }
+
+  xfway_shell_send_window_table (resource,
+                                 xfway_window_table_get_fd (shell->window_table),
+                                 xfway_window_table_get_size (shell->window_table));
+}
+
+static const struct xfway_shell_interface xfway_desktop_shell_implementation =
+{
+  desktop_shell_get_window_table,
+};
 
 static void
 unbind_desktop_shell(struct wl_resource *resource)
@@ -1351,15 +1696,25 @@ bind_desktop_shell(struct wl_client *client,
 	struct wl_resource *resource;
 
 	resource = wl_resource_create(client, &xfway_shell_interface,
-				      1, id);
+				      MIN(version, 3), id);
 
-  weston_log ("\nbind desktop shell\n");
+  xfway_log_debug (XFWAY_LOG_SCOPE_SHELL, "bind desktop shell\n");
 
 	if (client == shell->child.client) {
 		wl_resource_set_implementation(resource,
-					       NULL,
+					       &xfway_desktop_shell_implementation,
 					       shell, unbind_desktop_shell);
 		shell->child.desktop_shell = resource;
+
+		/* handles the client got before binding us still need ids */
+		struct wlr_foreign_toplevel_handle_v1 *toplevel;
+		struct wl_resource *toplevel_resource;
+		wl_list_for_each(toplevel, &shell->manager->toplevels, link) {
+			if (!toplevel->data)
+				continue;
+			wl_resource_for_each(toplevel_resource, &toplevel->resources)
+				send_toplevel_id(shell, toplevel->data, toplevel_resource);
+		}
 		return;
 	}
 
@@ -1405,7 +1760,7 @@ launch_desktop_shell_process(void *data)
   shell->child.client = weston_client_start (xfwm_display->compositor, client);
 
 	if (!shell->child.client) {
-		weston_log("not able to start client");
+		xfway_log_error (XFWAY_LOG_SCOPE_SHELL, "not able to start client\n");
 		return;
 	}
 
@@ -1415,6 +1770,394 @@ launch_desktop_shell_process(void *data)
 				       &shell->child.client_destroy_listener);
 }
 
+#ifdef XFWAY_ENABLE_TEST_FIXTURES
+/* Toplevel handles without a surface behind them, used to measure how long
+ * a taskbar takes to receive the initial toplevel list of a large session
+ * (see tests/test-toplevel-snapshot). Built with --enable-test-fixtures
+ * only. */
+static void
+create_synthetic_toplevels (Shell *shell, int count)
+{
+  struct wlr_foreign_toplevel_handle_v1 *handle;
+  char title[32];
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      handle = wlr_foreign_toplevel_handle_v1_create (shell->manager);
+      if (!handle)
+        return;
+
+      snprintf (title, sizeof (title), "synthetic %d", i);
+      wlr_foreign_toplevel_handle_v1_set_title (handle, title);
+      wlr_foreign_toplevel_handle_v1_set_app_id (handle, "xfway-synthetic");
+    }
+}
+#endif
+
+/* Shortcuts are properties of the xfconf channel named after the
+ * accelerator, /shortcuts/<Alt>F4 = "close_window_key". weston only
+ * knows keycodes: each (keycode, modifiers) a bound keysym sits on holds
+ * one weston key binding, shared by refcount, and a key press on it is
+ * looked up in the compiled table. */
+
+#define SHORTCUTS_PROPERTY "/shortcuts/"
+
+struct key_grab
+{
+  Shell *shell;
+  uint32_t key;
+  uint32_t modifiers;
+  int refcount;
+  struct weston_binding *binding;
+  struct wl_list link; /* Shell::key_grabs */
+};
+
+struct keycode_match
+{
+  xkb_keysym_t keysym;
+  xkb_keycode_t keycodes[8];
+  unsigned n;
+};
+
+/* bound unless the channel says otherwise */
+static const struct
+{
+  const char *accelerator;
+  enum xfway_action action;
+} default_shortcuts[] =
+{
+  { "<Alt>Tab", XFWAY_ACTION_CYCLE_WINDOWS },
+  { "<Alt>F4", XFWAY_ACTION_CLOSE_WINDOW },
+  { "<Alt>F10", XFWAY_ACTION_MAXIMIZE_WINDOW },
+};
+
+static void
+shell_run_action (Shell                  *shell,
+                  struct weston_keyboard *keyboard,
+                  const struct timespec  *time,
+                  uint32_t                key,
+                  enum xfway_action       action)
+{
+  CWindowWayland *cw = NULL;
+
+  if (keyboard->focus)
+    cw = get_shell_surface (weston_surface_get_main_surface (keyboard->focus));
+
+  switch (action)
+    {
+    case XFWAY_ACTION_CYCLE_WINDOWS:
+      tabwin_binding (keyboard, time, key, shell);
+      break;
+    case XFWAY_ACTION_CLOSE_WINDOW:
+      if (cw)
+        weston_desktop_surface_close (cw->desktop_surface);
+      break;
+    case XFWAY_ACTION_MAXIMIZE_WINDOW:
+      if (cw)
+        set_maximized (cw, !cw->maximized);
+      break;
+    case XFWAY_ACTION_RAISE_WINDOW:
+      if (cw)
+        activate (shell, cw->view, keyboard->seat, 0);
+      break;
+    default:
+      xfway_log_warning (XFWAY_LOG_SCOPE_SHELL, "shortcut action %s is not supported\n",
+                         xfway_action_get_name (action));
+      break;
+    }
+}
+
+static void
+key_grab_binding (struct weston_keyboard *keyboard,
+                  const struct timespec  *time,
+                  uint32_t                key,
+                  void                   *data)
+{
+  struct key_grab *grab = data;
+  Shell *shell = grab->shell;
+  const xkb_keysym_t *syms;
+  xkb_layout_index_t layout;
+  enum xfway_action action;
+
+  layout = xkb_state_key_get_layout (keyboard->xkb_state.state, key + 8);
+  if (xkb_keymap_key_get_syms_by_level (keyboard->xkb_info->keymap, key + 8,
+                                        layout, 0, &syms) < 1)
+    return;
+
+  action = xfway_keybindings_lookup (&shell->keybindings, syms[0],
+                                     keyboard->seat->modifier_state);
+  if (action != XFWAY_ACTION_NONE)
+    shell_run_action (shell, keyboard, time, key, action);
+}
+
+static struct xkb_keymap *
+shell_get_keymap (Shell *shell)
+{
+  struct weston_compositor *compositor = shell->xfwm_display->compositor;
+  struct weston_keyboard *keyboard;
+  struct weston_seat *seat;
+
+  if (compositor->xkb_info)
+    return compositor->xkb_info->keymap;
+
+  wl_list_for_each (seat, &compositor->seat_list, link)
+    {
+      keyboard = weston_seat_get_keyboard (seat);
+      if (keyboard && keyboard->xkb_info)
+        return keyboard->xkb_info->keymap;
+    }
+
+  /* no keyboard yet, it will get the keymap of the rule names */
+  if (!shell->keymap && compositor->xkb_context)
+    shell->keymap = xkb_keymap_new_from_names (compositor->xkb_context,
+                                               &compositor->xkb_names,
+                                               XKB_KEYMAP_COMPILE_NO_FLAGS);
+
+  return shell->keymap;
+}
+
+static void
+match_keycode (struct xkb_keymap *keymap,
+               xkb_keycode_t      keycode,
+               void              *data)
+{
+  struct keycode_match *match = data;
+  xkb_layout_index_t layout, n_layouts;
+  const xkb_keysym_t *syms;
+  int i, n;
+
+  n_layouts = xkb_keymap_num_layouts_for_key (keymap, keycode);
+  for (layout = 0; layout < n_layouts; layout++)
+    {
+      n = xkb_keymap_key_get_syms_by_level (keymap, keycode, layout, 0, &syms);
+      for (i = 0; i < n; i++)
+        {
+          if (syms[i] == match->keysym && match->n < ARRAY_LENGTH (match->keycodes))
+            {
+              match->keycodes[match->n++] = keycode;
+              return;
+            }
+        }
+    }
+}
+
+/* Takes (delta 1) or drops (delta -1) the weston key bindings keysym
+ * needs with modifiers. */
+static void
+shell_grab_keysym (Shell        *shell,
+                   xkb_keysym_t  keysym,
+                   uint32_t      modifiers,
+                   int           delta)
+{
+  struct weston_compositor *compositor = shell->xfwm_display->compositor;
+  struct xkb_keymap *keymap = shell_get_keymap (shell);
+  struct keycode_match match = { keysym, { 0 }, 0 };
+  struct key_grab *grab, *found;
+  unsigned i;
+
+  if (!keymap)
+    return;
+
+  xkb_keymap_key_for_each (keymap, match_keycode, &match);
+
+  for (i = 0; i < match.n; i++)
+    {
+      uint32_t key = match.keycodes[i] - 8;
+
+      found = NULL;
+      wl_list_for_each (grab, &shell->key_grabs, link)
+        {
+          if (grab->key == key && grab->modifiers == modifiers)
+            {
+              found = grab;
+              break;
+            }
+        }
+
+      if (!found)
+        {
+          if (delta < 0)
+            continue;
+          found = zalloc (sizeof *found);
+          if (!found)
+            continue;
+          found->shell = shell;
+          found->key = key;
+          found->modifiers = modifiers;
+          found->binding = weston_compositor_add_key_binding (compositor, key, modifiers,
+                                                              key_grab_binding, found);
+          wl_list_insert (&shell->key_grabs, &found->link);
+        }
+
+      found->refcount += delta;
+      if (found->refcount <= 0)
+        {
+          weston_binding_destroy (found->binding);
+          wl_list_remove (&found->link);
+          free (found);
+        }
+    }
+}
+
+/* Only the binding of accelerator changes, the others keep their weston
+ * key bindings. */
+static void
+shell_set_shortcut (Shell             *shell,
+                    const char        *accelerator,
+                    enum xfway_action  action)
+{
+  xkb_keysym_t keysym;
+  uint32_t modifiers;
+  enum xfway_action previous;
+
+  if (!xfway_keybindings_parse (accelerator, &keysym, &modifiers))
+    {
+      xfway_log_warning (XFWAY_LOG_SCOPE_SHELL, "cannot parse shortcut %s\n", accelerator);
+      return;
+    }
+
+  previous = xfway_keybindings_set (&shell->keybindings, keysym, modifiers, action);
+  if (previous == XFWAY_ACTION_NONE && action != XFWAY_ACTION_NONE)
+    shell_grab_keysym (shell, keysym, modifiers, 1);
+  else if (previous != XFWAY_ACTION_NONE && action == XFWAY_ACTION_NONE)
+    shell_grab_keysym (shell, keysym, modifiers, -1);
+}
+
+static enum xfway_action
+default_shortcut_action (const char *accelerator)
+{
+  xkb_keysym_t keysym, default_keysym;
+  uint32_t modifiers, default_modifiers;
+  unsigned i;
+
+  if (!xfway_keybindings_parse (accelerator, &keysym, &modifiers))
+    return XFWAY_ACTION_NONE;
+
+  for (i = 0; i < ARRAY_LENGTH (default_shortcuts); i++)
+    {
+      xfway_keybindings_parse (default_shortcuts[i].accelerator,
+                               &default_keysym, &default_modifiers);
+      if (keysym == default_keysym && modifiers == default_modifiers)
+        return default_shortcuts[i].action;
+    }
+
+  return XFWAY_ACTION_NONE;
+}
+
+static void
+shortcut_changed (XfconfChannel *channel,
+                  const gchar   *property,
+                  const GValue  *value,
+                  gpointer       data)
+{
+  Shell *shell = data;
+  const char *accelerator;
+  enum xfway_action action;
+
+  if (!g_str_has_prefix (property, SHORTCUTS_PROPERTY))
+    return;
+  accelerator = property + strlen (SHORTCUTS_PROPERTY);
+
+  /* a reset property goes back to the default, an unknown action
+   * unbinds */
+  if (G_VALUE_HOLDS_STRING (value))
+    action = xfway_action_from_name (g_value_get_string (value));
+  else
+    action = default_shortcut_action (accelerator);
+
+  shell_set_shortcut (shell, accelerator, action);
+}
+
+static void
+shell_keybindings_init (Shell *shell)
+{
+  XfconfChannel *channel = shell->xfwm_display->channel;
+  GHashTable *properties;
+  GHashTableIter iter;
+  gpointer property, value;
+  unsigned i;
+
+  xfway_keybindings_init (&shell->keybindings);
+  wl_list_init (&shell->key_grabs);
+
+  for (i = 0; i < ARRAY_LENGTH (default_shortcuts); i++)
+    shell_set_shortcut (shell, default_shortcuts[i].accelerator,
+                        default_shortcuts[i].action);
+
+  properties = xfconf_channel_get_properties (channel, "/shortcuts");
+  if (properties)
+    {
+      g_hash_table_iter_init (&iter, properties);
+      while (g_hash_table_iter_next (&iter, &property, &value))
+        shortcut_changed (channel, property, value, shell);
+      g_hash_table_destroy (properties);
+    }
+
+  shell->shortcuts_changed_id = g_signal_connect (channel, "property-changed",
+                                                  G_CALLBACK (shortcut_changed),
+                                                  shell);
+}
+
+/* Throttles can be tuned on a running session */
+static void
+handle_settings_changed (struct wl_listener *listener,
+                         void               *data)
+{
+  Shell *shell = wl_container_of (listener, shell, settings_listener);
+  struct xfway_settings *settings = &shell->xfwm_display->settings;
+  enum xfway_setting *setting = data;
+
+  switch (*setting)
+    {
+    case XFWAY_SETTING_TITLE_UPDATE_INTERVAL:
+      wlr_foreign_toplevel_manager_v1_set_title_interval (shell->manager,
+                                                          settings->title_update_interval);
+      break;
+    case XFWAY_SETTING_SWITCHER_THUMBNAIL_INTERVAL:
+      if (shell->switcher)
+        weston_window_switcher_set_thumbnail_interval (shell->switcher,
+                                                       settings->switcher_thumbnail_interval);
+      break;
+    default:
+      break;
+    }
+}
+
+static void
+handle_debug_snapshot (struct wl_listener *listener,
+                       void               *data)
+{
+  Shell *shell = wl_container_of (listener, shell, debug_snapshot_listener);
+  struct xfway_debug_snapshot *snapshot = data;
+  struct wlr_foreign_toplevel_title_stats *stats;
+  char name[128];
+
+  xfway_debug_snapshot_add (snapshot, "shell", "focus_changes", shell->focus_changes);
+  xfway_debug_snapshot_add (snapshot, "shell", "grabs_started", shell->grabs_started);
+  xfway_debug_snapshot_add (snapshot, "shell", "grab_motions", shell->grab_motions);
+
+  xfway_debug_snapshot_add (snapshot, "foreign-toplevel", "resources",
+                            wl_list_length (&shell->manager->resources));
+  xfway_debug_snapshot_add (snapshot, "foreign-toplevel", "toplevels",
+                            wl_list_length (&shell->manager->toplevels));
+  wl_list_for_each (stats, &shell->manager->title_stats, link)
+    {
+      snprintf (name, sizeof (name), "title_suppressed %s",
+                stats->app_id[0] ? stats->app_id : "(none)");
+      xfway_debug_snapshot_add (snapshot, "foreign-toplevel", name, stats->suppressed);
+    }
+
+  xfway_debug_snapshot_add (snapshot, "layer-shell", "resources",
+                            wl_list_length (&shell->layer_shell->resources));
+  xfway_debug_snapshot_add (snapshot, "layer-shell", "surfaces",
+                            wl_list_length (&shell->layer_shell->surfaces));
+  xfway_debug_snapshot_add (snapshot, "layer-shell", "configures_sent",
+                            shell->layer_shell->configures_sent);
+  xfway_debug_snapshot_add (snapshot, "layer-shell", "configures_acked",
+                            shell->layer_shell->configures_acked);
+}
+
 void xfway_server_shell_init (xfwmDisplay *server, int argc, char *argv[])
 {
   Shell *shell;
@@ -1422,6 +2165,12 @@ void xfway_server_shell_init (xfwmDisplay *server, int argc, char *argv[])
   int ret;
   struct weston_client *client;
   struct wl_event_loop *loop;
+#ifdef XFWAY_ENABLE_TEST_FIXTURES
+  const char *synthetic_toplevels;
+#endif
+#ifdef XFWAY_ENABLE_TRACING
+  struct weston_output *output;
+#endif
 
   shell = zalloc (sizeof (Shell));
   shell->xfwm_display = server;
@@ -1445,12 +2194,54 @@ void xfway_server_shell_init (xfwmDisplay *server, int argc, char *argv[])
   weston_layer_init (&server->overlay_layer, server->compositor);
   weston_layer_set_position (&server->overlay_layer, WESTON_LAYER_POSITION_LOCK);
 
-  shell->manager = wlr_foreign_toplevel_manager_v1_create (server->compositor->wl_display);
+  shell->manager = wlr_foreign_toplevel_manager_v1_create (server->compositor);
+  shell->toplevel_resource_listener.notify = handle_toplevel_resource;
+  wl_signal_add (&shell->manager->events.new_resource,
+                 &shell->toplevel_resource_listener);
+  wlr_foreign_toplevel_manager_v1_set_title_interval (shell->manager,
+                                                      server->settings.title_update_interval);
+
+#ifdef XFWAY_ENABLE_TEST_FIXTURES
+  synthetic_toplevels = getenv ("XFWAY_SYNTHETIC_TOPLEVELS");
+  if (synthetic_toplevels)
+    create_synthetic_toplevels (shell, atoi (synthetic_toplevels));
+#endif
 
   shell->layer_shell = wlr_layer_shell_v1_create (server->compositor->wl_display, server);
 
+  if (weston_window_switcher_module_init (server->compositor, &shell->switcher,
+                                          argc, argv) < 0)
+    shell->switcher = NULL;
+  else
+    {
+      weston_window_switcher_set_thumbnail_interval (shell->switcher,
+                                                     server->settings.switcher_thumbnail_interval);
+      weston_window_switcher_set_worker_pool (shell->switcher, server->workers);
+    }
+  shell->settings_listener.notify = handle_settings_changed;
+  wl_signal_add (&server->settings.changed_signal, &shell->settings_listener);
+
+  if (server->debug)
+    {
+      shell->debug_snapshot_listener.notify = handle_debug_snapshot;
+      wl_signal_add (xfway_debug_get_snapshot_signal (server->debug),
+                     &shell->debug_snapshot_listener);
+    }
+
+  shell->output_created_listener.notify = handle_output_created;
+  wl_signal_add (&server->compositor->output_created_signal,
+                 &shell->output_created_listener);
+#ifdef XFWAY_ENABLE_TRACING
+  /* the backend has enabled its outputs by now */
+  wl_list_for_each (output, &server->compositor->output_list, link)
+    trace_output_repaint (output);
+#endif
+  shell->output_moved_listener.notify = handle_output_moved;
+  wl_signal_add (&server->compositor->output_moved_signal,
+                 &shell->output_moved_listener);
+
   wl_global_create (server->compositor->wl_display,
-                    &xfway_shell_interface, 1,
+                    &xfway_shell_interface, 3,
                     shell, bind_desktop_shell);
 
   loop = wl_display_get_event_loop(server->compositor->wl_display);
@@ -1462,7 +2253,5 @@ void xfway_server_shell_init (xfwmDisplay *server, int argc, char *argv[])
   weston_compositor_add_button_binding (server->compositor, BTN_RIGHT, 0,
                                         click_to_activate_binding,
                                         shell);
-  weston_compositor_add_key_binding (server->compositor, KEY_TAB, MODIFIER_ALT,
-                                     tabwin_binding,
-                                     shell);
+  shell_keybindings_init (shell);
 }
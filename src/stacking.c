@@ -59,8 +59,19 @@ clientAddToList (Client * c)
         c->prev = c;
     }
 
-    screen_info->windows = g_list_append (screen_info->windows, c);
-    screen_info->windows_stack = g_list_append (screen_info->windows_stack, c);
+    c->stack_link.data = c;
+    g_queue_push_tail_link (&screen_info->windows_stack, &c->stack_link);
+    c->mru_link.data = c;
+    g_queue_push_tail_link (&screen_info->windows_mru, &c->mru_link);
+
+    if (c->toplevel_handle)
+    {
+        g_hash_table_insert (screen_info->clients_by_handle, c->toplevel_handle, c);
+    }
+    if (c->id)
+    {
+        g_hash_table_insert (screen_info->clients_by_id, GUINT_TO_POINTER (c->id), c);
+    }
 
     //clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST], screen_info->windows);
 
@@ -98,11 +109,91 @@ clientRemoveFromList (Client * c)
         }
     }
 
-    screen_info->windows = g_list_remove (screen_info->windows, c);
-    screen_info->windows_stack = g_list_remove (screen_info->windows_stack, c);
+    g_queue_unlink (&screen_info->windows_stack, &c->stack_link);
+    g_queue_unlink (&screen_info->windows_mru, &c->mru_link);
+
+    if (c->toplevel_handle)
+    {
+        g_hash_table_remove (screen_info->clients_by_handle, c->toplevel_handle);
+    }
+    if (c->id)
+    {
+        g_hash_table_remove (screen_info->clients_by_id, GUINT_TO_POINTER (c->id));
+    }
+    if (screen_info->last_raise == c)
+    {
+        screen_info->last_raise = NULL;
+    }
 
     //clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST], screen_info->windows);
     //clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST_STACKING], screen_info->windows_stack);
 
     //FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_MANAGED);
 }
+
+void
+clientSetId (Client *c, guint32 id)
+{
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c != NULL);
+
+    screen_info = c->screen_info;
+    if (c->id)
+    {
+        g_hash_table_remove (screen_info->clients_by_id, GUINT_TO_POINTER (c->id));
+    }
+    c->id = id;
+    if (c->id)
+    {
+        g_hash_table_insert (screen_info->clients_by_id, GUINT_TO_POINTER (c->id), c);
+    }
+}
+
+Client *
+clientGetFromHandle (ScreenInfo *screen_info,
+                     struct zwlr_foreign_toplevel_handle_v1 *toplevel_handle)
+{
+    g_return_val_if_fail (screen_info != NULL, NULL);
+
+    return g_hash_table_lookup (screen_info->clients_by_handle, toplevel_handle);
+}
+
+Client *
+clientGetFromId (ScreenInfo *screen_info, guint32 id)
+{
+    g_return_val_if_fail (screen_info != NULL, NULL);
+
+    return g_hash_table_lookup (screen_info->clients_by_id, GUINT_TO_POINTER (id));
+}
+
+void
+clientRaise (Client *c)
+{
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c != NULL);
+
+    screen_info = c->screen_info;
+    if (screen_info->windows_stack.tail != &c->stack_link)
+    {
+        g_queue_unlink (&screen_info->windows_stack, &c->stack_link);
+        g_queue_push_tail_link (&screen_info->windows_stack, &c->stack_link);
+    }
+    screen_info->last_raise = c;
+}
+
+void
+clientSetLastActive (Client *c)
+{
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c != NULL);
+
+    screen_info = c->screen_info;
+    if (screen_info->windows_mru.head != &c->mru_link)
+    {
+        g_queue_unlink (&screen_info->windows_mru, &c->mru_link);
+        g_queue_push_head_link (&screen_info->windows_mru, &c->mru_link);
+    }
+}
@@ -33,5 +33,13 @@
 
 void                     clientAddToList                        (Client *);
 void                     clientRemoveFromList                   (Client *);
+void                     clientSetId                            (Client *,
+                                                                 guint32);
+Client                  *clientGetFromHandle                    (ScreenInfo *,
+                                                                 struct zwlr_foreign_toplevel_handle_v1 *);
+Client                  *clientGetFromId                        (ScreenInfo *,
+                                                                 guint32);
+void                     clientRaise                            (Client *);
+void                     clientSetLastActive                    (Client *);
 
 #endif /* INC_STACKING_H */
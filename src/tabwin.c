@@ -51,7 +51,7 @@
 
 #include <common/xfwm-common.h>
 
-//#include "icons.h"
+#include "icons.h"
 //#include "focus.h"
 #include "client.h"
 #include "tabwin.h"
@@ -239,21 +239,33 @@ tabwinSetLabel (TabwinWidget *tabwin_widget, GtkWidget *buttonlabel, gchar *clas
 }
 
 static void
-tabwinSetSelected (TabwinWidget *tabwin_widget, GtkWidget *w, GtkWidget *l)
+tabwinSetSelected (TabwinWidget *tabwin_widget, TabwinCell *cell)
 {
+    ScreenInfo *screen_info;
+    TabwinCell *previous;
     Client *c;
     gchar *classname;
 
     g_return_if_fail (tabwin_widget);
-    g_return_if_fail (GTK_IS_WIDGET(w));
+    g_return_if_fail (cell != NULL);
 
-    if (tabwin_widget->selected)
+    screen_info = tabwin_widget->tabwin->screen_info;
+    previous = tabwin_widget->selected;
+    if (previous && previous != cell)
     {
-        gtk_widget_unset_state_flags (tabwin_widget->selected, GTK_STATE_FLAG_ACTIVE);
+        gtk_widget_unset_state_flags (previous->window_button, GTK_STATE_FLAG_ACTIVE);
+        /* don't clear label if mouse is inside the previously
+         * selected button */
+        if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID
+            && previous != tabwin_widget->hovered)
+        {
+            gtk_label_set_text (GTK_LABEL (previous->label), "");
+        }
     }
-    tabwin_widget->selected = w;
-    gtk_widget_set_state_flags (w, GTK_STATE_FLAG_ACTIVE, FALSE);
-    c = g_object_get_data (G_OBJECT (tabwin_widget->selected), "client-ptr-val");
+    tabwin_widget->selected = cell;
+    gtk_widget_grab_focus (cell->window_button);
+    gtk_widget_set_state_flags (cell->window_button, GTK_STATE_FLAG_ACTIVE, FALSE);
+    c = cell->c;
 
     if (c != NULL)
     {
@@ -266,77 +278,72 @@ tabwinSetSelected (TabwinWidget *tabwin_widget, GtkWidget *w, GtkWidget *l)
         }
 
         //classname = g_strdup(c->class.res_class);
-        //tabwinSetLabel (tabwin_widget, l, classname, c->name, c->win_workspace);
+        //tabwinSetLabel (tabwin_widget, cell->label, classname, c->name, c->win_workspace);
         //g_free (classname);
     }
 }
 
-static Client *
-tabwinSelectWidget (Tabwin *tabwin)
+/* Shown for windows whose icon the IconCache has not resolved yet, or
+ * could not find. It is loaded once per icon size rather than once per
+ * cell. */
+static cairo_surface_t *
+getDefaultIcon (Tabwin *tabwin)
 {
-    GList *tabwin_list, *widgets, *selected, *children;
-    GtkWidget *window_button, *buttonbox, *buttonlabel;
-    TabwinWidget *tabwin_widget;
-    Client *c;
+    GtkIconTheme *icon_theme;
+    GdkPixbuf *icon_pixbuf;
+    gint scale;
 
-    g_return_val_if_fail (tabwin != NULL, NULL);
-    //TRACE ("entering");
+    if (tabwin->default_icon && tabwin->default_icon_size == tabwin->icon_size)
+    {
+        return tabwin->default_icon;
+    }
 
-    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    if (tabwin->default_icon)
     {
-        tabwin_widget = (TabwinWidget *) tabwin_list->data;
-        for (widgets = tabwin_widget->widgets; widgets; widgets = g_list_next (widgets))
-        {
-            window_button = GTK_WIDGET (widgets->data);
-            children = gtk_container_get_children (GTK_CONTAINER (window_button));
-            buttonbox = GTK_WIDGET (g_list_nth_data (children, 0));
-            g_list_free (children);
+        cairo_surface_destroy (tabwin->default_icon);
+        tabwin->default_icon = NULL;
+    }
 
-            children = gtk_container_get_children (GTK_CONTAINER (buttonbox));
-            buttonlabel = GTK_WIDGET (g_list_nth_data (children, 1) );
-            g_list_free (children);
-            gtk_label_set_text (GTK_LABEL (buttonlabel), "");
+    scale = MAX (tabwin->icon_scale, 1);
+    icon_theme = gtk_icon_theme_get_for_screen (tabwin->screen_info->gscr);
+    icon_pixbuf = gtk_icon_theme_load_icon (icon_theme, "xfwm4-default",
+                                            tabwin->icon_size * scale, 0, NULL);
+    if (icon_pixbuf != NULL)
+    {
+        tabwin->default_icon = gdk_cairo_surface_create_from_pixbuf (icon_pixbuf, scale, NULL);
+        g_object_unref (icon_pixbuf);
+    }
+    tabwin->default_icon_size = tabwin->icon_size;
 
-            if (gtk_widget_is_focus (window_button))
-            {
-                c = g_object_get_data (G_OBJECT (window_button), "client-ptr-val");
-                selected = g_list_find (*tabwin->client_list, c);
+    return tabwin->default_icon;
+}
 
-                if (selected)
-                {
-                    tabwin->selected = selected;
-                }
+static cairo_surface_t *
+getClientIcon (Tabwin *tabwin, Client *c)
+{
+    cairo_surface_t *surface;
 
-                tabwinSetSelected (tabwin_widget, window_button, buttonlabel);
-                gtk_widget_queue_draw (GTK_WIDGET (tabwin_widget));
-            }
-        }
+    surface = NULL;
+    if (tabwin->screen_info->icon_cache)
+    {
+        /* asks for the icon to be loaded if it is not there yet */
+        surface = iconCacheLookup (tabwin->screen_info->icon_cache, c->app_id,
+                                   tabwin->icon_size, MAX (tabwin->icon_scale, 1));
     }
 
-    return tabwinGetSelected (tabwin);
+    return surface ? surface : getDefaultIcon (tabwin);
 }
 
 static GtkWidget *
-createWindowIcon (GdkScreen *screen, GdkPixbuf *icon_pixbuf, gint size, gint scale)
+createWindowIcon (cairo_surface_t *surface)
 {
-    GtkIconTheme *icon_theme;
     GtkWidget * icon;
-    cairo_surface_t *surface;
 
     //TRACE ("entering");
 
-    if (icon_pixbuf == NULL)
-    {
-        icon_theme = gtk_icon_theme_get_for_screen (screen);
-        icon_pixbuf = gtk_icon_theme_load_icon (icon_theme, "xfwm4-default",
-                                                size * scale, 0, NULL);
-    }
-
     icon = gtk_image_new ();
-    surface = gdk_cairo_surface_create_from_pixbuf (icon_pixbuf, scale, NULL);
     if (surface != NULL) {
         gtk_image_set_from_surface (GTK_IMAGE (icon), surface);
-        cairo_surface_destroy (surface);
     }
     return icon;
 }
@@ -344,40 +351,36 @@ createWindowIcon (GdkScreen *screen, GdkPixbuf *icon_pixbuf, gint size, gint sca
 static int
 getMinMonitorWidth (ScreenInfo *screen_info)
 {
-    int i, min_width, num_monitors = myScreenGetNumMonitors (screen_info);
-    for (min_width = i = 0; i < num_monitors; i++)
+    GdkRectangle monitor;
+
+    /* kept up to date by the monitor model as outputs change */
+    if (screen_info->monitors->min_width > 0)
     {
-        GdkRectangle monitor;
-        xfwm_get_monitor_geometry (screen_info->gscr, i, &monitor, FALSE);
-        if (min_width == 0 || monitor.width < min_width)
-            min_width = monitor.width;
+        return screen_info->monitors->min_width;
     }
-    return min_width;
+    xfwm_get_monitor_geometry (screen_info->gscr, 0, &monitor, FALSE);
+    return monitor.width;
 }
 
 static int
 getMinMonitorHeight (ScreenInfo *screen_info)
 {
-    int i, min_height, num_monitors = myScreenGetNumMonitors (screen_info);
-    for (min_height = i = 0; i < num_monitors; i++)
+    GdkRectangle monitor;
+
+    if (screen_info->monitors->min_height > 0)
     {
-        GdkRectangle monitor;
-        xfwm_get_monitor_geometry (screen_info->gscr, i, &monitor, FALSE);
-        if (min_height == 0 || monitor.height < min_height)
-        {
-            min_height = monitor.height;
-        }
+        return screen_info->monitors->min_height;
     }
-    return min_height;
+    xfwm_get_monitor_geometry (screen_info->gscr, 0, &monitor, FALSE);
+    return monitor.height;
 }
 
 static gboolean
 cb_window_button_enter (GtkWidget *widget, GdkEvent *event, gpointer user_data)
 {
     TabwinWidget *tabwin_widget = user_data;
+    TabwinCell *cell;
     Client *c;
-    GtkWidget *buttonbox, *buttonlabel;
-    GList *children;
     gchar *classname;
 
    // TRACE ("entering");
@@ -385,9 +388,9 @@ cb_window_button_enter (GtkWidget *widget, GdkEvent *event, gpointer user_data)
     g_return_val_if_fail (tabwin_widget != NULL, FALSE);
 
     /* keep track of which widget we're hovered over */
-    tabwin_widget->hovered = widget;
-
-    c = g_object_get_data (G_OBJECT (widget), "client-ptr-val");
+    cell = g_object_get_data (G_OBJECT (widget), "tabwin-cell");
+    tabwin_widget->hovered = cell;
+    c = cell->c;
 
     /* when hovering over a window icon, display it's label but don't
      * select it */
@@ -399,16 +402,8 @@ cb_window_button_enter (GtkWidget *widget, GdkEvent *event, gpointer user_data)
             return FALSE;
         }
 
-        children = gtk_container_get_children (GTK_CONTAINER (widget));
-        buttonbox = GTK_WIDGET (g_list_nth_data (children, 0));
-        g_list_free (children);
-
-        children = gtk_container_get_children (GTK_CONTAINER (buttonbox));
-        buttonlabel = GTK_WIDGET (g_list_nth_data (children, 1));
-        g_list_free (children);
-
         //classname = g_strdup (c->class.res_class);
-        //tabwinSetLabel (tabwin_widget, buttonlabel, classname, c->name, c->win_workspace);
+        //tabwinSetLabel (tabwin_widget, cell->label, classname, c->name, c->win_workspace);
         //g_free (classname);
     }
 
@@ -419,6 +414,7 @@ static gboolean
 cb_window_button_leave (GtkWidget *widget, GdkEvent *event, gpointer user_data)
 {
     TabwinWidget *tabwin_widget = user_data;
+    TabwinCell *cell;
     Client *c;
 
     //TRACE ("entering");
@@ -433,7 +429,8 @@ cb_window_button_leave (GtkWidget *widget, GdkEvent *event, gpointer user_data)
         return FALSE;
     }
 
-    c = g_object_get_data (G_OBJECT (widget), "client-ptr-val");
+    cell = g_object_get_data (G_OBJECT (widget), "tabwin-cell");
+    c = cell->c;
 
     /* when hovering over a window icon, display it's label but don't
      * select it */
@@ -445,135 +442,397 @@ cb_window_button_leave (GtkWidget *widget, GdkEvent *event, gpointer user_data)
             return FALSE;
         }
 
-        /* reselect the selected widget, it will clear everything else out */
-        tabwinSelectWidget (tabwin_widget->tabwin);
+        /* only the selected cell keeps its label */
+        if (cell != tabwin_widget->selected)
+        {
+            gtk_label_set_text (GTK_LABEL (cell->label), "");
+        }
     }
 
     return FALSE;
 }
 
-static GtkWidget *
-createWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
+static void
+setWindowButtonSize (Tabwin *tabwin, GtkWidget *window_button)
 {
-    Client *c;
-    GList *client_list;
-    GList *icon_list;
-    GtkWidget *windowlist;
-    GtkWidget *icon;
-    GtkWidget *selected;
-    GtkWidget *window_button;
-    GtkWidget *buttonbox;
-    GtkWidget *buttonlabel;
-    GtkWidget *selected_label;
-    GdkPixbuf *icon_pixbuf;
-    gint packpos;
-    gint label_width;
     gint size_request;
+    gint label_width;
+
+    if (tabwin->screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+    {
+        size_request = tabwin->icon_size + tabwin->label_height + 2 * WIN_ICON_BORDER;
+        gtk_widget_set_size_request (GTK_WIDGET (window_button), size_request, size_request);
+    }
+    else
+    {
+        label_width = tabwin->monitor_width / (tabwin->grid_cols + 1);
+
+        if (tabwin->icon_size < tabwin->label_height)
+        {
+            gtk_widget_set_size_request (GTK_WIDGET (window_button),
+                                         label_width, tabwin->label_height + 8);
+        }
+        else
+        {
+            gtk_widget_set_size_request (GTK_WIDGET (window_button),
+                                         label_width, tabwin->icon_size + 8);
+        }
+    }
+}
+
+static TabwinCell *
+createWindowCell (TabwinWidget *tabwin_widget, Client *c)
+{
+    ScreenInfo *screen_info;
+    TabwinCell *cell;
+    GtkWidget *buttonbox;
     Tabwin *tabwin;
 
-    //TRACE ("entering");
-    g_return_val_if_fail (tabwin_widget != NULL, NULL);
     tabwin = tabwin_widget->tabwin;
-    g_return_val_if_fail (tabwin->client_count > 0, NULL);
+    screen_info = tabwin->screen_info;
+
+    cell = g_new0 (TabwinCell, 1);
+    cell->c = c;
+
+    cell->window_button = gtk_button_new ();
+    gtk_button_set_relief (GTK_BUTTON (cell->window_button), GTK_RELIEF_NONE);
+    g_object_set_data (G_OBJECT (cell->window_button), "tabwin-cell", cell);
+    g_signal_connect (cell->window_button, "enter-notify-event",
+                      G_CALLBACK (cb_window_button_enter), tabwin_widget);
+    g_signal_connect (cell->window_button, "leave-notify-event",
+                      G_CALLBACK (cb_window_button_leave), tabwin_widget);
+    gtk_widget_add_events (cell->window_button, GDK_ENTER_NOTIFY_MASK);
+
+    /* pool cells of the virtual grid get their client when bound */
+    cell->icon = createWindowIcon (c ? getClientIcon (tabwin, c) : getDefaultIcon (tabwin));
+    if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+    {
+        buttonbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+        cell->label = gtk_label_new ("");
+        gtk_label_set_xalign (GTK_LABEL (cell->label), 0.5);
+        gtk_label_set_yalign (GTK_LABEL (cell->label), 1.0);
+
+        gtk_widget_set_halign (cell->icon, GTK_ALIGN_CENTER);
+        gtk_widget_set_valign (cell->icon, GTK_ALIGN_END);
+        gtk_box_pack_start (GTK_BOX (buttonbox), cell->icon, TRUE, TRUE, 0);
+    }
+    else
+    {
+        buttonbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        cell->label = gtk_label_new (c ? c->name : "");
+        gtk_label_set_xalign (GTK_LABEL (cell->label), 0);
+        gtk_label_set_yalign (GTK_LABEL (cell->label), 0.5);
+
+        gtk_widget_set_halign (cell->icon, GTK_ALIGN_CENTER);
+        gtk_widget_set_valign (cell->icon, GTK_ALIGN_CENTER);
+        gtk_box_pack_start (GTK_BOX (buttonbox), cell->icon, FALSE, FALSE, 0);
+    }
+    gtk_container_add (GTK_CONTAINER (cell->window_button), buttonbox);
 
-    packpos = 0;
-    c = NULL;
-    selected = NULL;
-    tabwin_widget->widgets = NULL;
-    size_request = tabwin->icon_size + tabwin->label_height + 2 * WIN_ICON_BORDER;
+    gtk_label_set_justify (GTK_LABEL (cell->label), GTK_JUSTIFY_CENTER);
+    gtk_label_set_ellipsize (GTK_LABEL (cell->label), PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start (GTK_BOX (buttonbox), cell->label, TRUE, TRUE, 0);
 
-    windowlist = gtk_grid_new ();
-    gtk_grid_set_row_homogeneous (GTK_GRID (windowlist), TRUE);
-    gtk_grid_set_row_spacing (GTK_GRID (windowlist), 4);
-    gtk_grid_set_column_homogeneous (GTK_GRID (windowlist), TRUE);
-    gtk_grid_set_column_spacing (GTK_GRID (windowlist), 4);
+    setWindowButtonSize (tabwin, cell->window_button);
 
-    /* pack the client icons */
-    icon_list = tabwin->icon_list;
-    for (client_list = *tabwin->client_list; client_list; client_list = g_list_next (client_list))
-    {
-        c = (Client *) client_list->data;
-        //TRACE ("adding \"%s\" (0x%lx)", c->name, c->window);
-        icon_pixbuf = (GdkPixbuf *) icon_list->data;
-        icon_list = g_list_next (icon_list);
-
-        window_button = gtk_button_new ();
-        gtk_button_set_relief (GTK_BUTTON (window_button), GTK_RELIEF_NONE);
-        g_object_set_data (G_OBJECT (window_button), "client-ptr-val", c);
-        g_signal_connect (window_button, "enter-notify-event",
-                          G_CALLBACK (cb_window_button_enter), tabwin_widget);
-        g_signal_connect (window_button, "leave-notify-event",
-                          G_CALLBACK (cb_window_button_leave), tabwin_widget);
-        gtk_widget_add_events (window_button, GDK_ENTER_NOTIFY_MASK);
-
-        icon = createWindowIcon (screen_info->gscr, icon_pixbuf, tabwin->icon_size, tabwin->icon_scale);
-        if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+    /* stays hidden until a tabwinShow lists the client */
+    gtk_widget_show_all (buttonbox);
+
+    return cell;
+}
+
+static TabwinCell *
+addWindowCell (TabwinWidget *tabwin_widget, Client *c)
+{
+    TabwinCell *cell;
+
+    cell = createWindowCell (tabwin_widget, c);
+    gtk_grid_attach (GTK_GRID (tabwin_widget->container), cell->window_button,
+                     0, 0, 1, 1);
+    g_hash_table_insert (tabwin_widget->cells, c, cell);
+
+    return cell;
+}
+
+static void
+destroyVirtualPool (TabwinWidget *tabwin_widget)
+{
+    gint i;
+
+    for (i = 0; i < tabwin_widget->pool_size; i++)
+    {
+        gtk_container_remove (GTK_CONTAINER (tabwin_widget->layout),
+                              tabwin_widget->pool[i]->window_button);
+        g_free (tabwin_widget->pool[i]);
+    }
+    g_free (tabwin_widget->pool);
+    g_free (tabwin_widget->pool_rows);
+    tabwin_widget->pool = NULL;
+    tabwin_widget->pool_rows = NULL;
+    tabwin_widget->pool_size = 0;
+    tabwin_widget->selected = NULL;
+    tabwin_widget->hovered = NULL;
+}
+
+/* One row of cells per visible row of the viewport, data row r is shown
+ * by pool row r % visible_rows. */
+static void
+createVirtualPool (TabwinWidget *tabwin_widget)
+{
+    Tabwin *tabwin;
+    TabwinCell *cell;
+    gint pool_size, i;
+
+    tabwin = tabwin_widget->tabwin;
+    pool_size = tabwin->visible_rows * tabwin->grid_cols;
+    if (pool_size == tabwin_widget->pool_size)
+    {
+        return;
+    }
+
+    destroyVirtualPool (tabwin_widget);
+    tabwin_widget->pool = g_new0 (TabwinCell *, pool_size);
+    tabwin_widget->pool_rows = g_new (gint, tabwin->visible_rows);
+    for (i = 0; i < pool_size; i++)
+    {
+        cell = createWindowCell (tabwin_widget, NULL);
+        gtk_layout_put (GTK_LAYOUT (tabwin_widget->layout), cell->window_button, 0, 0);
+        tabwin_widget->pool[i] = cell;
+    }
+    tabwin_widget->pool_size = pool_size;
+}
+
+/* Every cell goes back unbound: a client kept from before may be gone,
+ * and a new one allocated in its place must not be taken for it */
+static void
+resetVirtualPool (TabwinWidget *tabwin_widget)
+{
+    gint i;
+
+    for (i = 0; i < tabwin_widget->tabwin->visible_rows; i++)
+    {
+        tabwin_widget->pool_rows[i] = -1;
+    }
+    for (i = 0; i < tabwin_widget->pool_size; i++)
+    {
+        tabwin_widget->pool[i]->c = NULL;
+        gtk_widget_hide (tabwin_widget->pool[i]->window_button);
+    }
+}
+
+static void
+bindVirtualRow (TabwinWidget *tabwin_widget, gint row)
+{
+    Tabwin *tabwin;
+    TabwinCell *cell;
+    Client *c;
+    gint pool_row, col, index;
+
+    tabwin = tabwin_widget->tabwin;
+    pool_row = row % tabwin->visible_rows;
+    if (tabwin_widget->pool_rows[pool_row] == row)
+    {
+        return;
+    }
+    tabwin_widget->pool_rows[pool_row] = row;
+
+    for (col = 0; col < tabwin->grid_cols; col++)
+    {
+        cell = tabwin_widget->pool[pool_row * tabwin->grid_cols + col];
+        index = row * tabwin->grid_cols + col;
+        if (index >= (gint) tabwin->clients->len)
         {
-            gtk_widget_set_size_request (GTK_WIDGET (window_button), size_request, size_request);
-            buttonbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
-            buttonlabel = gtk_label_new ("");
-            gtk_label_set_xalign (GTK_LABEL (buttonlabel), 0.5);
-            gtk_label_set_yalign (GTK_LABEL (buttonlabel), 1.0);
-
-            gtk_widget_set_halign (icon, GTK_ALIGN_CENTER);
-            gtk_widget_set_valign (icon, GTK_ALIGN_END);
-            gtk_box_pack_start (GTK_BOX (buttonbox), icon, TRUE, TRUE, 0);
+            cell->c = NULL;
+            gtk_widget_hide (cell->window_button);
+            continue;
         }
-        else
-        {
-            label_width = tabwin->monitor_width / (tabwin->grid_cols + 1);
 
-            if (tabwin->icon_size < tabwin->label_height)
-            {
-                gtk_widget_set_size_request (GTK_WIDGET (window_button),
-                                             label_width, tabwin->label_height + 8);
-            }
-            else
-            {
-                gtk_widget_set_size_request (GTK_WIDGET (window_button),
-                                             label_width, tabwin->icon_size + 8);
-            }
-            buttonbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
-            buttonlabel = gtk_label_new (c->name);
-            gtk_label_set_xalign (GTK_LABEL (buttonlabel), 0);
-            gtk_label_set_yalign (GTK_LABEL (buttonlabel), 0.5);
-
-            gtk_widget_set_halign (icon, GTK_ALIGN_CENTER);
-            gtk_widget_set_valign (icon, GTK_ALIGN_CENTER);
-            gtk_box_pack_start (GTK_BOX (buttonbox), icon, FALSE, FALSE, 0);
+        c = g_ptr_array_index (tabwin->clients, index);
+        if (cell->c != c)
+        {
+            cell->c = c;
+            gtk_image_set_from_surface (GTK_IMAGE (cell->icon), getClientIcon (tabwin, c));
         }
-        gtk_container_add (GTK_CONTAINER (window_button), buttonbox);
+        gtk_layout_move (GTK_LAYOUT (tabwin_widget->layout), cell->window_button,
+                         col * tabwin->cell_size, row * tabwin->cell_size);
+        gtk_widget_show (cell->window_button);
+    }
+}
 
-        gtk_label_set_justify (GTK_LABEL (buttonlabel), GTK_JUSTIFY_CENTER);
-        gtk_label_set_ellipsize (GTK_LABEL (buttonlabel), PANGO_ELLIPSIZE_END);
-        gtk_box_pack_start (GTK_BOX (buttonbox), buttonlabel, TRUE, TRUE, 0);
+/* Bind the rows in view and scroll to them */
+static void
+scrollVirtualGrid (TabwinWidget *tabwin_widget)
+{
+    Tabwin *tabwin;
+    GtkAdjustment *adjustment;
+    gint row, last;
 
-        if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+    tabwin = tabwin_widget->tabwin;
+    last = MIN (tabwin->first_row + tabwin->visible_rows, tabwin->grid_rows);
+    for (row = tabwin->first_row; row < last; row++)
+    {
+        bindVirtualRow (tabwin_widget, row);
+    }
+
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tabwin_widget->layout));
+    gtk_adjustment_set_value (adjustment, tabwin->first_row * tabwin->cell_size);
+}
+
+/* The cell showing the client at index, O(1) in both modes */
+static TabwinCell *
+getCell (TabwinWidget *tabwin_widget, gint index)
+{
+    Tabwin *tabwin;
+    gint row;
+
+    tabwin = tabwin_widget->tabwin;
+    if (!tabwin->virtual)
+    {
+        return g_ptr_array_index (tabwin_widget->slots, index);
+    }
+
+    row = index / tabwin->grid_cols;
+    return tabwin_widget->pool[(row % tabwin->visible_rows) * tabwin->grid_cols +
+                               index % tabwin->grid_cols];
+}
+
+/* Move the selection to index, wrapping around. Only the previously
+ * selected cell and the new one are touched, plus the rows scrolling
+ * into view in virtual mode. */
+static Client *
+tabwinSelectIndex (Tabwin *tabwin, gint index)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+    gint n, row;
+
+    n = tabwin->clients->len;
+    if (!tabwin->visible || n == 0)
+    {
+        return NULL;
+    }
+    index = ((index % n) + n) % n;
+    tabwin->selected_index = index;
+
+    if (tabwin->virtual)
+    {
+        /* scroll just enough to bring the selection in view */
+        row = index / tabwin->grid_cols;
+        if (row < tabwin->first_row)
         {
-            gtk_grid_attach (GTK_GRID (windowlist), GTK_WIDGET (window_button),
-                             packpos % tabwin->grid_cols, packpos / tabwin->grid_cols,
-                             1, 1);
+            tabwin->first_row = row;
         }
-        else
+        else if (row >= tabwin->first_row + tabwin->visible_rows)
         {
-            gtk_grid_attach (GTK_GRID (windowlist), GTK_WIDGET (window_button),
-                             packpos / tabwin->grid_rows, packpos % tabwin->grid_rows,
-                             1, 1);
+            tabwin->first_row = row - tabwin->visible_rows + 1;
         }
+    }
 
-        tabwin_widget->widgets = g_list_append (tabwin_widget->widgets, window_button);
-        packpos++;
-        if (c == tabwin->selected->data)
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        if (tabwin->virtual)
         {
-            selected = window_button;
-            selected_label = buttonlabel;
-            gtk_widget_grab_focus (selected);
+            scrollVirtualGrid (tabwin_widget);
         }
+        tabwinSetSelected (tabwin_widget, getCell (tabwin_widget, index));
     }
-    if (selected)
+
+    return g_ptr_array_index (tabwin->clients, index);
+}
+
+static void
+tabwinSetVirtual (Tabwin *tabwin, gboolean virtual)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+    GHashTableIter iter;
+    TabwinCell *cell;
+
+    if (tabwin->virtual == virtual)
+    {
+        return;
+    }
+    tabwin->virtual = virtual;
+    /* forces computeTabwinData on the next tabwinShow */
+    tabwin->client_count = 0;
+
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        tabwin_widget->selected = NULL;
+        tabwin_widget->hovered = NULL;
+        if (virtual)
+        {
+            /* the pool takes over, per-client cells come back with
+             * tabwinShow once the count drops again */
+            g_hash_table_iter_init (&iter, tabwin_widget->cells);
+            while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &cell))
+            {
+                gtk_container_remove (GTK_CONTAINER (tabwin_widget->container),
+                                      cell->window_button);
+            }
+            g_hash_table_remove_all (tabwin_widget->cells);
+            g_ptr_array_set_size (tabwin_widget->slots, 0);
+
+            gtk_widget_hide (tabwin_widget->container);
+            gtk_widget_show (tabwin_widget->viewport);
+        }
+        else
+        {
+            destroyVirtualPool (tabwin_widget);
+            gtk_widget_hide (tabwin_widget->viewport);
+            gtk_widget_show (tabwin_widget->container);
+        }
+    }
+}
+
+/* Move a cell to position pos of the grid, touching the grid only if the
+ * cell is not already there. */
+static void
+placeWindowCell (TabwinWidget *tabwin_widget, TabwinCell *cell, gint pos)
+{
+    Tabwin *tabwin;
+    gint left, top;
+
+    tabwin = tabwin_widget->tabwin;
+    if (tabwin->screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
     {
-        tabwinSetSelected (tabwin_widget, selected, selected_label);
+        left = pos % tabwin->grid_cols;
+        top = pos / tabwin->grid_cols;
     }
+    else
+    {
+        left = pos / tabwin->grid_rows;
+        top = pos % tabwin->grid_rows;
+    }
+
+    if (left != cell->left || top != cell->top)
+    {
+        gtk_container_child_set (GTK_CONTAINER (tabwin_widget->container),
+                                 cell->window_button,
+                                 "left-attach", left,
+                                 "top-attach", top,
+                                 NULL);
+        cell->left = left;
+        cell->top = top;
+    }
+}
+
+static GtkWidget *
+createWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
+{
+    GtkWidget *windowlist;
+
+    //TRACE ("entering");
+    g_return_val_if_fail (tabwin_widget != NULL, NULL);
+
+    windowlist = gtk_grid_new ();
+    gtk_grid_set_row_homogeneous (GTK_GRID (windowlist), TRUE);
+    gtk_grid_set_row_spacing (GTK_GRID (windowlist), 4);
+    gtk_grid_set_column_homogeneous (GTK_GRID (windowlist), TRUE);
+    gtk_grid_set_column_spacing (GTK_GRID (windowlist), 4);
+
     return windowlist;
 }
 
@@ -591,8 +850,8 @@ tabwinConfigure (TabwinWidget *tabwin_widget, GdkEventConfigure *event)
         return FALSE;
     }
 
-    xfwm_get_monitor_geometry (gtk_widget_get_screen (GTK_WIDGET (tabwin_widget)),
-                               tabwin_widget->monitor_num, &monitor, FALSE);
+    myScreenGetXineramaMonitorGeometry (tabwin_widget->tabwin->screen_info,
+                                        tabwin_widget->monitor_num, &monitor);
     x = monitor.x + (monitor.width - event->width) / 2;
     y = monitor.y + (monitor.height - event->height) / 2;
     gtk_window_move (GTK_WINDOW (tabwin_widget), x, y);
@@ -635,17 +894,18 @@ static void
 computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
 {
     Tabwin *tabwin;
-    GdkPixbuf *icon_pixbuf;
     PangoLayout *layout;
-    GList *client_list;
+    gint client_count;
     gint size_request;
     gint standard_icon_size;
+    gint grid_cols, visible_rows;
     gboolean preview;
 
     //TRACE ("entering");
     g_return_if_fail (GTK_IS_WIDGET(tabwin_widget));
     tabwin = tabwin_widget->tabwin;
-    g_return_if_fail (tabwin->client_count > 0);
+    /* laid out for one window until the first tabwinShow */
+    client_count = MAX (tabwin->client_count, 1);
 
     tabwin->monitor_width = getMinMonitorWidth (screen_info);
     tabwin->monitor_height = getMinMonitorHeight (screen_info);
@@ -666,6 +926,26 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
                               "icon-size", &tabwin->icon_size, NULL);
         standard_icon_size = tabwin->icon_size;
 
+        /* how many windows fit at the standard size, past that the grid
+         * scrolls instead of shrinking the icons any further */
+        size_request = standard_icon_size + tabwin->label_height + 2 * WIN_ICON_BORDER;
+        grid_cols = MAX ((gint) floor ((double) tabwin->monitor_width * WIN_MAX_RATIO /
+                                       (double) size_request), 1);
+        visible_rows = MAX ((gint) floor (((double) tabwin->monitor_height * WIN_MAX_RATIO -
+                                           tabwin->label_height) / (double) size_request), 1);
+        tabwin->max_cells = grid_cols * visible_rows;
+
+        if (tabwin->virtual)
+        {
+            tabwin->icon_size = standard_icon_size;
+            tabwin->grid_cols = grid_cols;
+            tabwin->grid_rows = (client_count - 1) / grid_cols + 1;
+            tabwin->visible_rows = MIN (visible_rows, tabwin->grid_rows);
+            /* the button plus the grid spacing */
+            tabwin->cell_size = size_request + 4;
+            return;
+        }
+
         if (preview)
         {
             tabwin->icon_size = WIN_PREVIEW_SIZE;
@@ -679,7 +959,7 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
         size_request = tabwin->icon_size + tabwin->label_height + 2 * WIN_ICON_BORDER;
         tabwin->grid_cols = (int) (floor ((double) tabwin->monitor_width * WIN_MAX_RATIO /
                                           (double) size_request));
-        tabwin->grid_rows = (int) (ceil ((double) tabwin->client_count /
+        tabwin->grid_rows = (int) (ceil ((double) client_count /
                                          (double) tabwin->grid_cols));
 
         /* If we run out of space, halve the icon size to make more room. */
@@ -699,7 +979,7 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
             /* Recalculate with new icon size */
             tabwin->grid_cols = (int) (floor ((double) tabwin->monitor_width * WIN_MAX_RATIO /
                                               (double) size_request));
-            tabwin->grid_rows = (int) (ceil ((double) tabwin->client_count /
+            tabwin->grid_rows = (int) (ceil ((double) client_count /
                                              (double) tabwin->grid_cols));
 
             /* Shrinking the icon too much makes it hard to see */
@@ -712,43 +992,16 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
     }
     else
     {
+        /* the list overflows into more columns, it never scrolls */
+        tabwin->max_cells = G_MAXINT;
         tabwin->icon_size = LISTVIEW_WIN_ICON_SIZE;
         gtk_widget_style_get (GTK_WIDGET (tabwin_widget),
                               "listview-icon-size", &tabwin->icon_size, NULL);
         tabwin->grid_rows = (int) (floor ((double) tabwin->monitor_height * WIN_MAX_RATIO /
                                           (double) (tabwin->icon_size + 2 * WIN_ICON_BORDER)));
-        tabwin->grid_cols = (int) (ceil ((double) tabwin->client_count /
+        tabwin->grid_cols = (int) (ceil ((double) client_count /
                                          (double) tabwin->grid_rows));
     }
-
-    /* pack the client icons */
-    for (client_list = *tabwin->client_list; client_list; client_list = g_list_next (client_list))
-    {
-        Client *c = (Client *) client_list->data;
-
-        if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
-        {
-            if (preview)
-            {
-                //icon_pixbuf = getClientIcon (c, tabwin->icon_size * tabwin->icon_scale,
-                                             //tabwin->icon_size * tabwin->icon_scale);
-            }
-            else
-            {
-                //icon_pixbuf = getAppIcon (c->screen_info, c->window,
-                                          //tabwin->icon_size * tabwin->icon_scale,
-                                          //tabwin->icon_size * tabwin->icon_scale);
-            }
-        }
-        else
-        {
-            /* No preview in list mode */
-            //icon_pixbuf = getAppIcon (c->screen_info, c->window,
-                                      //tabwin->icon_size * tabwin->icon_scale,
-                                      //tabwin->icon_size * tabwin->icon_scale);
-        }
-        tabwin->icon_list = g_list_append(tabwin->icon_list, icon_pixbuf);
-    }
 }
 
 static TabwinWidget *
@@ -792,7 +1045,7 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
     gtk_widget_set_app_paintable (GTK_WIDGET (tabwin_widget), TRUE);
     gtk_widget_realize (GTK_WIDGET (tabwin_widget));
 
-    if (tabwin->icon_list == NULL)
+    if (tabwin->tabwin_list == NULL)
     {
         computeTabwinData (screen_info, tabwin_widget);
     }
@@ -807,7 +1060,7 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
                                     MAX (border.left, MAX (border.top, (MAX (border.right, border.bottom)))) +
                                     MAX (padding.left, MAX (padding.top, (MAX (padding.right, padding.bottom)))));
     gtk_window_set_position (GTK_WINDOW (tabwin_widget), GTK_WIN_POS_NONE);
-    xfwm_get_monitor_geometry (screen_info->gscr, tabwin_widget->monitor_num, &monitor, FALSE);
+    myScreenGetXineramaMonitorGeometry (screen_info, tabwin_widget->monitor_num, &monitor);
     gtk_window_move (GTK_WINDOW (tabwin_widget), monitor.x + monitor.width / 2,
                                       monitor.y + monitor.height / 2);
 
@@ -831,6 +1084,9 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
 
     windowlist = createWindowlist (screen_info, tabwin_widget);
     tabwin_widget->container = windowlist;
+    tabwin_widget->cells = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                  NULL, g_free);
+    tabwin_widget->slots = g_ptr_array_new ();
     gtk_box_pack_start (GTK_BOX (vbox), windowlist, TRUE, TRUE, 0);
 
     g_signal_connect_swapped (tabwin_widget, "configure-event",
@@ -841,95 +1097,311 @@ tabwinCreateWidget (Tabwin *tabwin, ScreenInfo *screen_info, gint monitor_num)
                       G_CALLBACK (tabwin_draw),
                       (gpointer) tabwin_widget);
 
-    gtk_widget_show_all (GTK_WIDGET (tabwin_widget));
+    /* realized now, mapped by tabwinShow */
+    gtk_widget_show_all (vbox);
+
+    /* replaces the grid in virtual mode, see tabwinSetVirtual */
+    tabwin_widget->viewport = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (tabwin_widget->viewport),
+                                    GTK_POLICY_NEVER, GTK_POLICY_EXTERNAL);
+    tabwin_widget->layout = gtk_layout_new (NULL, NULL);
+    gtk_container_add (GTK_CONTAINER (tabwin_widget->viewport), tabwin_widget->layout);
+    gtk_widget_show (tabwin_widget->layout);
+    gtk_box_pack_start (GTK_BOX (vbox), tabwin_widget->viewport, TRUE, TRUE, 0);
 
     return tabwin_widget;
 }
 
-static Client *
-tabwinChange2Selected (Tabwin *tabwin, GList *selected)
+Tabwin *
+tabwinNew (ScreenInfo *screen_info, gboolean display_workspace)
+{
+    Tabwin *tabwin;
+    TabwinWidget *win;
+    int num_monitors, i;
+
+    g_return_val_if_fail (screen_info != NULL, NULL);
+
+    tabwin = g_new0 (Tabwin, 1);
+    tabwin->screen_info = screen_info;
+    tabwin->display_workspace = display_workspace;
+    tabwin->client_list = NULL;
+    tabwin->client_count = 0;
+    tabwin->tabwin_list = NULL;
+    tabwin->clients = g_ptr_array_new ();
+    tabwin->client_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    num_monitors = myScreenGetNumMonitors (screen_info);
+    for (i = 0; i < num_monitors; i++)
+    {
+        gint monitor_index;
+
+        monitor_index = myScreenGetMonitorIndex (screen_info, i);
+        win = tabwinCreateWidget (tabwin, screen_info, monitor_index);
+        tabwin->tabwin_list  = g_list_append (tabwin->tabwin_list, win);
+    }
+
+    return tabwin;
+}
+
+/* An output moved or changed size: the grid is laid out again on the next
+ * tabwinShow and the widgets are centered on their monitor right away */
+void
+tabwinMonitorsChanged (Tabwin *tabwin)
 {
-    GList *tabwin_list, *widgets, *children;
-    GtkWidget *window_button, *buttonbox, *buttonlabel;
+    GList *tabwin_list;
     TabwinWidget *tabwin_widget;
-    Client *c;
+    GdkRectangle monitor;
+
+    g_return_if_fail (tabwin != NULL);
 
-    tabwin->selected = selected;
+    tabwin->client_count = 0;
     for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
     {
         tabwin_widget = (TabwinWidget *) tabwin_list->data;
-        for (widgets = tabwin_widget->widgets; widgets; widgets = g_list_next (widgets))
+        if (tabwin_widget->width < 0 || tabwin_widget->height < 0)
         {
-            window_button = GTK_WIDGET (widgets->data);
+            continue;
+        }
+        myScreenGetXineramaMonitorGeometry (tabwin->screen_info, tabwin_widget->monitor_num, &monitor);
+        gtk_window_move (GTK_WINDOW (tabwin_widget),
+                         monitor.x + (monitor.width - tabwin_widget->width) / 2,
+                         monitor.y + (monitor.height - tabwin_widget->height) / 2);
+    }
+}
 
-            children = gtk_container_get_children (GTK_CONTAINER (window_button));
-            buttonbox = GTK_WIDGET (g_list_nth_data (children, 0));
-            g_list_free (children);
+void
+tabwinAddClient (Tabwin *tabwin, Client *c)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
 
-            children = gtk_container_get_children (GTK_CONTAINER (buttonbox));
-            buttonlabel = GTK_WIDGET (g_list_nth_data (children, 1));
-            g_list_free (children);
+    g_return_if_fail (tabwin != NULL);
+    g_return_if_fail (c != NULL);
 
-            c = g_object_get_data (G_OBJECT (window_button), "client-ptr-val");
+    tabwin->n_clients++;
+    if (!tabwin->visible && tabwin->n_clients > (guint) tabwin->max_cells)
+    {
+        tabwinSetVirtual (tabwin, TRUE);
+    }
+    if (tabwin->virtual)
+    {
+        /* bound to a pool cell when scrolled into view */
+        return;
+    }
 
-            if (c != NULL)
-            {
-                /* don't clear label if mouse is inside the previously
-                 * selected button */
-                if (c->screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID
-                    && window_button != tabwin_widget->hovered)
-                {
-                    gtk_label_set_text (GTK_LABEL (buttonlabel), "");
-                }
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        if (!g_hash_table_contains (tabwin_widget->cells, c))
+        {
+            addWindowCell (tabwin_widget, c);
+        }
+    }
+}
 
-                if (c == tabwin->selected->data)
+void
+tabwinUpdateClient (Tabwin *tabwin, Client *c)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+    TabwinCell *cell;
+    gint i;
+
+    g_return_if_fail (tabwin != NULL);
+    g_return_if_fail (c != NULL);
+
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        if (tabwin->virtual)
+        {
+            /* only the clients in view have a cell */
+            for (i = 0; i < tabwin_widget->pool_size; i++)
+            {
+                cell = tabwin_widget->pool[i];
+                if (cell->c == c)
                 {
-                    gtk_widget_grab_focus (window_button);
-                    tabwinSetSelected (tabwin_widget, window_button, buttonlabel);
-                    gtk_widget_queue_draw (GTK_WIDGET (tabwin_widget));
+                    gtk_image_set_from_surface (GTK_IMAGE (cell->icon), getClientIcon (tabwin, c));
                 }
             }
+            continue;
+        }
+
+        cell = g_hash_table_lookup (tabwin_widget->cells, c);
+        if (!cell)
+        {
+            continue;
+        }
+
+        gtk_image_set_from_surface (GTK_IMAGE (cell->icon), getClientIcon (tabwin, c));
+        /* cells only carry the title in this mode */
+        if (tabwin->screen_info->params->cycle_tabwin_mode == OVERFLOW_COLUMN_GRID)
+        {
+            gtk_label_set_text (GTK_LABEL (cell->label), c->name ? c->name : "");
         }
     }
-    return tabwinGetSelected (tabwin);
 }
 
-Tabwin *
-tabwinCreate (GList **client_list, GList *selected, gboolean display_workspace)
+static void
+tabwinShowVirtual (Tabwin *tabwin)
 {
-    ScreenInfo *screen_info;
-    Client *c;
-    Tabwin *tabwin;
-    TabwinWidget *win;
-    int num_monitors, i;
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
 
-    g_return_val_if_fail (selected, NULL);
-    g_return_val_if_fail (client_list, NULL);
-    g_return_val_if_fail (*client_list, NULL);
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
 
-    c = (Client *) selected->data;
-    //TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+        createVirtualPool (tabwin_widget);
+        resetVirtualPool (tabwin_widget);
+        gtk_layout_set_size (GTK_LAYOUT (tabwin_widget->layout),
+                             tabwin->grid_cols * tabwin->cell_size,
+                             tabwin->grid_rows * tabwin->cell_size);
+        gtk_widget_set_size_request (tabwin_widget->viewport,
+                                     tabwin->grid_cols * tabwin->cell_size,
+                                     tabwin->visible_rows * tabwin->cell_size);
+
+        gtk_window_resize (GTK_WINDOW (tabwin_widget), 1, 1);
+        gtk_widget_show (GTK_WIDGET (tabwin_widget));
+    }
+
+    tabwin->visible = TRUE;
+    tabwin->first_row = 0;
+    tabwinSelectIndex (tabwin, tabwin->selected_index);
+}
+
+void
+tabwinShow (Tabwin *tabwin, GList **client_list, GList *selected)
+{
+    GList *tabwin_list, *list;
+    GHashTableIter iter;
+    TabwinWidget *tabwin_widget;
+    TabwinCell *cell;
+    Client *c;
+    gint icon_size, grid_cols, grid_rows;
+    gint client_count, pos;
+    gboolean relayout;
+
+    g_return_if_fail (tabwin != NULL);
+    g_return_if_fail (client_list != NULL);
+    g_return_if_fail (*client_list != NULL);
+    g_return_if_fail (selected != NULL);
 
-    tabwin = g_new0 (Tabwin, 1);
-    screen_info = c->screen_info;
-    tabwin->display_workspace = display_workspace;
     tabwin->client_list = client_list;
-    tabwin->client_count = g_list_length (*client_list);
-    tabwin->selected = selected;
-    tabwin->tabwin_list = NULL;
-    tabwin->icon_list = NULL;
+    tabwin->generation++;
+
+    /* Index the listed clients, navigation only works on indices from
+     * here on */
+    g_ptr_array_set_size (tabwin->clients, 0);
+    g_hash_table_remove_all (tabwin->client_index);
+    tabwin->selected_index = 0;
+    for (list = *client_list; list; list = g_list_next (list))
+    {
+        if (list == selected)
+        {
+            tabwin->selected_index = tabwin->clients->len;
+        }
+        g_hash_table_insert (tabwin->client_index, list->data,
+                             GINT_TO_POINTER (tabwin->clients->len + 1));
+        g_ptr_array_add (tabwin->clients, list->data);
+    }
+    client_count = tabwin->clients->len;
 
-    num_monitors = myScreenGetNumMonitors (screen_info);
-    for (i = 0; i < num_monitors; i++)
+    /* Leave the virtual grid only well below the limit, so that a window
+     * coming and going around it does not rebuild all cells each time */
+    if (client_count > tabwin->max_cells)
     {
-        gint monitor_index;
+        tabwinSetVirtual (tabwin, TRUE);
+    }
+    else if (client_count <= tabwin->max_cells - tabwin->max_cells / 4)
+    {
+        tabwinSetVirtual (tabwin, FALSE);
+    }
 
-        monitor_index = myScreenGetMonitorIndex (screen_info, i);
-        win = tabwinCreateWidget (tabwin, screen_info, monitor_index);
-        tabwin->tabwin_list  = g_list_append (tabwin->tabwin_list, win);
+    /* The grid only needs new dimensions when the number of windows
+     * changed, which is rare between two Alt+Tab */
+    relayout = FALSE;
+    if (client_count != tabwin->client_count)
+    {
+        icon_size = tabwin->icon_size;
+        grid_cols = tabwin->grid_cols;
+        grid_rows = tabwin->grid_rows;
+
+        tabwin->client_count = client_count;
+        computeTabwinData (tabwin->screen_info, (TabwinWidget *) tabwin->tabwin_list->data);
+
+        relayout = (icon_size != tabwin->icon_size ||
+                    grid_cols != tabwin->grid_cols ||
+                    grid_rows != tabwin->grid_rows);
     }
 
-    return tabwin;
+    if (tabwin->virtual)
+    {
+        tabwinShowVirtual (tabwin);
+        return;
+    }
+
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+
+        g_ptr_array_set_size (tabwin_widget->slots, 0);
+        for (pos = 0; pos < client_count; pos++)
+        {
+            c = g_ptr_array_index (tabwin->clients, pos);
+            cell = g_hash_table_lookup (tabwin_widget->cells, c);
+            if (!cell)
+            {
+                /* dropped while the grid was virtual */
+                cell = addWindowCell (tabwin_widget, c);
+            }
+            placeWindowCell (tabwin_widget, cell, pos);
+            cell->generation = tabwin->generation;
+            g_ptr_array_add (tabwin_widget->slots, cell);
+        }
+
+        g_hash_table_iter_init (&iter, tabwin_widget->cells);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &cell))
+        {
+            if (relayout)
+            {
+                setWindowButtonSize (tabwin, cell->window_button);
+                gtk_image_set_from_surface (GTK_IMAGE (cell->icon), getClientIcon (tabwin, cell->c));
+            }
+            gtk_widget_set_visible (cell->window_button,
+                                    cell->generation == tabwin->generation);
+        }
+
+        /* shrink back if there are fewer windows than last time */
+        gtk_window_resize (GTK_WINDOW (tabwin_widget), 1, 1);
+        gtk_widget_show (GTK_WIDGET (tabwin_widget));
+    }
+
+    tabwin->visible = TRUE;
+    tabwinSelectIndex (tabwin, tabwin->selected_index);
+}
+
+void
+tabwinHide (Tabwin *tabwin)
+{
+    GList *tabwin_list;
+    TabwinWidget *tabwin_widget;
+
+    g_return_if_fail (tabwin != NULL);
+
+    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
+    {
+        tabwin_widget = (TabwinWidget *) tabwin_list->data;
+        tabwin_widget->hovered = NULL;
+        g_ptr_array_set_size (tabwin_widget->slots, 0);
+        gtk_widget_hide (GTK_WIDGET (tabwin_widget));
+    }
+
+    tabwin->visible = FALSE;
+    tabwin->client_list = NULL;
+    g_ptr_array_set_size (tabwin->clients, 0);
+    g_hash_table_remove_all (tabwin->client_index);
+    tabwin->selected_index = 0;
 }
 
 Client *
@@ -938,9 +1410,9 @@ tabwinGetSelected (Tabwin *tabwin)
     g_return_val_if_fail (tabwin != NULL, NULL);
     //TRACE ("entering");
 
-    if (tabwin->selected)
+    if (tabwin->visible && tabwin->selected_index < (gint) tabwin->clients->len)
     {
-        return (Client *) tabwin->selected->data;
+        return g_ptr_array_index (tabwin->clients, tabwin->selected_index);
     }
 
     return NULL;
@@ -949,164 +1421,165 @@ tabwinGetSelected (Tabwin *tabwin)
 Client *
 tabwinRemoveClient (Tabwin *tabwin, Client *c)
 {
-    GList *client_list, *tabwin_list, *widgets;
-    GtkWidget *icon;
+    GList *tabwin_list;
     TabwinWidget *tabwin_widget;
+    TabwinCell *cell;
+    gint index, n, i;
 
     g_return_val_if_fail (tabwin != NULL, NULL);
     g_return_val_if_fail (c != NULL, NULL);
     //TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    if (!*tabwin->client_list)
+    if (tabwin->n_clients > 0)
     {
-        return NULL;
+        tabwin->n_clients--;
     }
 
-    /* First, remove the client from our own client list */
-    for (client_list = *tabwin->client_list; client_list; client_list = g_list_next (client_list))
+    /* First, remove the client from the list being switched between */
+    if (tabwin->client_list && *tabwin->client_list)
     {
-        if (client_list->data == c)
+        *tabwin->client_list = g_list_remove (*tabwin->client_list, c);
+    }
+
+    index = GPOINTER_TO_INT (g_hash_table_lookup (tabwin->client_index, c)) - 1;
+    if (index >= 0)
+    {
+        g_hash_table_remove (tabwin->client_index, c);
+        g_ptr_array_remove_index (tabwin->clients, index);
+        n = tabwin->clients->len;
+        for (i = index; i < n; i++)
         {
-            if (client_list == tabwin->selected)
-            {
-                tabwinSelectNext (tabwin);
-            }
-            *tabwin->client_list = g_list_delete_link (*tabwin->client_list, client_list);
-            break;
+            g_hash_table_insert (tabwin->client_index,
+                                 g_ptr_array_index (tabwin->clients, i),
+                                 GINT_TO_POINTER (i + 1));
+        }
+
+        if (tabwin->virtual && n > 0)
+        {
+            /* everything past the removed client moved back by one */
+            tabwin->grid_rows = (n - 1) / tabwin->grid_cols + 1;
+            tabwin->first_row = MAX (0, MIN (tabwin->first_row,
+                                             tabwin->grid_rows - tabwin->visible_rows));
         }
     }
 
-    /* Second, remove the icon from all boxes */
+    /* Second, drop its cell from all boxes */
     for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
     {
         tabwin_widget = (TabwinWidget *) tabwin_list->data;
-        for (widgets = tabwin_widget->widgets; widgets; widgets = g_list_next (widgets))
+        if (index >= 0 && tabwin->virtual)
+        {
+            /* rebound by tabwinSelectIndex below */
+            resetVirtualPool (tabwin_widget);
+            gtk_layout_set_size (GTK_LAYOUT (tabwin_widget->layout),
+                                 tabwin->grid_cols * tabwin->cell_size,
+                                 tabwin->grid_rows * tabwin->cell_size);
+        }
+        else if (index >= 0 && index < (gint) tabwin_widget->slots->len)
         {
-            icon = GTK_WIDGET (widgets->data);
-            if (((Client *) g_object_get_data (G_OBJECT(icon), "client-ptr-val")) == c)
+            g_ptr_array_remove_index (tabwin_widget->slots, index);
+        }
+
+        /* pool cells may still be bound to it from an earlier show */
+        for (i = 0; i < tabwin_widget->pool_size; i++)
+        {
+            if (tabwin_widget->pool[i]->c == c)
             {
-                gtk_container_remove (GTK_CONTAINER (tabwin_widget->container), icon);
-                tabwin_widget->widgets = g_list_delete_link (tabwin_widget->widgets, widgets);
+                tabwin_widget->pool[i]->c = NULL;
+                gtk_widget_hide (tabwin_widget->pool[i]->window_button);
             }
         }
+
+        cell = g_hash_table_lookup (tabwin_widget->cells, c);
+        if (!cell)
+        {
+            continue;
+        }
+
+        if (tabwin_widget->hovered == cell)
+        {
+            tabwin_widget->hovered = NULL;
+        }
+        if (tabwin_widget->selected == cell)
+        {
+            tabwin_widget->selected = NULL;
+        }
+        gtk_container_remove (GTK_CONTAINER (tabwin_widget->container), cell->window_button);
+        g_hash_table_remove (tabwin_widget->cells, c);
     }
 
-    return tabwinGetSelected (tabwin);
+    if (index < 0)
+    {
+        return tabwinGetSelected (tabwin);
+    }
+
+    /* the next one takes the selection, like tabwinSelectNext */
+    if (tabwin->selected_index > index)
+    {
+        tabwin->selected_index--;
+    }
+    return tabwinSelectIndex (tabwin, tabwin->selected_index);
 }
 
 Client *
 tabwinSelectHead (Tabwin *tabwin)
 {
-    GList *head, *tabwin_list, *widgets, *children;
-    GtkWidget *window_button, *buttonbox, *buttonlabel;
-    TabwinWidget *tabwin_widget;
-
     g_return_val_if_fail (tabwin != NULL, NULL);
     //TRACE ("entering");
 
-    head = *tabwin->client_list;
-    if (!head)
-    {
-        return NULL;
-    }
-    tabwin->selected = head;
-    for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
-    {
-        tabwin_widget = (TabwinWidget *) tabwin_list->data;
-        for (widgets = tabwin_widget->widgets; widgets; widgets = g_list_next (widgets))
-        {
-            window_button = GTK_WIDGET (widgets->data);
-
-            children = gtk_container_get_children (GTK_CONTAINER (window_button));
-            buttonbox = GTK_WIDGET (g_list_nth_data (children, 0));
-            g_list_free (children);
-
-            children = gtk_container_get_children (GTK_CONTAINER (buttonbox));
-            buttonlabel = GTK_WIDGET (g_list_nth_data (children, 1));
-            g_list_free (children);
-
-            if (((Client *) g_object_get_data (G_OBJECT (window_button), "client-ptr-val")) == head->data)
-            {
-                tabwinSetSelected (tabwin_widget, window_button, buttonlabel);
-                gtk_widget_queue_draw (GTK_WIDGET (tabwin_widget));
-            }
-        }
-    }
-
-    return tabwinGetSelected (tabwin);
+    return tabwinSelectIndex (tabwin, 0);
 }
 
 Client *
 tabwinSelectNext (Tabwin *tabwin)
 {
-    GList *next;
-
     g_return_val_if_fail (tabwin != NULL, NULL);
     //TRACE ("entering");
 
-    next = g_list_next (tabwin->selected);
-    if (!next)
-    {
-        next = *tabwin->client_list;
-        g_return_val_if_fail (next != NULL, NULL);
-    }
-    return tabwinChange2Selected (tabwin, next);
+    return tabwinSelectIndex (tabwin, tabwin->selected_index + 1);
 }
 
 Client *
 tabwinSelectPrev (Tabwin *tabwin)
 {
-    GList *prev;
-
     g_return_val_if_fail (tabwin != NULL, NULL);
     //TRACE ("entering");
 
-    prev = g_list_previous (tabwin->selected);
-    if (!prev)
+    return tabwinSelectIndex (tabwin, tabwin->selected_index - 1);
+}
+
+Client *
+tabwinSelectClient (Tabwin *tabwin, Client *c)
+{
+    gint index;
+
+    g_return_val_if_fail (tabwin != NULL, NULL);
+
+    index = GPOINTER_TO_INT (g_hash_table_lookup (tabwin->client_index, c)) - 1;
+    if (index < 0)
     {
-        prev = g_list_last (*tabwin->client_list);
-        g_return_val_if_fail (prev != NULL, NULL);
+        return tabwinGetSelected (tabwin);
     }
-    return tabwinChange2Selected (tabwin, prev);
+    return tabwinSelectIndex (tabwin, index);
 }
 
 Client *
 tabwinSelectDelta (Tabwin *tabwin, int row_delta, int col_delta)
 {
-    GList *selected;
     int pos_current, col_current, row_current, nitems, cols, rows;
-    Client *c;
     ScreenInfo *screen_info;
 
     //TRACE ("entering");
     g_return_val_if_fail (tabwin != NULL, NULL);
 
-    pos_current = g_list_position (*tabwin->client_list, tabwin->selected);
-    nitems = g_list_length (*tabwin->client_list);
-
-    if (tabwin->selected)
-    {
-        c = (Client *) tabwin->selected->data;
-        screen_info = c->screen_info;
-        if (!screen_info)
-        {
-            return NULL;
-        }
-    }
-    else if (tabwin->client_list)
-    {
-        c = (Client *) tabwin->client_list;
-        screen_info = c->screen_info;
-        if (!screen_info)
-        {
-            return NULL;
-        }
-    }
-    else
+    nitems = tabwin->clients->len;
+    if (!tabwin->visible || nitems == 0)
     {
         /* There's no items? */
         return NULL;
     }
+    pos_current = tabwin->selected_index;
+    screen_info = tabwin->screen_info;
 
     if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
     {
@@ -1261,17 +1734,15 @@ tabwinSelectDelta (Tabwin *tabwin, int row_delta, int col_delta)
         }
     }
 
-    selected = g_list_nth (*tabwin->client_list, pos_current);
-
-    return tabwinChange2Selected (tabwin, selected);
+    return tabwinSelectIndex (tabwin, pos_current);
 }
 
 Client*
 tabwinSelectHovered (Tabwin *tabwin)
 {
-    GList *tabwin_list, *selected;
+    GList *tabwin_list;
     TabwinWidget *tabwin_widget;
-    Client *c;
+    gint index;
 
     g_return_val_if_fail (tabwin != NULL, NULL);
     //TRACE ("entering");
@@ -1279,20 +1750,19 @@ tabwinSelectHovered (Tabwin *tabwin)
     for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
     {
         tabwin_widget = (TabwinWidget *) tabwin_list->data;
-        if (tabwin_widget->hovered)
+        if (tabwin_widget->hovered && tabwin_widget->hovered->c)
         {
-            gtk_widget_grab_focus (tabwin_widget->hovered);
-            c = g_object_get_data (G_OBJECT (tabwin_widget->hovered), "client-ptr-val");
-            selected = g_list_find (*tabwin->client_list, c);
-            if (selected)
+            index = GPOINTER_TO_INT (g_hash_table_lookup (tabwin->client_index,
+                                                          tabwin_widget->hovered->c)) - 1;
+            if (index >= 0)
             {
-                tabwin->selected = selected;
+                return tabwinSelectIndex (tabwin, index);
             }
-            return c;
+            return tabwin_widget->hovered->c;
         }
     }
 
-    return tabwinSelectWidget (tabwin);
+    return tabwinGetSelected (tabwin);
 }
 
 void
@@ -1307,9 +1777,16 @@ tabwinDestroy (Tabwin *tabwin)
     for (tabwin_list = tabwin->tabwin_list; tabwin_list; tabwin_list = g_list_next (tabwin_list))
     {
         tabwin_widget = (TabwinWidget *) tabwin_list->data;
-        g_list_free (tabwin_widget->widgets);
+        g_hash_table_destroy (tabwin_widget->cells);
+        g_ptr_array_free (tabwin_widget->slots, TRUE);
+        destroyVirtualPool (tabwin_widget);
         gtk_widget_destroy (GTK_WIDGET (tabwin_widget));
     }
-    g_list_free_full (tabwin->icon_list, g_object_unref);
     g_list_free (tabwin->tabwin_list);
+    g_ptr_array_free (tabwin->clients, TRUE);
+    g_hash_table_destroy (tabwin->client_index);
+    if (tabwin->default_icon)
+    {
+        cairo_surface_destroy (tabwin->default_icon);
+    }
 }
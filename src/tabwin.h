@@ -34,6 +34,7 @@
 typedef struct _Tabwin Tabwin;
 typedef struct _TabwinWidget TabwinWidget;
 typedef struct _TabwinWidgetClass TabwinWidgetClass;
+typedef struct _TabwinCell TabwinCell;
 
 typedef enum
 {
@@ -44,10 +45,15 @@ CYCLE_TABWIN_MODE;
 
 struct _Tabwin
 {
+    ScreenInfo *screen_info;
     GList *tabwin_list;
+    /* clients being switched between, NULL while hidden */
     GList **client_list;
-    GList *icon_list;
-    GList *selected;
+    gboolean visible;
+    /* bumped on every tabwinShow, see TabwinCell */
+    guint generation;
+    cairo_surface_t *default_icon;
+    gint default_icon_size;
     gint monitor_width;
     gint monitor_height;
     gint client_count;
@@ -57,20 +63,58 @@ struct _Tabwin
     gint icon_scale;
     gint label_height;
     gboolean display_workspace;
+
+    /* The selection model: the listed clients in order and the index of
+     * the selected one, each TabwinWidget maps an index to its cell. */
+    GPtrArray *clients;
+    GHashTable *client_index; /* Client * -> index in clients + 1 */
+    gint selected_index;
+
+    /* Past max_cells windows the icon grid turns into a scrolling
+     * viewport showing visible_rows rows of recycled cells, so the cost
+     * of a keypress does not depend on the number of windows. */
+    gboolean virtual;
+    guint n_clients;
+    gint max_cells;
+    gint visible_rows;
+    gint first_row;
+    gint cell_size;
+};
+
+/* The widgets showing one client. Cells live as long as their client,
+ * showing the switcher only moves them around. */
+struct _TabwinCell
+{
+    Client *c;
+    GtkWidget *window_button;
+    GtkWidget *icon;
+    GtkWidget *label;
+    gint left;
+    gint top;
+    /* Tabwin::generation of the last tabwinShow listing the client */
+    guint generation;
 };
 
 struct _TabwinWidget
 {
     GtkWindow __parent__;
     /* The below must be freed when destroying */
-    GList *widgets;
+    GHashTable *cells; /* Client * -> TabwinCell */
+    GPtrArray *slots; /* index in Tabwin::clients -> TabwinCell, unused when virtual */
 
     /* these don't have to be */
     Tabwin *tabwin;
     GtkWidget *label;
     GtkWidget *container;
-    GtkWidget *selected;
-    GtkWidget *hovered;
+    TabwinCell *selected;
+    TabwinCell *hovered;
+
+    /* virtual mode only, see Tabwin::virtual */
+    GtkWidget *viewport;
+    GtkWidget *layout;
+    TabwinCell **pool;
+    gint pool_size;
+    gint *pool_rows; /* data row bound to each pool row, -1 if none */
 
     gulong selected_callback;
     gint width;
@@ -83,13 +127,23 @@ struct _TabwinWidgetClass
     GtkWindowClass __parent__;
 };
 
-Tabwin                  *tabwinCreate                           (GList **,
-                                                                 GList *,
+Tabwin                  *tabwinNew                              (ScreenInfo *,
                                                                  gboolean);
+void                     tabwinMonitorsChanged                  (Tabwin *);
+void                     tabwinAddClient                        (Tabwin *,
+                                                                 Client *);
+void                     tabwinUpdateClient                     (Tabwin *,
+                                                                 Client *);
+void                     tabwinShow                             (Tabwin *,
+                                                                 GList **,
+                                                                 GList *);
+void                     tabwinHide                             (Tabwin *);
 Client                  *tabwinGetSelected                      (Tabwin *);
 Client                  *tabwinSelectHead                       (Tabwin *);
 Client                  *tabwinSelectNext                       (Tabwin *);
 Client                  *tabwinSelectPrev                       (Tabwin *);
+Client                  *tabwinSelectClient                     (Tabwin *,
+                                                                 Client *);
 Client                  *tabwinSelectDelta                      (Tabwin *, int, int);
 Client                  *tabwinSelectHovered                    (Tabwin *);
 Client                  *tabwinRemoveClient                     (Tabwin *,
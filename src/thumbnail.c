@@ -0,0 +1,218 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "thumbnail.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* The filter runs in two passes. The rows covered by one destination row
+ * are summed into acc, one 32 bit counter per channel, then the columns
+ * covered by each destination pixel are summed from acc. Both inner loops
+ * work on whole pixels, four channels at a time. */
+
+static void
+accumulate_row (uint32_t      *acc,
+                const uint8_t *row,
+                int            width)
+{
+  int i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; i + 4 <= width; i += 4)
+    {
+      __m128i px = _mm_loadu_si128 ((const __m128i *) (row + i * 4));
+      __m128i lo = _mm_unpacklo_epi8 (px, zero);
+      __m128i hi = _mm_unpackhi_epi8 (px, zero);
+      __m128i *a = (__m128i *) (acc + i * 4);
+
+      _mm_store_si128 (a + 0, _mm_add_epi32 (_mm_load_si128 (a + 0), _mm_unpacklo_epi16 (lo, zero)));
+      _mm_store_si128 (a + 1, _mm_add_epi32 (_mm_load_si128 (a + 1), _mm_unpackhi_epi16 (lo, zero)));
+      _mm_store_si128 (a + 2, _mm_add_epi32 (_mm_load_si128 (a + 2), _mm_unpacklo_epi16 (hi, zero)));
+      _mm_store_si128 (a + 3, _mm_add_epi32 (_mm_load_si128 (a + 3), _mm_unpackhi_epi16 (hi, zero)));
+    }
+#endif
+
+  for (i *= 4; i < width * 4; i++)
+    acc[i] += row[i];
+}
+
+static void
+sum_columns (const uint32_t *acc,
+             int             x0,
+             int             x1,
+             uint32_t        sum[4])
+{
+#ifdef __SSE2__
+  __m128i s = _mm_setzero_si128 ();
+  int x;
+
+  for (x = x0; x < x1; x++)
+    s = _mm_add_epi32 (s, _mm_load_si128 ((const __m128i *) (acc + x * 4)));
+  _mm_storeu_si128 ((__m128i *) sum, s);
+#else
+  int x;
+
+  sum[0] = sum[1] = sum[2] = sum[3] = 0;
+  for (x = x0; x < x1; x++)
+    {
+      sum[0] += acc[x * 4 + 0];
+      sum[1] += acc[x * 4 + 1];
+      sum[2] += acc[x * 4 + 2];
+      sum[3] += acc[x * 4 + 3];
+    }
+#endif
+}
+
+static bool
+scaler_reserve (struct xfway_thumbnail_scaler *scaler,
+                int                            src_width,
+                int                            dst_width)
+{
+  if (scaler->acc_width < src_width)
+    {
+      uint32_t *acc;
+
+      /* 16 byte aligned for the SSE2 loads and stores */
+      if (posix_memalign ((void **) &acc, 16, (size_t) src_width * 4 * sizeof (uint32_t)) != 0)
+        return false;
+      free (scaler->acc);
+      scaler->acc = acc;
+      scaler->acc_width = src_width;
+    }
+
+  if (scaler->columns_width < dst_width)
+    {
+      int *columns = realloc (scaler->columns, (dst_width + 1) * sizeof (int));
+
+      if (columns == NULL)
+        return false;
+      scaler->columns = columns;
+      scaler->columns_width = dst_width;
+    }
+
+  return true;
+}
+
+void
+xfway_thumbnail_scaler_release (struct xfway_thumbnail_scaler *scaler)
+{
+  free (scaler->acc);
+  free (scaler->columns);
+  memset (scaler, 0, sizeof (*scaler));
+}
+
+bool
+xfway_thumbnail_downscale (struct xfway_thumbnail_scaler *scaler,
+                           const void                    *src,
+                           int                            src_width,
+                           int                            src_height,
+                           int                            src_stride,
+                           void                          *dst,
+                           int                            dst_width,
+                           int                            dst_height,
+                           int                            dst_stride,
+                           bool                           swap_rb)
+{
+  int *columns;
+  int dx, dy, y;
+
+  if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0)
+    return true;
+
+  if (!scaler_reserve (scaler, src_width, dst_width))
+    return false;
+
+  /* columns[dx] .. columns[dx + 1] is the source span of destination
+   * column dx; when scaling up a span still covers one pixel */
+  columns = scaler->columns;
+  for (dx = 0; dx <= dst_width; dx++)
+    columns[dx] = (int) ((int64_t) dx * src_width / dst_width);
+
+  for (dy = 0; dy < dst_height; dy++)
+    {
+      int y0 = (int) ((int64_t) dy * src_height / dst_height);
+      int y1 = (int) ((int64_t) (dy + 1) * src_height / dst_height);
+      uint32_t *out = (uint32_t *) ((uint8_t *) dst + (size_t) dy * dst_stride);
+
+      if (y1 <= y0)
+        y1 = y0 + 1;
+
+      memset (scaler->acc, 0, (size_t) src_width * 4 * sizeof (uint32_t));
+      for (y = y0; y < y1; y++)
+        accumulate_row (scaler->acc, (const uint8_t *) src + (size_t) y * src_stride, src_width);
+
+      for (dx = 0; dx < dst_width; dx++)
+        {
+          int x0 = columns[dx];
+          int x1 = columns[dx + 1];
+          uint32_t sum[4];
+          uint64_t count, half;
+          uint8_t *p = (uint8_t *) &out[dx];
+
+          if (x1 <= x0)
+            x1 = x0 + 1;
+
+          sum_columns (scaler->acc, x0, x1, sum);
+
+          count = (uint64_t) (x1 - x0) * (y1 - y0);
+          half = count / 2;
+          p[0] = (sum[swap_rb ? 2 : 0] + half) / count;
+          p[1] = (sum[1] + half) / count;
+          p[2] = (sum[swap_rb ? 0 : 2] + half) / count;
+          p[3] = (sum[3] + half) / count;
+        }
+    }
+
+  return true;
+}
+
+void
+xfway_thumbnail_fit (int  width,
+                     int  height,
+                     int  max_width,
+                     int  max_height,
+                     int *out_width,
+                     int *out_height)
+{
+  if (width <= max_width && height <= max_height)
+    {
+      *out_width = width;
+      *out_height = height;
+      return;
+    }
+
+  if ((int64_t) width * max_height > (int64_t) height * max_width)
+    {
+      *out_width = max_width;
+      *out_height = (int) ((int64_t) height * max_width / width);
+    }
+  else
+    {
+      *out_height = max_height;
+      *out_width = (int) ((int64_t) width * max_height / height);
+    }
+
+  if (*out_width < 1)
+    *out_width = 1;
+  if (*out_height < 1)
+    *out_height = 1;
+}
@@ -0,0 +1,61 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __THUMBNAIL_H__
+#define __THUMBNAIL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scratch space for xfway_thumbnail_downscale, reused between calls so
+ * refreshing a thumbnail does not allocate. */
+struct xfway_thumbnail_scaler
+{
+  uint32_t *acc;
+  int acc_width;
+  int *columns;
+  int columns_width;
+};
+
+void xfway_thumbnail_scaler_release (struct xfway_thumbnail_scaler *scaler);
+
+/* Box-filter a 32 bit per pixel image down to dst_width x dst_height.
+ * Every destination pixel is the average of the source pixels it covers.
+ * Strides are in bytes. With swap_rb, the red and blue channels are
+ * exchanged, turning the RGBA byte order of weston_surface_copy_content
+ * into wl_shm ARGB8888. Returns false if scratch space could not be
+ * allocated. */
+bool xfway_thumbnail_downscale (struct xfway_thumbnail_scaler *scaler,
+                                const void                    *src,
+                                int                            src_width,
+                                int                            src_height,
+                                int                            src_stride,
+                                void                          *dst,
+                                int                            dst_width,
+                                int                            dst_height,
+                                int                            dst_stride,
+                                bool                           swap_rb);
+
+/* Largest size with the aspect ratio of width x height that fits in
+ * max_width x max_height, never scaling up. */
+void xfway_thumbnail_fit (int  width,
+                          int  height,
+                          int  max_width,
+                          int  max_height,
+                          int *out_width,
+                          int *out_height);
+
+#endif /* __THUMBNAIL_H__ */
@@ -0,0 +1,183 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#define _GNU_SOURCE
+
+#include "trace.h"
+
+#ifdef XFWAY_ENABLE_TRACING
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* 8192 spans of 32 bytes per thread, a few seconds of a busy compositor */
+#define TRACE_RING_SIZE 8192
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+/* seq is 0 while the event is being written and its index plus one once
+ * it is complete, so a dump racing the owner thread can tell torn events
+ * apart and skip them. */
+struct trace_event
+{
+  uint64_t seq;
+  const char *name;
+  uint64_t start;
+  uint64_t end;
+};
+
+struct trace_buffer
+{
+  struct trace_buffer *next;
+  pid_t tid;
+  char thread_name[16];
+  uint64_t n_events;
+  struct trace_event events[TRACE_RING_SIZE];
+};
+
+/* Every thread that ever recorded a span. Buffers are never freed, a
+ * dump may still walk the buffer of a thread that has exited. */
+static struct trace_buffer *trace_buffers;
+
+static __thread struct trace_buffer *trace_buffer;
+
+static struct trace_buffer *
+trace_buffer_create (void)
+{
+  struct trace_buffer *buffer = calloc (1, sizeof (struct trace_buffer));
+
+  if (buffer == NULL)
+    return NULL;
+
+  buffer->tid = syscall (SYS_gettid);
+  pthread_getname_np (pthread_self (), buffer->thread_name, sizeof (buffer->thread_name));
+
+  buffer->next = __atomic_load_n (&trace_buffers, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n (&trace_buffers, &buffer->next, buffer, true,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+
+  return buffer;
+}
+
+void
+xfway_trace_record (const char *name,
+                    uint64_t    start,
+                    uint64_t    end)
+{
+  struct trace_buffer *buffer = trace_buffer;
+  struct trace_event *event;
+  uint64_t index;
+
+  if (buffer == NULL)
+    {
+      buffer = trace_buffer = trace_buffer_create ();
+      if (buffer == NULL)
+        return;
+    }
+
+  index = buffer->n_events;
+  event = &buffer->events[index & TRACE_RING_MASK];
+
+  __atomic_store_n (&event->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  __atomic_store_n (&event->name, name, __ATOMIC_RELAXED);
+  __atomic_store_n (&event->start, start, __ATOMIC_RELAXED);
+  __atomic_store_n (&event->end, end, __ATOMIC_RELAXED);
+  __atomic_store_n (&event->seq, index + 1, __ATOMIC_RELEASE);
+
+  __atomic_store_n (&buffer->n_events, index + 1, __ATOMIC_RELEASE);
+}
+
+static void
+write_string (FILE       *f,
+              const char *s)
+{
+  fputc ('"', f);
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        fputc ('\\', f);
+      if ((unsigned char) *s >= 0x20)
+        fputc (*s, f);
+    }
+  fputc ('"', f);
+}
+
+static void
+dump_buffer (FILE                *f,
+             struct trace_buffer *buffer,
+             pid_t                pid,
+             bool                *first)
+{
+  struct trace_event *event;
+  struct trace_event copy;
+  uint64_t n_events, index, seq;
+
+  fprintf (f, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+           *first ? "" : ",", pid, buffer->tid);
+  write_string (f, buffer->thread_name);
+  fputs ("}}", f);
+  *first = false;
+
+  n_events = __atomic_load_n (&buffer->n_events, __ATOMIC_ACQUIRE);
+  index = n_events > TRACE_RING_SIZE ? n_events - TRACE_RING_SIZE : 0;
+
+  for (; index < n_events; index++)
+    {
+      event = &buffer->events[index & TRACE_RING_MASK];
+
+      seq = __atomic_load_n (&event->seq, __ATOMIC_ACQUIRE);
+      copy.name = __atomic_load_n (&event->name, __ATOMIC_RELAXED);
+      copy.start = __atomic_load_n (&event->start, __ATOMIC_RELAXED);
+      copy.end = __atomic_load_n (&event->end, __ATOMIC_RELAXED);
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+      /* overwritten or being written while we looked */
+      if (seq != index + 1 || __atomic_load_n (&event->seq, __ATOMIC_RELAXED) != seq)
+        continue;
+
+      fputs (",\n{\"ph\":\"X\",\"name\":", f);
+      write_string (f, copy.name);
+      fprintf (f, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+               pid, buffer->tid, copy.start / 1000.0, (copy.end - copy.start) / 1000.0);
+    }
+}
+
+bool
+xfway_trace_dump (const char *path)
+{
+  struct trace_buffer *buffer;
+  pid_t pid = getpid ();
+  bool first = true;
+  FILE *f;
+
+  f = fopen (path, "w");
+  if (f == NULL)
+    return false;
+
+  fputs ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+  for (buffer = __atomic_load_n (&trace_buffers, __ATOMIC_ACQUIRE);
+       buffer != NULL; buffer = buffer->next)
+    dump_buffer (f, buffer, pid, &first);
+  fputs ("\n]}\n", f);
+
+  return fclose (f) == 0;
+}
+
+#endif /* XFWAY_ENABLE_TRACING */
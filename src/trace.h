@@ -0,0 +1,85 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Spans of time spent in the compositor, for finding where a frame went.
+ *
+ * XFWAY_TRACE_SPAN (name) at the top of a block records the time from
+ * there to the end of the block, however it is left. Each thread keeps
+ * its most recent spans in a ring of its own, so recording takes no lock
+ * and costs two clock reads. xfway_trace_dump writes all the rings out
+ * as Chrome trace event JSON, which chrome://tracing and Perfetto open.
+ *
+ * Without XFWAY_ENABLE_TRACING (configure --enable-tracing) the macros
+ * expand to nothing. */
+
+#ifdef XFWAY_ENABLE_TRACING
+
+struct xfway_trace_span
+{
+  const char *name;
+  uint64_t start;
+};
+
+static inline uint64_t
+xfway_trace_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Stores a finished span in the ring of the calling thread. name must
+ * outlive the trace, a string literal or __func__. */
+void xfway_trace_record (const char *name,
+                         uint64_t    start,
+                         uint64_t    end);
+
+static inline void
+xfway_trace_span_end (struct xfway_trace_span *span)
+{
+  xfway_trace_record (span->name, span->start, xfway_trace_now ());
+}
+
+#define XFWAY_TRACE_CONCAT_(a, b) a##b
+#define XFWAY_TRACE_CONCAT(a, b) XFWAY_TRACE_CONCAT_ (a, b)
+
+#define XFWAY_TRACE_SPAN(span_name) \
+  struct xfway_trace_span XFWAY_TRACE_CONCAT (xfway_trace_span_, __LINE__) \
+    __attribute__ ((cleanup (xfway_trace_span_end))) = \
+    { (span_name), xfway_trace_now () }
+
+/* Writes every thread's spans to path. Returns false if it could not be
+ * written. */
+bool xfway_trace_dump (const char *path);
+
+#else
+
+#define XFWAY_TRACE_SPAN(span_name) do { } while (0)
+
+#endif /* XFWAY_ENABLE_TRACING */
+
+#define XFWAY_TRACE_FUNC() XFWAY_TRACE_SPAN (__func__)
+
+#endif /* __TRACE_H__ */
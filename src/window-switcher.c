@@ -14,11 +14,27 @@
  * along with this library; if not, see <http://www.gnu.org/licenses/>
  */
 
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <wayland-server.h>
 #include <libweston/libweston.h>
 #include <libweston-desktop/libweston-desktop.h>
 #include <protocol/window-switcher-unstable-v1-server-protocol.h>
 #include <gtk/gtk.h>
+#include "os-compatibility.h"
+#include "thumbnail.h"
+#include "worker-pool.h"
+#include "log.h"
+
+/* Largest thumbnail a client may ask for. Every pool slot has room for
+ * two, written in turn so the one last sent is left alone while the client
+ * may still read it. */
+#define THUMBNAIL_MAX_SIZE 256
+#define THUMBNAIL_BUFFER_SIZE (THUMBNAIL_MAX_SIZE * THUMBNAIL_MAX_SIZE * 4)
+#define THUMBNAIL_SLOT_SIZE (THUMBNAIL_BUFFER_SIZE * 2)
+/* The pool size and offsets into it go out as uint */
+#define THUMBNAIL_MAX_SLOTS (UINT32_MAX / THUMBNAIL_SLOT_SIZE)
 
 struct weston_window_switcher
 {
@@ -26,38 +42,106 @@ struct weston_window_switcher
   struct wl_client *client;
   struct wl_resource *binding;
   struct wl_list windows;
+
+  /* thumbnails live in fixed size slots of one shared memory pool */
+  int pool_fd;
+  void *pool_data;
+  unsigned int n_slots;
+  struct weston_window_switcher_window **slots;
+
+  struct xfway_thumbnail_scaler scaler;
+  void *copy_buffer;
+  size_t copy_size;
+
+  /* when set, thumbnails are scaled off the compositor thread */
+  struct xfway_worker_pool *workers;
+
+  uint32_t thumbnail_interval;
+  struct wl_event_source *thumbnail_timer;
+  bool thumbnail_timer_armed;
 };
 
+/* One entry per live desktop surface, whether or not a switcher client is
+ * bound. The shell keeps the entry it got from surface_added and hands it
+ * back on every commit and on removal, so nothing is looked up. */
 struct weston_window_switcher_window
 {
   struct wl_list link;
   struct weston_window_switcher *switcher;
   struct wl_resource *resource;
   struct weston_desktop_surface *surface;
-  struct weston_view *view;
-  struct wl_listener surface_destroy_listener;
-  struct wl_listener view_destroy_listener;
+
+  int thumbnail_slot;
+  int thumbnail_back; /* the buffer of the slot written next, 0 or 1 */
+  int thumbnail_width, thumbnail_height;
+  bool thumbnail_dirty;
+  struct thumbnail_job *thumbnail_job;
+};
+
+/* A thumbnail being scaled by a worker. The job owns both the copy of the
+ * surface and the scaled result; the result only goes into the pool slot
+ * once back on the compositor thread, since the pool may be remapped while
+ * the worker runs. window is cleared if the window goes away first. */
+struct thumbnail_job
+{
+  struct weston_window_switcher_window *window;
+  struct xfway_job *handle; /* until done has run */
+  void *src;
+  int width, height;
+  void *dst;
+  int dst_width, dst_height;
+  bool ok;
 };
 
 static void _weston_window_switcher_request_destroy (struct wl_client   *client,
                                                      struct wl_resource *resource)
 {
+  wl_resource_destroy (resource);
+}
+
+/* The client keeps the pool mapped, so it is never truncated below that
+ * mapping; the pages of a freed slot are handed back instead and read as
+ * zeroes until the slot is used again. */
+static void
+_weston_window_switcher_release_slot (struct weston_window_switcher_window *self)
+{
+  struct weston_window_switcher *switcher = self->switcher;
+
+  if (self->thumbnail_slot < 0)
+    return;
 
+  madvise ((uint8_t *) switcher->pool_data + (size_t) self->thumbnail_slot * THUMBNAIL_SLOT_SIZE,
+           THUMBNAIL_SLOT_SIZE, MADV_REMOVE);
+  switcher->slots[self->thumbnail_slot] = NULL;
+  self->thumbnail_slot = -1;
+  self->thumbnail_dirty = false;
 }
 
 static void
-_weston_window_switcher_window_surface_destroyed (struct wl_listener *listener,
-                                                  void               *data)
+_weston_window_switcher_window_free (struct weston_window_switcher_window *self)
 {
-  struct weston_window_switcher_window *self = wl_container_of (listener, self, surface_destroy_listener);
+  _weston_window_switcher_release_slot (self);
+
+  if (self->thumbnail_job != NULL)
+    {
+      xfway_job_cancel (self->thumbnail_job->handle);
+      self->thumbnail_job->window = NULL;
+    }
 
-  self->surface = NULL;
+  if (self->resource != NULL)
+    wl_resource_set_user_data (self->resource, NULL);
+
+  wl_list_remove (&self->link);
+  free (self);
 }
 
 static void
 _weston_window_switcher_window_destroy (struct wl_resource *resource)
 {
+  struct weston_window_switcher_window *self = wl_resource_get_user_data (resource);
 
+  if (self != NULL)
+    self->resource = NULL;
 }
 
 static void
@@ -67,15 +151,17 @@ _weston_window_switcher_window_request_switch_to (struct wl_client   *client,
                                                   uint32_t            serial)
 {
   struct weston_window_switcher_window *self = wl_resource_get_user_data (resource);
-  struct weston_surface *surface = weston_desktop_surface_get_surface (self->surface);
+  struct weston_surface *surface;
   struct weston_seat *seat = wl_resource_get_user_data (seat_resource);
   struct weston_keyboard *keyboard = weston_seat_get_keyboard (seat);
   struct weston_pointer *pointer = weston_seat_get_pointer (seat);
   struct weston_touch *touch = weston_seat_get_touch (seat);
 
-  if (keyboard == NULL)
+  if (self == NULL || keyboard == NULL)
     return;
 
+  surface = weston_desktop_surface_get_surface (self->surface);
+
   if ((keyboard != NULL) && (keyboard->grab_serial == serial))
     weston_keyboard_set_focus (keyboard, surface);
   else if ((pointer != NULL) && (pointer->grab_serial == serial))
@@ -97,7 +183,7 @@ _weston_window_switcher_window_request_close (struct wl_client   *client,
   struct weston_pointer *pointer = weston_seat_get_pointer (seat);
   struct weston_touch *touch = weston_seat_get_touch (seat);
 
-  if (keyboard == NULL)
+  if (self == NULL || keyboard == NULL)
     return;
 
   if ((keyboard != NULL) && (keyboard->grab_serial == serial))
@@ -108,55 +194,323 @@ _weston_window_switcher_window_request_close (struct wl_client   *client,
     weston_desktop_surface_close (self->surface);
 }
 
+static bool
+_weston_window_switcher_grow_pool (struct weston_window_switcher *switcher)
+{
+  unsigned int n_slots = switcher->n_slots ? MIN (switcher->n_slots * 2, THUMBNAIL_MAX_SLOTS) : 8;
+  size_t size = (size_t) n_slots * THUMBNAIL_SLOT_SIZE;
+  struct weston_window_switcher_window **slots;
+  void *data;
+
+  if (n_slots == switcher->n_slots)
+    return false;
+
+  slots = realloc (switcher->slots, n_slots * sizeof (*slots));
+  if (slots == NULL)
+    return false;
+  memset (slots + switcher->n_slots, 0,
+          (n_slots - switcher->n_slots) * sizeof (*slots));
+  switcher->slots = slots;
+
+  if (switcher->pool_fd < 0)
+    switcher->pool_fd = os_create_anonymous_file (size);
+  else if (ftruncate (switcher->pool_fd, size) < 0)
+    return false;
+  if (switcher->pool_fd < 0)
+    return false;
+
+  data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, switcher->pool_fd, 0);
+  if (data == MAP_FAILED)
+    return false;
+
+  if (switcher->pool_data != NULL)
+    munmap (switcher->pool_data, (size_t) switcher->n_slots * THUMBNAIL_SLOT_SIZE);
+  switcher->pool_data = data;
+  switcher->n_slots = n_slots;
+
+  zww_window_switcher_v1_send_thumbnail_pool (switcher->binding, switcher->pool_fd, size);
+
+  return true;
+}
+
 static void
-_weston_window_switcher_window_request_show (struct wl_client   *client,
-                                             struct wl_resource *resource,
-                                             struct wl_resource *surface,
-                                             int32_t             x,
-                                             int32_t             y,
-                                             int32_t             width,
-                                             int32_t             height)
+_weston_window_switcher_destroy_pool (struct weston_window_switcher *switcher)
 {
+  if (switcher->pool_data != NULL)
+    munmap (switcher->pool_data, (size_t) switcher->n_slots * THUMBNAIL_SLOT_SIZE);
+  if (switcher->pool_fd >= 0)
+    close (switcher->pool_fd);
+
+  free (switcher->slots);
+  switcher->slots = NULL;
+  switcher->n_slots = 0;
+  switcher->pool_data = NULL;
+  switcher->pool_fd = -1;
+}
 
+static size_t
+_weston_window_switcher_window_back_offset (struct weston_window_switcher_window *self)
+{
+  return (size_t) self->thumbnail_slot * THUMBNAIL_SLOT_SIZE
+         + (size_t) self->thumbnail_back * THUMBNAIL_BUFFER_SIZE;
 }
 
-static const struct zww_window_switcher_window_v1_interface weston_window_switcher_window_implementation = {
-  .destroy = _weston_window_switcher_request_destroy,
-  .switch_to = _weston_window_switcher_window_request_switch_to,
-  .close = _weston_window_switcher_window_request_close,
-  .show = _weston_window_switcher_window_request_show,
-};
+/* Sends the back buffer, which the next thumbnail then leaves alone */
+static void
+_weston_window_switcher_window_send_thumbnail (struct weston_window_switcher_window *self,
+                                               int                                   width,
+                                               int                                   height)
+{
+  zww_window_switcher_window_v1_send_thumbnail (self->resource,
+                                                _weston_window_switcher_window_back_offset (self),
+                                                width, height, width * 4);
+  self->thumbnail_back ^= 1;
+}
 
-void
-_weston_window_switcher_window_create (struct weston_window_switcher *switcher,
-                                       struct weston_surface         *surface)
+static void
+_weston_window_switcher_schedule_thumbnails (struct weston_window_switcher *switcher,
+                                             uint32_t                       delay)
 {
-  struct weston_window_switcher_window *self;
-  struct weston_desktop_surface *dsurface = weston_surface_get_desktop_surface (surface);
+  if (switcher->thumbnail_timer == NULL || switcher->thumbnail_timer_armed)
+    return;
+
+  wl_event_source_timer_update (switcher->thumbnail_timer, delay ? delay : 1);
+  switcher->thumbnail_timer_armed = true;
+}
+
+static void
+_weston_window_switcher_thumbnail_job_run (void *data)
+{
+  struct thumbnail_job *job = data;
+  struct xfway_thumbnail_scaler scaler = { 0 };
+
+  job->ok = xfway_thumbnail_downscale (&scaler,
+                                       job->src, job->width, job->height, job->width * 4,
+                                       job->dst, job->dst_width, job->dst_height,
+                                       job->dst_width * 4, true);
+  xfway_thumbnail_scaler_release (&scaler);
+}
+
+static void
+_weston_window_switcher_thumbnail_job_done (void *data,
+                                            bool  cancelled)
+{
+  struct thumbnail_job *job = data;
+  struct weston_window_switcher_window *self = job->window;
+  struct weston_window_switcher *switcher;
+
+  if (self != NULL)
+    {
+      switcher = self->switcher;
+      self->thumbnail_job = NULL;
+
+      if (!cancelled && job->ok && self->resource != NULL && self->thumbnail_slot >= 0)
+        {
+          memcpy ((uint8_t *) switcher->pool_data
+                  + _weston_window_switcher_window_back_offset (self),
+                  job->dst, (size_t) job->dst_width * job->dst_height * 4);
+          _weston_window_switcher_window_send_thumbnail (self, job->dst_width,
+                                                         job->dst_height);
+        }
+
+      /* committed again while the worker was busy */
+      if (self->thumbnail_dirty)
+        _weston_window_switcher_schedule_thumbnails (switcher, switcher->thumbnail_interval);
+    }
+
+  free (job->src);
+  free (job->dst);
+  free (job);
+}
+
+/* Copies the surface on the compositor thread, where the renderer lives,
+ * and hands the scaling to a worker. Returns false if the job could not be
+ * set up, leaving the caller to do it synchronously. */
+static bool
+_weston_window_switcher_window_submit_thumbnail (struct weston_window_switcher_window *self,
+                                                 struct weston_surface                *surface,
+                                                 int                                   width,
+                                                 int                                   height)
+{
+  struct weston_window_switcher *switcher = self->switcher;
+  struct xfway_job *handle;
+  struct thumbnail_job *job;
+  size_t size = (size_t) width * height * 4;
+  bool handled = false;
+
+  job = zalloc (sizeof (struct thumbnail_job));
+  if (job == NULL)
+    return false;
+
+  job->window = self;
+  job->width = width;
+  job->height = height;
+  xfway_thumbnail_fit (width, height,
+                       self->thumbnail_width, self->thumbnail_height,
+                       &job->dst_width, &job->dst_height);
+  job->src = malloc (size);
+  job->dst = malloc ((size_t) job->dst_width * job->dst_height * 4);
+  if (job->src == NULL || job->dst == NULL)
+    goto err;
+
+  /* nothing to scale, and nothing the synchronous path could do either */
+  if (weston_surface_copy_content (surface, job->src, size, 0, 0, width, height) < 0)
+    {
+      handled = true;
+      goto err;
+    }
 
-  if (dsurface == NULL)
+  handle = xfway_worker_pool_submit (switcher->workers,
+                                     _weston_window_switcher_thumbnail_job_run,
+                                     _weston_window_switcher_thumbnail_job_done,
+                                     job);
+  if (handle == NULL)
+    goto err;
+
+  xfway_job_cancel_on_signal (handle, &surface->destroy_signal);
+  job->handle = handle;
+  self->thumbnail_job = job;
+
+  return true;
+
+err:
+  free (job->src);
+  free (job->dst);
+  free (job);
+  return handled;
+}
+
+static void
+_weston_window_switcher_window_update_thumbnail (struct weston_window_switcher_window *self)
+{
+  struct weston_window_switcher *switcher = self->switcher;
+  struct weston_surface *surface = weston_desktop_surface_get_surface (self->surface);
+  int width, height, dst_width, dst_height;
+  size_t size;
+  uint8_t *dst;
+
+  /* one job per window at a time; the dirty flag brings it back once the
+   * current one is done */
+  if (self->thumbnail_job != NULL)
     return;
 
-  if (switcher->client == NULL)
+  self->thumbnail_dirty = false;
+
+  weston_surface_get_content_size (surface, &width, &height);
+  if (width <= 0 || height <= 0)
     return;
 
-  weston_log ("\nserver: window create\n");
+  if (switcher->workers != NULL
+      && _weston_window_switcher_window_submit_thumbnail (self, surface, width, height))
+    return;
 
-  wl_list_for_each (self,&switcher->windows, link)
+  size = (size_t) width * height * 4;
+  if (switcher->copy_size < size)
     {
-      if (self->surface == dsurface)
+      void *buffer = realloc (switcher->copy_buffer, size);
+
+      if (buffer == NULL)
         return;
+      switcher->copy_buffer = buffer;
+      switcher->copy_size = size;
     }
 
-  self = zalloc (sizeof (struct weston_window_switcher_window));
-  if (self == NULL)
+  if (weston_surface_copy_content (surface, switcher->copy_buffer, size,
+                                   0, 0, width, height) < 0)
+    return;
+
+  xfway_thumbnail_fit (width, height,
+                       self->thumbnail_width, self->thumbnail_height,
+                       &dst_width, &dst_height);
+
+  dst = (uint8_t *) switcher->pool_data + _weston_window_switcher_window_back_offset (self);
+  if (!xfway_thumbnail_downscale (&switcher->scaler,
+                                  switcher->copy_buffer, width, height, width * 4,
+                                  dst, dst_width, dst_height, dst_width * 4,
+                                  true))
+    return;
+
+  _weston_window_switcher_window_send_thumbnail (self, dst_width, dst_height);
+}
+
+static int
+_weston_window_switcher_thumbnail_timer (void *data)
+{
+  struct weston_window_switcher *switcher = data;
+  struct weston_window_switcher_window *window;
+
+  switcher->thumbnail_timer_armed = false;
+
+  wl_list_for_each (window, &switcher->windows, link)
     {
-      wl_client_post_no_memory (switcher->client);
+      if (window->thumbnail_dirty && window->resource != NULL)
+        _weston_window_switcher_window_update_thumbnail (window);
+    }
+
+  return 0;
+}
+
+static void
+_weston_window_switcher_window_request_show (struct wl_client   *client,
+                                             struct wl_resource *resource,
+                                             struct wl_resource *surface,
+                                             int32_t             x,
+                                             int32_t             y,
+                                             int32_t             width,
+                                             int32_t             height)
+{
+  struct weston_window_switcher_window *self = wl_resource_get_user_data (resource);
+  struct weston_window_switcher *switcher;
+  unsigned int i;
+
+  if (x < 0 || y < 0 || width <= 0 || height <= 0)
+    {
+      wl_resource_post_error (resource, ZWW_WINDOW_SWITCHER_WINDOW_V1_ERROR_INVALID_RECTANGLE,
+                              "invalid rectangle %d,%d %dx%d", x, y, width, height);
       return;
     }
 
-  self->switcher = switcher;
-  self->surface = dsurface;
+  if (self == NULL ||
+      wl_resource_get_version (resource) < ZWW_WINDOW_SWITCHER_WINDOW_V1_THUMBNAIL_SINCE_VERSION)
+    return;
+
+  switcher = self->switcher;
+  self->thumbnail_width = MIN (width, THUMBNAIL_MAX_SIZE);
+  self->thumbnail_height = MIN (height, THUMBNAIL_MAX_SIZE);
+
+  if (self->thumbnail_slot < 0)
+    {
+      for (i = 0; i < switcher->n_slots; i++)
+        if (switcher->slots[i] == NULL)
+          break;
+
+      if (i == switcher->n_slots && !_weston_window_switcher_grow_pool (switcher))
+        {
+          wl_client_post_no_memory (client);
+          return;
+        }
+
+      switcher->slots[i] = self;
+      self->thumbnail_slot = i;
+      self->thumbnail_back = 0;
+    }
+
+  self->thumbnail_dirty = true;
+  _weston_window_switcher_schedule_thumbnails (switcher, 0);
+}
+
+static const struct zww_window_switcher_window_v1_interface weston_window_switcher_window_implementation = {
+  .destroy = _weston_window_switcher_request_destroy,
+  .switch_to = _weston_window_switcher_window_request_switch_to,
+  .close = _weston_window_switcher_window_request_close,
+  .show = _weston_window_switcher_window_request_show,
+};
+
+static void
+_weston_window_switcher_window_send (struct weston_window_switcher_window *self)
+{
+  struct weston_window_switcher *switcher = self->switcher;
+  const char *title, *app_id;
 
   self->resource = wl_resource_create (switcher->client, &zww_window_switcher_window_v1_interface,
                                        wl_resource_get_version (switcher->binding), 0);
@@ -166,20 +520,72 @@ _weston_window_switcher_window_create (struct weston_window_switcher *switcher,
       return;
     }
 
-  self->surface_destroy_listener.notify = _weston_window_switcher_window_surface_destroyed;
-  wl_signal_add (&surface->destroy_signal, &self->surface_destroy_listener);
   wl_resource_set_implementation(self->resource, &weston_window_switcher_window_implementation,
                                  self, _weston_window_switcher_window_destroy);
   zww_window_switcher_v1_send_window (switcher->binding, self->resource);
 
-  const char *title = weston_desktop_surface_get_title (self->surface);
+  title = weston_desktop_surface_get_title (self->surface);
   if (title != NULL)
-      zww_window_switcher_window_v1_send_title (self->resource, title);
-const char *app_id = weston_desktop_surface_get_app_id (self->surface);
-if (app_id != NULL)
-      zww_window_switcher_window_v1_send_app_id (self->resource, app_id);
-zww_window_switcher_window_v1_send_done (self->resource);
+    zww_window_switcher_window_v1_send_title (self->resource, title);
+  app_id = weston_desktop_surface_get_app_id (self->surface);
+  if (app_id != NULL)
+    zww_window_switcher_window_v1_send_app_id (self->resource, app_id);
+  zww_window_switcher_window_v1_send_done (self->resource);
+}
 
+struct weston_window_switcher_window *
+weston_window_switcher_surface_added (struct weston_window_switcher *switcher,
+                                      struct weston_desktop_surface *dsurface)
+{
+  struct weston_window_switcher_window *self;
+
+  self = zalloc (sizeof (struct weston_window_switcher_window));
+  if (self == NULL)
+    return NULL;
+
+  self->switcher = switcher;
+  self->surface = dsurface;
+  self->thumbnail_slot = -1;
+
+  wl_list_insert (switcher->windows.prev, &self->link);
+
+  if (switcher->binding != NULL)
+    _weston_window_switcher_window_send (self);
+
+  return self;
+}
+
+void
+weston_window_switcher_surface_removed (struct weston_window_switcher        *switcher,
+                                        struct weston_window_switcher_window *self)
+{
+  if (self != NULL)
+    _weston_window_switcher_window_free (self);
+}
+
+void
+weston_window_switcher_surface_committed (struct weston_window_switcher        *switcher,
+                                          struct weston_window_switcher_window *self)
+{
+  if (self == NULL || self->thumbnail_slot < 0)
+    return;
+
+  self->thumbnail_dirty = true;
+  _weston_window_switcher_schedule_thumbnails (switcher, switcher->thumbnail_interval);
+}
+
+void
+weston_window_switcher_set_thumbnail_interval (struct weston_window_switcher *switcher,
+                                               uint32_t                       interval)
+{
+  switcher->thumbnail_interval = interval;
+}
+
+void
+weston_window_switcher_set_worker_pool (struct weston_window_switcher *switcher,
+                                        struct xfway_worker_pool      *workers)
+{
+  switcher->workers = workers;
 }
 
 static const struct zww_window_switcher_v1_interface weston_window_switcher_implementation =
@@ -187,6 +593,34 @@ static const struct zww_window_switcher_v1_interface weston_window_switcher_impl
   .destroy = _weston_window_switcher_request_destroy,
 };
 
+static void
+_weston_window_switcher_unbind (struct wl_resource *resource)
+{
+  struct weston_window_switcher *self = wl_resource_get_user_data (resource);
+  struct weston_window_switcher_window *window;
+
+  if (self->binding != resource)
+    return;
+
+  /* nobody is left to send the thumbnails being scaled to */
+  wl_list_for_each (window, &self->windows, link)
+    {
+      if (window->thumbnail_job != NULL)
+        xfway_job_cancel (window->thumbnail_job->handle);
+      _weston_window_switcher_release_slot (window);
+      if (window->resource != NULL)
+        {
+          wl_resource_set_user_data (window->resource, NULL);
+          window->resource = NULL;
+        }
+    }
+
+  _weston_window_switcher_destroy_pool (self);
+
+  self->client = NULL;
+  self->binding = NULL;
+}
+
 static void
 _weston_window_switcher_bind (struct wl_client *client,
                               void             *data,
@@ -194,13 +628,19 @@ _weston_window_switcher_bind (struct wl_client *client,
                               uint32_t          id)
 {
   struct weston_window_switcher *self = data;
+  struct weston_window_switcher_window *window;
   struct wl_resource *resource;
 
-  weston_log ("\nserver: switcher bind\n");
+  xfway_log_debug (XFWAY_LOG_SCOPE_SWITCHER, "switcher bind\n");
 
   resource = wl_resource_create (client, &zww_window_switcher_v1_interface, version, id);
+  if (resource == NULL)
+    {
+      wl_client_post_no_memory (client);
+      return;
+    }
   wl_resource_set_implementation (resource, &weston_window_switcher_implementation,
-                                  self, NULL);
+                                  self, _weston_window_switcher_unbind);
 
   if (self->binding != NULL)
     {
@@ -213,9 +653,8 @@ _weston_window_switcher_bind (struct wl_client *client,
   self->client = client;
   self->binding = resource;
 
-  struct weston_view *view;
-  wl_list_for_each (view, &self->compositor->view_list, link)
-    _weston_window_switcher_window_create (self, view->surface);
+  wl_list_for_each (window, &self->windows, link)
+    _weston_window_switcher_window_send (window);
 }
 
 WL_EXPORT int
@@ -228,11 +667,16 @@ weston_window_switcher_module_init (struct weston_compositor *compositor,
 
   window_switcher->compositor = compositor;
   window_switcher->client = NULL;
+  window_switcher->pool_fd = -1;
+  window_switcher->thumbnail_interval = 500;
+  window_switcher->thumbnail_timer =
+    wl_event_loop_add_timer (wl_display_get_event_loop (compositor->wl_display),
+                             _weston_window_switcher_thumbnail_timer, window_switcher);
 
   wl_list_init (&window_switcher->windows);
 
   if (wl_global_create (window_switcher->compositor->wl_display,
-                        &zww_window_switcher_v1_interface, 1,
+                        &zww_window_switcher_v1_interface, 2,
                         window_switcher, _weston_window_switcher_bind) == NULL)
     return -1;
 
@@ -0,0 +1,297 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "os-compatibility.h"
+#include "window-table.h"
+
+/* open addressing, must be a power of two */
+#define INTERN_SLOTS 16384
+#define INTERN_MAX_LOAD (INTERN_SLOTS / 4 * 3)
+
+struct xfway_window_table
+{
+  int fd;
+  void *map;
+
+  struct xfway_window_table_header *header;
+  struct xfway_window_table_entry *entries;
+  char *strings;
+
+  /* unused entries below header->n_entries */
+  uint32_t free_entries[XFWAY_WINDOW_TABLE_MAX_WINDOWS];
+  uint32_t n_free_entries;
+
+  /* string offsets by hash, 0 for an empty slot; strings are never freed
+   * individually, the area is compacted when it runs out */
+  uint32_t intern[INTERN_SLOTS];
+  uint32_t n_interned;
+};
+
+static uint32_t
+string_hash (const char *s)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*s)
+    hash = (hash ^ (unsigned char) *s++) * 16777619u;
+
+  return hash;
+}
+
+static void
+intern_reset (struct xfway_window_table *table)
+{
+  memset (table->intern, 0, sizeof (table->intern));
+  table->n_interned = 0;
+  table->strings[0] = '\0';
+  table->header->strings_used = 1;
+}
+
+/* Returns the offset of s in the string area, adding it if needed, or 0
+ * if it does not fit. */
+static uint32_t
+intern_string (struct xfway_window_table *table,
+               const char                *s)
+{
+  struct xfway_window_table_header *header = table->header;
+  uint32_t i, len;
+
+  if (!s || !*s)
+    return 0;
+
+  for (i = string_hash (s) & (INTERN_SLOTS - 1);
+       table->intern[i] != 0;
+       i = (i + 1) & (INTERN_SLOTS - 1))
+    {
+      if (strcmp (table->strings + table->intern[i], s) == 0)
+        return table->intern[i];
+    }
+
+  len = strlen (s) + 1;
+  if (len > header->strings_size - header->strings_used ||
+      table->n_interned >= INTERN_MAX_LOAD)
+    return 0;
+
+  table->intern[i] = header->strings_used;
+  table->n_interned++;
+  memcpy (table->strings + header->strings_used, s, len);
+  header->strings_used += len;
+
+  return table->intern[i];
+}
+
+/* Drop the strings no entry refers to anymore. Runs inside an update, so
+ * readers never see the area half rewritten. */
+static void
+compact_strings (struct xfway_window_table *table)
+{
+  struct xfway_window_table_entry *entry;
+  char *old;
+  uint32_t i;
+
+  old = malloc (table->header->strings_used);
+  if (!old)
+    return;
+  memcpy (old, table->strings, table->header->strings_used);
+
+  intern_reset (table);
+  for (i = 0; i < table->header->n_entries; i++)
+    {
+      entry = &table->entries[i];
+      if (entry->id == 0)
+        continue;
+
+      entry->title = intern_string (table, old + entry->title);
+      entry->app_id = intern_string (table, old + entry->app_id);
+    }
+
+  free (old);
+}
+
+static uint32_t
+intern_string_or_compact (struct xfway_window_table *table,
+                          const char                *s)
+{
+  uint32_t offset;
+
+  if (!s || !*s)
+    return 0;
+
+  offset = intern_string (table, s);
+  if (offset == 0)
+    {
+      compact_strings (table);
+      offset = intern_string (table, s);
+    }
+
+  return offset;
+}
+
+static void
+table_begin_update (struct xfway_window_table *table)
+{
+  __atomic_store_n (&table->header->seq, table->header->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+static void
+table_end_update (struct xfway_window_table *table)
+{
+  __atomic_store_n (&table->header->seq, table->header->seq + 1, __ATOMIC_RELEASE);
+}
+
+struct xfway_window_table *
+xfway_window_table_create (void)
+{
+  struct xfway_window_table *table;
+  struct xfway_window_table_header *header;
+
+  table = calloc (1, sizeof (*table));
+  if (!table)
+    return NULL;
+
+  table->fd = os_create_anonymous_file (XFWAY_WINDOW_TABLE_SIZE);
+  if (table->fd < 0)
+    {
+      free (table);
+      return NULL;
+    }
+
+  table->map = mmap (NULL, XFWAY_WINDOW_TABLE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, table->fd, 0);
+  if (table->map == MAP_FAILED)
+    {
+      close (table->fd);
+      free (table);
+      return NULL;
+    }
+
+  header = table->map;
+  header->magic = XFWAY_WINDOW_TABLE_MAGIC;
+  header->version = XFWAY_WINDOW_TABLE_VERSION;
+  header->seq = 0;
+  header->n_entries = 0;
+  header->max_entries = XFWAY_WINDOW_TABLE_MAX_WINDOWS;
+  header->entries_offset = sizeof (*header);
+  header->strings_offset = header->entries_offset +
+    XFWAY_WINDOW_TABLE_MAX_WINDOWS * sizeof (struct xfway_window_table_entry);
+  header->strings_size = XFWAY_WINDOW_TABLE_STRINGS_SIZE;
+
+  table->header = header;
+  table->entries = (struct xfway_window_table_entry *)
+    ((char *) table->map + header->entries_offset);
+  table->strings = (char *) table->map + header->strings_offset;
+  intern_reset (table);
+
+  return table;
+}
+
+void
+xfway_window_table_destroy (struct xfway_window_table *table)
+{
+  munmap (table->map, XFWAY_WINDOW_TABLE_SIZE);
+  close (table->fd);
+  free (table);
+}
+
+int
+xfway_window_table_get_fd (struct xfway_window_table *table)
+{
+  return table->fd;
+}
+
+uint32_t
+xfway_window_table_get_size (struct xfway_window_table *table)
+{
+  return XFWAY_WINDOW_TABLE_SIZE;
+}
+
+int
+xfway_window_table_set (struct xfway_window_table *table,
+                        int                        index,
+                        uint32_t                   id,
+                        uint32_t                   flags,
+                        uint32_t                   mru_rank,
+                        uint32_t                   output_mask,
+                        const char                *title,
+                        const char                *app_id)
+{
+  struct xfway_window_table_header *header = table->header;
+  struct xfway_window_table_entry *entry;
+  const char *old_title = NULL, *old_app_id = NULL;
+
+  if (index < 0)
+    {
+      if (table->n_free_entries > 0)
+        index = table->free_entries[--table->n_free_entries];
+      else if (header->n_entries < header->max_entries)
+        index = header->n_entries;
+      else
+        return -1;
+    }
+
+  entry = &table->entries[index];
+  if (entry->id != 0)
+    {
+      old_title = table->strings + entry->title;
+      old_app_id = table->strings + entry->app_id;
+    }
+
+  table_begin_update (table);
+
+  if ((uint32_t) index >= header->n_entries)
+    header->n_entries = index + 1;
+
+  entry->id = id;
+  entry->flags = flags;
+  entry->mru_rank = mru_rank;
+  entry->output_mask = output_mask;
+
+  /* titles change far more often than anything else */
+  if (!old_title || strcmp (old_title, title ? title : "") != 0)
+    entry->title = intern_string_or_compact (table, title);
+  if (!old_app_id || strcmp (old_app_id, app_id ? app_id : "") != 0)
+    entry->app_id = intern_string_or_compact (table, app_id);
+
+  table_end_update (table);
+
+  return index;
+}
+
+void
+xfway_window_table_remove (struct xfway_window_table *table,
+                           int                        index)
+{
+  struct xfway_window_table_entry *entry;
+
+  if (index < 0 || (uint32_t) index >= table->header->n_entries)
+    return;
+
+  entry = &table->entries[index];
+  if (entry->id == 0)
+    return;
+
+  table_begin_update (table);
+  memset (entry, 0, sizeof (*entry));
+  table_end_update (table);
+
+  table->free_entries[table->n_free_entries++] = index;
+}
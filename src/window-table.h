@@ -0,0 +1,149 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Layout of the window table the compositor shares with the shell client
+ * through xfway_shell.get_window_table. The compositor is the only writer.
+ * Every update is bracketed by the sequence counter in the header, which is
+ * odd while an update is in progress; readers copy what they need and retry
+ * if the counter changed meanwhile. */
+
+#ifndef __WINDOW_TABLE_H__
+#define __WINDOW_TABLE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define XFWAY_WINDOW_TABLE_MAGIC 0x54574658 /* "XFWT" */
+#define XFWAY_WINDOW_TABLE_VERSION 1
+
+#define XFWAY_WINDOW_TABLE_MAX_WINDOWS 1024
+#define XFWAY_WINDOW_TABLE_STRINGS_SIZE (256 * 1024)
+#define XFWAY_WINDOW_TABLE_READ_TRIES 10000
+
+/* same bits as wlr_foreign_toplevel_handle_v1_state */
+enum xfway_window_table_flags
+{
+  XFWAY_WINDOW_TABLE_FLAG_MAXIMIZED = (1 << 0),
+  XFWAY_WINDOW_TABLE_FLAG_MINIMIZED = (1 << 1),
+  XFWAY_WINDOW_TABLE_FLAG_ACTIVATED = (1 << 2),
+  XFWAY_WINDOW_TABLE_FLAG_FULLSCREEN = (1 << 3),
+};
+
+struct xfway_window_table_header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seq;
+  /* entries [0, n_entries) are in use when their id is not 0 */
+  uint32_t n_entries;
+  uint32_t max_entries;
+  uint32_t entries_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+  /* bytes of the string area in use, offset 0 is always "" */
+  uint32_t strings_used;
+};
+
+struct xfway_window_table_entry
+{
+  uint32_t id;      /* as in xfway_shell.toplevel_id, 0 for a free entry */
+  uint32_t flags;   /* xfway_window_table_flags */
+  uint32_t mru_rank; /* larger is more recently activated */
+  uint32_t output_mask;
+  /* offsets of nul-terminated strings in the string area, 0 for none */
+  uint32_t title;
+  uint32_t app_id;
+};
+
+#define XFWAY_WINDOW_TABLE_SIZE                                   \
+  (sizeof (struct xfway_window_table_header) +                    \
+   XFWAY_WINDOW_TABLE_MAX_WINDOWS * sizeof (struct xfway_window_table_entry) + \
+   XFWAY_WINDOW_TABLE_STRINGS_SIZE)
+
+/* Copy a consistent snapshot of the table at map into entries and strings,
+ * which hold max_entries entries and strings_size bytes; strings_size must
+ * be at least the header's strings_size. Returns the number of entries
+ * copied, or -1 if map is not a window table or no consistent snapshot
+ * could be taken, e.g. because the compositor died during an update. */
+static inline int
+xfway_window_table_read (const void                      *map,
+                         struct xfway_window_table_entry *entries,
+                         uint32_t                         max_entries,
+                         char                            *strings,
+                         uint32_t                         strings_size)
+{
+  const struct xfway_window_table_header *header = map;
+  uint32_t seq, n, used;
+  int tries;
+
+  if (header->magic != XFWAY_WINDOW_TABLE_MAGIC ||
+      header->version != XFWAY_WINDOW_TABLE_VERSION ||
+      header->strings_size > strings_size)
+    return -1;
+
+  for (tries = 0; ; tries++)
+    {
+      if (tries == XFWAY_WINDOW_TABLE_READ_TRIES)
+        return -1;
+
+      seq = __atomic_load_n (&header->seq, __ATOMIC_ACQUIRE);
+      if (seq & 1)
+        continue;
+
+      n = header->n_entries;
+      if (n > max_entries)
+        n = max_entries;
+      used = header->strings_used;
+      if (used > header->strings_size)
+        used = header->strings_size;
+
+      memcpy (entries, (const char *) map + header->entries_offset,
+              n * sizeof (*entries));
+      memcpy (strings, (const char *) map + header->strings_offset, used);
+
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      if (__atomic_load_n (&header->seq, __ATOMIC_RELAXED) == seq)
+        break;
+    }
+
+  memset (strings + used, 0, strings_size - used);
+  return n;
+}
+
+/* Compositor side, see window-table.c */
+
+struct xfway_window_table;
+
+struct xfway_window_table *xfway_window_table_create (void);
+void xfway_window_table_destroy (struct xfway_window_table *table);
+int xfway_window_table_get_fd (struct xfway_window_table *table);
+uint32_t xfway_window_table_get_size (struct xfway_window_table *table);
+
+/* Store a window at index, or in a free entry if index is negative.
+ * Returns the index used, or -1 if the table is full. */
+int xfway_window_table_set (struct xfway_window_table *table,
+                            int                        index,
+                            uint32_t                   id,
+                            uint32_t                   flags,
+                            uint32_t                   mru_rank,
+                            uint32_t                   output_mask,
+                            const char                *title,
+                            const char                *app_id);
+void xfway_window_table_remove (struct xfway_window_table *table,
+                                int                        index);
+
+#endif /* __WINDOW_TABLE_H__ */
@@ -3,7 +3,9 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include "wlr_foreign_toplevel_management_v1.h"
+#include "log.h"
 //#include <wlr/types/wlr_seat.h>
 //#include <wlr/util/log.h>
 #include "../util/signal.h"
@@ -171,14 +173,36 @@ static const struct zwlr_foreign_toplevel_handle_v1_interface toplevel_handle_im
 	.unset_fullscreen = foreign_toplevel_handle_unset_fullscreen,
 };
 
+static void toplevel_send_state(struct wlr_foreign_toplevel_handle_v1 *toplevel);
+
 static void toplevel_idle_send_done(void *data) {
 	struct wlr_foreign_toplevel_handle_v1 *toplevel = data;
 	struct wl_resource *resource;
+
+	if (toplevel->pending & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_TITLE) {
+		wl_resource_for_each(resource, &toplevel->resources) {
+			zwlr_foreign_toplevel_handle_v1_send_title(resource,
+				toplevel->title);
+		}
+	}
+	if (toplevel->pending & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_APP_ID) {
+		wl_resource_for_each(resource, &toplevel->resources) {
+			zwlr_foreign_toplevel_handle_v1_send_app_id(resource,
+				toplevel->app_id);
+		}
+	}
+	if (toplevel->pending & WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_STATE) {
+		toplevel_send_state(toplevel);
+	}
+	toplevel->pending = 0;
+
 	wl_resource_for_each(resource, &toplevel->resources) {
 		zwlr_foreign_toplevel_handle_v1_send_done(resource);
 	}
 
 	toplevel->idle_source = NULL;
+
+	wlr_signal_emit_safe(&toplevel->events.done, toplevel);
 }
 
 static void toplevel_update_idle_source(
@@ -191,38 +215,130 @@ static void toplevel_update_idle_source(
 		toplevel_idle_send_done, toplevel);
 }
 
+static bool toplevel_update_string(char **field, const char *value) {
+	if (*field && strcmp(*field, value) == 0) {
+		return false;
+	}
+
+	char *copy = strdup(value);
+	if (!copy) {
+		return false;
+	}
+	free(*field);
+	*field = copy;
+	return true;
+}
+
+static uint32_t get_current_time_msec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void toplevel_count_suppressed_title(
+		struct wlr_foreign_toplevel_handle_v1 *toplevel) {
+	struct wlr_foreign_toplevel_manager_v1 *manager = toplevel->manager;
+	const char *app_id = toplevel->app_id ? toplevel->app_id : "";
+
+	toplevel->title_suppressed++;
+	if (toplevel->title_stats) {
+		toplevel->title_stats->suppressed++;
+		return;
+	}
+
+	struct wlr_foreign_toplevel_title_stats *stats;
+	wl_list_for_each(stats, &manager->title_stats, link) {
+		if (strcmp(stats->app_id, app_id) == 0) {
+			stats->suppressed++;
+			toplevel->title_stats = stats;
+			return;
+		}
+	}
+
+	stats = calloc(1, sizeof(struct wlr_foreign_toplevel_title_stats));
+	if (!stats) {
+		return;
+	}
+	stats->app_id = strdup(app_id);
+	if (!stats->app_id) {
+		free(stats);
+		return;
+	}
+	stats->suppressed = 1;
+	wl_list_insert(&manager->title_stats, &stats->link);
+	toplevel->title_stats = stats;
+}
+
+static void toplevel_send_title_now(
+		struct wlr_foreign_toplevel_handle_v1 *toplevel, uint32_t now) {
+	toplevel->title_deferred = false;
+	toplevel->title_sent_msec = now;
+	toplevel->pending |= WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_TITLE;
+	toplevel_update_idle_source(toplevel);
+}
+
+static int toplevel_handle_title_timer(void *data) {
+	struct wlr_foreign_toplevel_handle_v1 *toplevel = data;
+
+	if (toplevel->title_deferred) {
+		toplevel_send_title_now(toplevel, get_current_time_msec());
+	}
+	return 0;
+}
+
 void wlr_foreign_toplevel_handle_v1_set_title(
 		struct wlr_foreign_toplevel_handle_v1 *toplevel, const char *title) {
-	free(toplevel->title);
-	toplevel->title = strdup(title);
+	if (!toplevel_update_string(&toplevel->title, title)) {
+		return;
+	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &toplevel->resources) {
-		zwlr_foreign_toplevel_handle_v1_send_title(resource, title);
+	uint32_t interval = toplevel->manager->title_interval_ms;
+	uint32_t now = get_current_time_msec();
+	uint32_t elapsed = now - toplevel->title_sent_msec;
+	if (interval == 0 || toplevel->title_sent_msec == 0 ||
+			(elapsed >= interval && !toplevel->title_deferred)) {
+		toplevel_send_title_now(toplevel, now);
+		return;
 	}
 
-	toplevel_update_idle_source(toplevel);
+	// too soon after the last one, the timer sends whatever is latest
+	toplevel_count_suppressed_title(toplevel);
+	if (toplevel->title_deferred) {
+		return;
+	}
+
+	if (!toplevel->title_timer) {
+		toplevel->title_timer = wl_event_loop_add_timer(
+			toplevel->manager->event_loop, toplevel_handle_title_timer,
+			toplevel);
+		if (!toplevel->title_timer) {
+			toplevel_send_title_now(toplevel, now);
+			return;
+		}
+	}
+	toplevel->title_deferred = true;
+	wl_event_source_timer_update(toplevel->title_timer,
+		elapsed < interval ? interval - elapsed : 1);
 }
 
 void wlr_foreign_toplevel_handle_v1_set_app_id(
 		struct wlr_foreign_toplevel_handle_v1 *toplevel, const char *app_id) {
-	free(toplevel->app_id);
-	toplevel->app_id = strdup(app_id);
-
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &toplevel->resources) {
-		zwlr_foreign_toplevel_handle_v1_send_app_id(resource, app_id);
+	if (!toplevel_update_string(&toplevel->app_id, app_id)) {
+		return;
 	}
 
+	// entries live as long as the manager, so the old one needs no care
+	toplevel->title_stats = NULL;
+	toplevel->pending |= WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_APP_ID;
 	toplevel_update_idle_source(toplevel);
 }
 
-/*static void send_output_to_resource(struct wl_resource *resource,
-		struct wlr_output *output, bool enter) {
+static void send_output_to_resource(struct wl_resource *resource,
+		struct weston_output *output, bool enter) {
 	struct wl_client *client = wl_resource_get_client(resource);
 	struct wl_resource *output_resource;
 
-	wl_resource_for_each(output_resource, &output->resources) {
+	wl_resource_for_each(output_resource, &output->resource_list) {
 		if (wl_resource_get_client(output_resource) == client) {
 			if (enter) {
 				zwlr_foreign_toplevel_handle_v1_send_output_enter(resource,
@@ -233,10 +349,10 @@ void wlr_foreign_toplevel_handle_v1_set_app_id(
 			}
 		}
 	}
-}*/
+}
 
-/*static void toplevel_send_output(struct wlr_foreign_toplevel_handle_v1 *toplevel,
-		struct wlr_output *output, bool enter) {
+static void toplevel_send_output(struct wlr_foreign_toplevel_handle_v1 *toplevel,
+		struct weston_output *output, bool enter) {
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &toplevel->resources) {
 		send_output_to_resource(resource, output, enter);
@@ -245,68 +361,53 @@ void wlr_foreign_toplevel_handle_v1_set_app_id(
 	toplevel_update_idle_source(toplevel);
 }
 
-static void toplevel_handle_output_destroy(struct wl_listener *listener,
-		void *data) {
-	struct wlr_foreign_toplevel_handle_v1_output *toplevel_output =
-		wl_container_of(listener, toplevel_output, output_destroy);
-	wlr_foreign_toplevel_handle_v1_output_leave(toplevel_output->toplevel,
-		toplevel_output->output);
-}
-
 void wlr_foreign_toplevel_handle_v1_output_enter(
 		struct wlr_foreign_toplevel_handle_v1 *toplevel,
-		struct wlr_output *output) {
-	struct wlr_foreign_toplevel_handle_v1_output *toplevel_output;
-	wl_list_for_each(toplevel_output, &toplevel->outputs, link) {
-		if (toplevel_output->output == output) {
-			return; // we have already sent output_enter event
-		}
+		struct weston_output *output) {
+	uint32_t bit = 1u << output->id;
+	if (toplevel->output_mask & bit) {
+		return; // we have already sent output_enter event
 	}
 
-	toplevel_output =
-		calloc(1, sizeof(struct wlr_foreign_toplevel_handle_v1_output));
-	if (!toplevel_output) {
-		wlr_log(WLR_ERROR, "failed to allocate memory for toplevel output");
+	toplevel->output_mask |= bit;
+	toplevel_send_output(toplevel, output, true);
+}
+
+void wlr_foreign_toplevel_handle_v1_output_leave(
+		struct wlr_foreign_toplevel_handle_v1 *toplevel,
+		struct weston_output *output) {
+	uint32_t bit = 1u << output->id;
+	if (!(toplevel->output_mask & bit)) {
 		return;
 	}
 
-	toplevel_output->output = output;
-	toplevel_output->toplevel = toplevel;
-	wl_list_insert(&toplevel->outputs, &toplevel_output->link);
-
-	toplevel_output->output_destroy.notify = toplevel_handle_output_destroy;
-	wl_signal_add(&output->events.destroy, &toplevel_output->output_destroy);
-
-	toplevel_send_output(toplevel, output, true);
+	toplevel->output_mask &= ~bit;
+	toplevel_send_output(toplevel, output, false);
 }
 
-static void toplevel_output_destroy(
-		struct wlr_foreign_toplevel_handle_v1_output *toplevel_output) {
-	wl_list_remove(&toplevel_output->link);
-	wl_list_remove(&toplevel_output->output_destroy.link);
-	free(toplevel_output);
-}
+void wlr_foreign_toplevel_handle_v1_set_output_mask(
+		struct wlr_foreign_toplevel_handle_v1 *toplevel, uint32_t output_mask) {
+	uint32_t changed = toplevel->output_mask ^ output_mask;
+	if (changed == 0) {
+		return;
+	}
 
-void wlr_foreign_toplevel_handle_v1_output_leave(
-		struct wlr_foreign_toplevel_handle_v1 *toplevel,
-		struct wlr_output *output) {
-	struct wlr_foreign_toplevel_handle_v1_output *toplevel_output_iterator;
-	struct wlr_foreign_toplevel_handle_v1_output *toplevel_output = NULL;
-
-	wl_list_for_each(toplevel_output_iterator, &toplevel->outputs, link) {
-		if (toplevel_output_iterator->output == output) {
-			toplevel_output = toplevel_output_iterator;
-			break;
+	struct weston_output *output;
+	wl_list_for_each(output, &toplevel->manager->compositor->output_list, link) {
+		uint32_t bit = 1u << output->id;
+		if (!(changed & bit)) {
+			continue;
+		}
+		if (output_mask & bit) {
+			wlr_foreign_toplevel_handle_v1_output_enter(toplevel, output);
+		} else {
+			wlr_foreign_toplevel_handle_v1_output_leave(toplevel, output);
 		}
 	}
 
-	if (toplevel_output) {
-		toplevel_send_output(toplevel, output, false);
-		toplevel_output_destroy(toplevel_output);
-	} else {
-		// XXX: log an error? crash?
-	}
-}*/
+	// ids without a live output have no wl_output left to send leave for
+	toplevel->output_mask = output_mask;
+}
 
 static bool fill_array_from_toplevel_state(struct wl_array *array,
 		uint32_t state) {
@@ -362,47 +463,43 @@ static void toplevel_send_state(struct wlr_foreign_toplevel_handle_v1 *toplevel)
 	}
 
 	wl_array_release(&states);
+}
+
+static void toplevel_set_state_flag(
+		struct wlr_foreign_toplevel_handle_v1 *toplevel,
+		enum wlr_foreign_toplevel_handle_v1_state flag, bool set) {
+	uint32_t state = set ? toplevel->state | flag : toplevel->state & ~flag;
+	if (state == toplevel->state) {
+		return;
+	}
+
+	toplevel->state = state;
+	toplevel->pending |= WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_STATE;
 	toplevel_update_idle_source(toplevel);
 }
 
 void wlr_foreign_toplevel_handle_v1_set_maximized(
 		struct wlr_foreign_toplevel_handle_v1 *toplevel, bool maximized) {
-	if (maximized) {
-		toplevel->state |= WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED;
-	} else {
-		toplevel->state &= ~WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED;
-	}
-	toplevel_send_state(toplevel);
+	toplevel_set_state_flag(toplevel,
+		WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED, maximized);
 }
 
 void wlr_foreign_toplevel_handle_v1_set_minimized(
 		struct wlr_foreign_toplevel_handle_v1 *toplevel, bool minimized) {
-	if (minimized) {
-		toplevel->state |= WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED;
-	} else {
-		toplevel->state &= ~WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED;
-	}
-	toplevel_send_state(toplevel);
+	toplevel_set_state_flag(toplevel,
+		WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED, minimized);
 }
 
 void wlr_foreign_toplevel_handle_v1_set_activated(
 		struct wlr_foreign_toplevel_handle_v1 *toplevel, bool activated) {
-	if (activated) {
-		toplevel->state |= WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED;
-	} else {
-		toplevel->state &= ~WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED;
-	}
-	toplevel_send_state(toplevel);
+	toplevel_set_state_flag(toplevel,
+		WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED, activated);
 }
 
 void wlr_foreign_toplevel_handle_v1_set_fullscreen(
 		struct wlr_foreign_toplevel_handle_v1 * toplevel, bool fullscreen) {
-	if (fullscreen) {
-		toplevel->state |= WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN;
-	} else {
-		toplevel->state &= ~WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN;
-	}
-	toplevel_send_state(toplevel);
+	toplevel_set_state_flag(toplevel,
+		WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN, fullscreen);
 }
 
 void wlr_foreign_toplevel_handle_v1_destroy(
@@ -421,14 +518,19 @@ void wlr_foreign_toplevel_handle_v1_destroy(
 		wl_list_init(wl_resource_get_link(resource));
 	}
 
-	/*struct wlr_foreign_toplevel_handle_v1_output *toplevel_output, *tmp2;
-	wl_list_for_each_safe(toplevel_output, tmp2, &toplevel->outputs, link) {
-		toplevel_output_destroy(toplevel_output);
-	}*/
-
 	if (toplevel->idle_source) {
 		wl_event_source_remove(toplevel->idle_source);
 	}
+	if (toplevel->title_timer) {
+		wl_event_source_remove(toplevel->title_timer);
+	}
+
+	struct wlr_foreign_toplevel_snapshot_v1 *snapshot;
+	wl_list_for_each(snapshot, &toplevel->manager->snapshots, link) {
+		if (snapshot->next == &toplevel->link) {
+			snapshot->next = toplevel->link.next;
+		}
+	}
 
 	wl_list_remove(&toplevel->link);
 
@@ -458,6 +560,12 @@ static struct wl_resource *create_toplevel_resource_for_resource(
 
 	wl_list_insert(&toplevel->resources, wl_resource_get_link(resource));
 	zwlr_foreign_toplevel_manager_v1_send_toplevel(manager_resource, resource);
+
+	struct wlr_foreign_toplevel_handle_v1_resource_event event = {
+		.toplevel = toplevel,
+		.resource = resource,
+	};
+	wlr_signal_emit_safe(&toplevel->manager->events.new_resource, &event);
 	return resource;
 }
 
@@ -474,7 +582,6 @@ wlr_foreign_toplevel_handle_v1_create(
 	toplevel->manager = manager;
 
 	wl_list_init(&toplevel->resources);
-	wl_list_init(&toplevel->outputs);
 
 	wl_signal_init(&toplevel->events.request_maximize);
 	wl_signal_init(&toplevel->events.request_minimize);
@@ -482,6 +589,7 @@ wlr_foreign_toplevel_handle_v1_create(
 	wl_signal_init(&toplevel->events.request_fullscreen);
 	wl_signal_init(&toplevel->events.request_close);
 	wl_signal_init(&toplevel->events.set_rectangle);
+	wl_signal_init(&toplevel->events.done);
 	wl_signal_init(&toplevel->events.destroy);
 
 	struct wl_resource *manager_resource, *tmp;
@@ -510,8 +618,23 @@ static const struct zwlr_foreign_toplevel_manager_v1_interface
 	.stop = foreign_toplevel_manager_handle_stop
 };
 
+static void snapshot_destroy(struct wlr_foreign_toplevel_snapshot_v1 *snapshot) {
+	wl_list_remove(&snapshot->link);
+	wl_event_source_remove(snapshot->timer);
+	free(snapshot);
+}
+
 static void foreign_toplevel_manager_resource_destroy(
 		struct wl_resource *resource) {
+	struct wlr_foreign_toplevel_manager_v1 *manager =
+		wl_resource_get_user_data(resource);
+	struct wlr_foreign_toplevel_snapshot_v1 *snapshot, *tmp;
+	wl_list_for_each_safe(snapshot, tmp, &manager->snapshots, link) {
+		if (snapshot->resource == resource) {
+			snapshot_destroy(snapshot);
+		}
+	}
+
 	wl_list_remove(wl_resource_get_link(resource));
 }
 
@@ -525,10 +648,13 @@ static void toplevel_send_details_to_toplevel_resource(
 		zwlr_foreign_toplevel_handle_v1_send_app_id(resource, toplevel->app_id);
 	}
 
-	/*struct wlr_foreign_toplevel_handle_v1_output *output;
-	wl_list_for_each(output, &toplevel->outputs, link) {
-		send_output_to_resource(resource, output->output, true);
-	}*/
+	struct weston_output *output;
+	wl_list_for_each(output, &toplevel->manager->compositor->output_list,
+			link) {
+		if (toplevel->output_mask & (1u << output->id)) {
+			send_output_to_resource(resource, output, true);
+		}
+	}
 
 	struct wl_array states;
 	wl_array_init(&states);
@@ -545,6 +671,45 @@ static void toplevel_send_details_to_toplevel_resource(
 	zwlr_foreign_toplevel_handle_v1_send_done(resource);
 }
 
+static int snapshot_handle_timer(void *data) {
+	struct wlr_foreign_toplevel_snapshot_v1 *snapshot = data;
+	struct wlr_foreign_toplevel_manager_v1 *manager = snapshot->manager;
+
+	for (int i = 0; i < WLR_FOREIGN_TOPLEVEL_SNAPSHOT_V1_CHUNK_SIZE &&
+			snapshot->next != &manager->toplevels; i++) {
+		struct wlr_foreign_toplevel_handle_v1 *toplevel =
+			wl_container_of(snapshot->next, toplevel, link);
+		snapshot->next = snapshot->next->next;
+
+		struct wl_resource *toplevel_resource =
+			create_toplevel_resource_for_resource(toplevel,
+				snapshot->resource);
+		if (!toplevel_resource) {
+			snapshot_destroy(snapshot);
+			return 0;
+		}
+		toplevel_send_details_to_toplevel_resource(toplevel,
+			toplevel_resource);
+		snapshot->sent++;
+	}
+
+	if (snapshot->next != &manager->toplevels) {
+		wl_event_source_timer_update(snapshot->timer, 1);
+		return 0;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	xfway_log_debug(XFWAY_LOG_SCOPE_FOREIGN_TOPLEVEL,
+		"snapshot: %u toplevels in %ld ms\n",
+		snapshot->sent,
+		(now.tv_sec - snapshot->started.tv_sec) * 1000 +
+		(now.tv_nsec - snapshot->started.tv_nsec) / 1000000);
+
+	snapshot_destroy(snapshot);
+	return 0;
+}
+
 static void foreign_toplevel_manager_bind(struct wl_client *client, void *data,
 		uint32_t version, uint32_t id) {
 	struct wlr_foreign_toplevel_manager_v1 *manager = data;
@@ -559,13 +724,34 @@ static void foreign_toplevel_manager_bind(struct wl_client *client, void *data,
 
 	wl_list_insert(&manager->resources, wl_resource_get_link(resource));
 
-	struct wlr_foreign_toplevel_handle_v1 *toplevel, *tmp;
-	wl_list_for_each_safe(toplevel, tmp, &manager->toplevels, link) {
-		struct wl_resource *toplevel_resource =
-			create_toplevel_resource_for_resource(toplevel, resource);
-		toplevel_send_details_to_toplevel_resource(toplevel,
-			toplevel_resource);
+	if (wl_list_empty(&manager->toplevels)) {
+		return;
+	}
+
+	struct wlr_foreign_toplevel_snapshot_v1 *snapshot =
+		calloc(1, sizeof(struct wlr_foreign_toplevel_snapshot_v1));
+	if (!snapshot) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	// an idle source would be re-run within the same dispatch, a timer
+	// lets pending input and repaints through between chunks
+	snapshot->timer = wl_event_loop_add_timer(manager->event_loop,
+		snapshot_handle_timer, snapshot);
+	if (!snapshot->timer) {
+		free(snapshot);
+		wl_client_post_no_memory(client);
+		return;
 	}
+
+	snapshot->manager = manager;
+	snapshot->resource = resource;
+	snapshot->next = manager->toplevels.next;
+	clock_gettime(CLOCK_MONOTONIC, &snapshot->started);
+	wl_list_insert(&manager->snapshots, &snapshot->link);
+
+	snapshot_handle_timer(snapshot);
 }
 
 void wlr_foreign_toplevel_manager_v1_destroy(
@@ -584,27 +770,60 @@ void wlr_foreign_toplevel_manager_v1_destroy(
 		wl_resource_destroy(resource);
 	}
 
+	struct wlr_foreign_toplevel_snapshot_v1 *snapshot, *tmp_snapshot;
+	wl_list_for_each_safe(snapshot, tmp_snapshot, &manager->snapshots, link) {
+		snapshot_destroy(snapshot);
+	}
+
+	struct wlr_foreign_toplevel_title_stats *stats, *tmp_stats;
+	wl_list_for_each_safe(stats, tmp_stats, &manager->title_stats, link) {
+		wl_list_remove(&stats->link);
+		free(stats->app_id);
+		free(stats);
+	}
+
 	wlr_signal_emit_safe(&manager->events.destroy, manager);
 	wl_list_remove(&manager->display_destroy.link);
+	wl_list_remove(&manager->output_destroyed.link);
 
 	wl_global_destroy(manager->global);
 	free(manager);
 }
 
+void wlr_foreign_toplevel_manager_v1_set_title_interval(
+		struct wlr_foreign_toplevel_manager_v1 *manager, uint32_t interval_ms) {
+	manager->title_interval_ms = interval_ms;
+}
+
 static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_foreign_toplevel_manager_v1 *manager =
 		wl_container_of(listener, manager, display_destroy);
 	wlr_foreign_toplevel_manager_v1_destroy(manager);
 }
 
+static void handle_output_destroyed(struct wl_listener *listener,
+		void *data) {
+	struct wlr_foreign_toplevel_manager_v1 *manager =
+		wl_container_of(listener, manager, output_destroyed);
+	struct weston_output *output = data;
+
+	struct wlr_foreign_toplevel_handle_v1 *toplevel;
+	wl_list_for_each(toplevel, &manager->toplevels, link) {
+		wlr_foreign_toplevel_handle_v1_output_leave(toplevel, output);
+	}
+}
+
 struct wlr_foreign_toplevel_manager_v1 *wlr_foreign_toplevel_manager_v1_create(
-		struct wl_display *display) {
+		struct weston_compositor *compositor) {
+	struct wl_display *display = compositor->wl_display;
 	struct wlr_foreign_toplevel_manager_v1 *manager = calloc(1,
 			sizeof(struct wlr_foreign_toplevel_manager_v1));
 	if (!manager) {
 		return NULL;
 	}
 
+	manager->compositor = compositor;
+
 	manager->event_loop = wl_display_get_event_loop(display);
 	manager->global = wl_global_create(display,
 			&zwlr_foreign_toplevel_manager_v1_interface,
@@ -615,12 +834,19 @@ struct wlr_foreign_toplevel_manager_v1 *wlr_foreign_toplevel_manager_v1_create(
 		return NULL;
 	}
 
+	wl_signal_init(&manager->events.new_resource);
 	wl_signal_init(&manager->events.destroy);
 	wl_list_init(&manager->resources);
 	wl_list_init(&manager->toplevels);
+	wl_list_init(&manager->title_stats);
+	wl_list_init(&manager->snapshots);
 
 	manager->display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(display, &manager->display_destroy);
 
+	manager->output_destroyed.notify = handle_output_destroyed;
+	wl_signal_add(&compositor->output_destroyed_signal,
+		&manager->output_destroyed);
+
 	return manager;
 }
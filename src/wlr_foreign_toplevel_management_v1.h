@@ -9,24 +9,59 @@
 #ifndef WLR_TYPES_WLR_FOREIGN_TOPLEVEL_MANAGEMENT_V1_H
 #define WLR_TYPES_WLR_FOREIGN_TOPLEVEL_MANAGEMENT_V1_H
 
+#include <time.h>
 #include <wayland-server.h>
+#include <libweston/libweston.h>
 //#include <wlr/types/wlr_output.h>
 
 struct wlr_foreign_toplevel_manager_v1 {
+	struct weston_compositor *compositor;
 	struct wl_event_loop *event_loop;
 	struct wl_global *global;
 	struct wl_list resources;
 	struct wl_list toplevels; // wlr_foreign_toplevel_handle_v1::link
 
+	// minimum time between two title events of one toplevel, 0 disables
+	uint32_t title_interval_ms;
+	struct wl_list title_stats; // wlr_foreign_toplevel_title_stats::link
+	struct wl_list snapshots; // wlr_foreign_toplevel_snapshot_v1::link
+
 	struct wl_listener display_destroy;
+	struct wl_listener output_destroyed;
 
 	struct {
+		// wlr_foreign_toplevel_handle_v1_resource_event
+		struct wl_signal new_resource;
 		struct wl_signal destroy;
 	} events;
 
 	void *data;
 };
 
+/*
+ * Number of existing toplevels announced to a newly bound manager resource
+ * per event loop dispatch.
+ */
+#define WLR_FOREIGN_TOPLEVEL_SNAPSHOT_V1_CHUNK_SIZE 64
+
+// initial toplevel list still being sent to one manager resource
+struct wlr_foreign_toplevel_snapshot_v1 {
+	struct wl_list link; // wlr_foreign_toplevel_manager_v1::snapshots
+	struct wlr_foreign_toplevel_manager_v1 *manager;
+	struct wl_resource *resource;
+	struct wl_list *next; // next toplevel to send, or &manager->toplevels
+	struct wl_event_source *timer;
+	uint32_t sent;
+	struct timespec started;
+};
+
+// number of title changes held back by the rate limiter, per app_id
+struct wlr_foreign_toplevel_title_stats {
+	struct wl_list link; // wlr_foreign_toplevel_manager_v1::title_stats
+	char *app_id;
+	uint64_t suppressed;
+};
+
 enum wlr_foreign_toplevel_handle_v1_state {
 	WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED = (1 << 0),
 	WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED = (1 << 1),
@@ -34,13 +69,12 @@ enum wlr_foreign_toplevel_handle_v1_state {
 	WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN = (1 << 3),
 };
 
-/*struct wlr_foreign_toplevel_handle_v1_output {
-	struct wl_list link; // wlr_foreign_toplevel_handle_v1::outputs
-	struct wl_listener output_destroy;
-	struct wlr_output *output;
-
-	struct wlr_foreign_toplevel_handle_v1 *toplevel;
-};*/
+// fields changed since the last done event, flushed from the idle source
+enum wlr_foreign_toplevel_handle_v1_pending {
+	WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_TITLE = (1 << 0),
+	WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_APP_ID = (1 << 1),
+	WLR_FOREIGN_TOPLEVEL_HANDLE_V1_PENDING_STATE = (1 << 2),
+};
 
 struct wlr_foreign_toplevel_handle_v1 {
 	struct wlr_foreign_toplevel_manager_v1 *manager;
@@ -50,8 +84,17 @@ struct wlr_foreign_toplevel_handle_v1 {
 
 	char *title;
 	char *app_id;
-	struct wl_list outputs; // wlr_foreign_toplevel_v1_output
+	uint32_t output_mask; // one bit per weston_output::id
 	uint32_t state; // wlr_foreign_toplevel_v1_state
+	uint32_t pending; // wlr_foreign_toplevel_handle_v1_pending
+
+	// the latest title is sent when the timer fires
+	struct wl_event_source *title_timer;
+	bool title_deferred;
+	uint32_t title_sent_msec;
+	uint64_t title_suppressed;
+	// of the current app_id, found on the first title held back
+	struct wlr_foreign_toplevel_title_stats *title_stats;
 
 	struct {
 		// wlr_foreign_toplevel_handle_v1_maximized_event
@@ -66,12 +109,19 @@ struct wlr_foreign_toplevel_handle_v1 {
 
 		//wlr_foreign_toplevel_handle_v1_set_rectangle_event
 		struct wl_signal set_rectangle;
+		// emitted after a batch of changes was sent to clients
+		struct wl_signal done;
 		struct wl_signal destroy;
 	} events;
 
 	void *data;
 };
 
+struct wlr_foreign_toplevel_handle_v1_resource_event {
+	struct wlr_foreign_toplevel_handle_v1 *toplevel;
+	struct wl_resource *resource;
+};
+
 struct wlr_foreign_toplevel_handle_v1_maximized_event {
 	struct wlr_foreign_toplevel_handle_v1 *toplevel;
 	bool maximized;
@@ -100,10 +150,18 @@ struct wlr_foreign_toplevel_handle_v1_set_rectangle_event {
 };
 
 struct wlr_foreign_toplevel_manager_v1 *wlr_foreign_toplevel_manager_v1_create(
-	struct wl_display *display);
+	struct weston_compositor *compositor);
 void wlr_foreign_toplevel_manager_v1_destroy(
 	struct wlr_foreign_toplevel_manager_v1 *manager);
 
+/**
+ * Limits how often title events are sent for a single toplevel. Changes
+ * arriving faster than this are held back and only the latest one is sent
+ * once the interval has elapsed. An interval of 0 sends every change.
+ */
+void wlr_foreign_toplevel_manager_v1_set_title_interval(
+	struct wlr_foreign_toplevel_manager_v1 *manager, uint32_t interval_ms);
+
 struct wlr_foreign_toplevel_handle_v1 *wlr_foreign_toplevel_handle_v1_create(
 	struct wlr_foreign_toplevel_manager_v1 *manager);
 void wlr_foreign_toplevel_handle_v1_destroy(
@@ -114,10 +172,18 @@ void wlr_foreign_toplevel_handle_v1_set_title(
 void wlr_foreign_toplevel_handle_v1_set_app_id(
 	struct wlr_foreign_toplevel_handle_v1 *toplevel, const char *app_id);
 
-//void wlr_foreign_toplevel_handle_v1_output_enter(
-	//struct wlr_foreign_toplevel_handle_v1 *toplevel, struct wlr_output *output);
-//void wlr_foreign_toplevel_handle_v1_output_leave(
-	//struct wlr_foreign_toplevel_handle_v1 *toplevel, struct wlr_output *output);
+void wlr_foreign_toplevel_handle_v1_output_enter(
+	struct wlr_foreign_toplevel_handle_v1 *toplevel, struct weston_output *output);
+void wlr_foreign_toplevel_handle_v1_output_leave(
+	struct wlr_foreign_toplevel_handle_v1 *toplevel, struct weston_output *output);
+
+/**
+ * Sets the outputs the toplevel is shown on, as a mask of weston_output ids
+ * such as weston_view::output_mask. Only outputs whose bit changed get an
+ * output_enter or output_leave event.
+ */
+void wlr_foreign_toplevel_handle_v1_set_output_mask(
+	struct wlr_foreign_toplevel_handle_v1 *toplevel, uint32_t output_mask);
 
 void wlr_foreign_toplevel_handle_v1_set_maximized(
 	struct wlr_foreign_toplevel_handle_v1 *toplevel, bool maximized);
@@ -21,6 +21,8 @@
 #include <wayland-server.h>
 #include <libweston/libweston.h>
 #include "wlr_layer_shell_v1.h"
+#include "log.h"
+#include "trace.h"
 //#include <wlr/types/wlr_output.h>
 //#include <wlr/types/wlr_surface.h>
 //#include <wlr/types/wlr_xdg_shell.h>
@@ -135,44 +137,59 @@ struct wlr_layer_surface_v1 *wlr_layer_surface_v1_from_wlr_surface(
 	//return (struct wlr_layer_surface_v1 *)surface->role_data;
 }
 
-static void layer_surface_configure_destroy(
-		struct wlr_layer_surface_v1_configure *configure) {
-	if (configure == NULL) {
-		return;
-	}
-	wl_list_remove(&configure->link);
-	free(configure);
+static struct wlr_layer_surface_v1_configure *layer_surface_configure_at(
+		struct wlr_layer_surface_v1 *surface, unsigned int i) {
+	return &surface->configure_queue[(surface->configure_head + i) %
+		WLR_LAYER_SURFACE_V1_CONFIGURE_QUEUE_SIZE];
+}
+
+static void layer_surface_configure_pop(struct wlr_layer_surface_v1 *surface,
+		unsigned int n) {
+	assert(n <= surface->configure_count);
+	surface->configure_head = (surface->configure_head + n) %
+		WLR_LAYER_SURFACE_V1_CONFIGURE_QUEUE_SIZE;
+	surface->configure_count -= n;
+}
+
+static void layer_surface_configure_clear(
+		struct wlr_layer_surface_v1 *surface) {
+	surface->configure_head = 0;
+	surface->configure_count = 0;
+	surface->has_acked_configure = false;
 }
 
 static void layer_surface_handle_ack_configure(struct wl_client *client,
 		struct wl_resource *resource, uint32_t serial) {
 	struct wlr_layer_surface_v1 *surface = layer_surface_from_resource(resource);
 
-	bool found = false;
-	struct wlr_layer_surface_v1_configure *configure, *tmp;
-	wl_list_for_each_safe(configure, tmp, &surface->configure_list, link) {
-		if (configure->serial < serial) {
-			layer_surface_configure_destroy(configure);
-		} else if (configure->serial == serial) {
-			found = true;
-			break;
-		} else {
+	unsigned int i;
+	struct wlr_layer_surface_v1_configure *configure = NULL;
+	for (i = 0; i < surface->configure_count; i++) {
+		configure = layer_surface_configure_at(surface, i);
+		if (serial <= configure->serial) {
 			break;
 		}
 	}
-	if (!found) {
+	if (i == surface->configure_count || serial < configure->first_serial) {
 		wl_resource_post_error(resource,
 			ZWLR_LAYER_SURFACE_V1_ERROR_INVALID_SURFACE_STATE,
 			"wrong configure serial: %u", serial);
 		return;
 	}
 
-	if (surface->acked_configure) {
-		layer_surface_configure_destroy(surface->acked_configure);
+	// Everything sent before the acked configure is implicitly acked too
+	layer_surface_configure_pop(surface, i);
+	surface->shell->configures_acked++;
+
+	if (serial != configure->serial) {
+		// The client acked a size that has since been merged into a newer
+		// configure it has not seen yet; wait for it to ack that one.
+		return;
 	}
-	surface->acked_configure = configure;
-	wl_list_remove(&configure->link);
-	wl_list_init(&configure->link);
+
+	surface->acked_configure = *configure;
+	surface->has_acked_configure = true;
+	layer_surface_configure_pop(surface, 1);
 }
 
 static void layer_surface_handle_set_size(struct wl_client *client,
@@ -251,10 +268,7 @@ static void layer_surface_unmap(struct wlr_layer_surface_v1 *surface) {
 	// TODO: probably need to ungrab before this event
 	wlr_signal_emit_safe(&surface->events.unmap, surface);
 
-	struct wlr_layer_surface_v1_configure *configure, *tmp;
-	wl_list_for_each_safe(configure, tmp, &surface->configure_list, link) {
-		layer_surface_configure_destroy(configure);
-	}
+	layer_surface_configure_clear(surface);
 
 	surface->configured = surface->mapped = false;
 	surface->configure_serial = 0;
@@ -274,6 +288,11 @@ static void layer_surface_destroy(struct wlr_layer_surface_v1 *surface) {
 	surface->surface->role_name = NULL;
 	wl_list_remove(&surface->surface_destroy.link);
 	wl_list_remove(&surface->link);
+	xfway_client_accounting_add(surface->shell->xfwm_display->accounting,
+		wl_resource_get_client(surface->resource),
+		XFWAY_CLIENT_LAYER_SURFACES, -1);
+	xfway_client_accounting_add(surface->shell->xfwm_display->accounting,
+		wl_resource_get_client(surface->resource), XFWAY_CLIENT_VIEWS, -1);
   weston_view_damage_below (surface->view);
   weston_view_destroy (surface->view);
   weston_surface_unmap (surface->surface);
@@ -294,9 +313,9 @@ static void layer_surface_resource_destroy(struct wl_resource *resource) {
 
 static bool layer_surface_state_changed(struct wlr_layer_surface_v1 *surface) {
 	struct wlr_layer_surface_v1_state *state;
-	if (wl_list_empty(&surface->configure_list)) {
-		if (surface->acked_configure) {
-			state = &surface->acked_configure->state;
+	if (surface->configure_count == 0) {
+		if (surface->has_acked_configure) {
+			state = &surface->acked_configure.state;
 		} else if (!surface->configured) {
 			return true;
 		} else {
@@ -304,7 +323,7 @@ static bool layer_surface_state_changed(struct wlr_layer_surface_v1 *surface) {
 		}
 	} else {
 		struct wlr_layer_surface_v1_configure *configure =
-			wl_container_of(surface->configure_list.prev, configure, link);
+			layer_surface_configure_at(surface, surface->configure_count - 1);
 		state = &configure->state;
 	}
 
@@ -320,20 +339,25 @@ void wlr_layer_surface_v1_configure(struct wlr_layer_surface_v1 *surface,
 	if (layer_surface_state_changed(surface)) {
 		struct wl_display *display =
 			wl_client_get_display(wl_resource_get_client(surface->resource));
-		struct wlr_layer_surface_v1_configure *configure =
-			calloc(1, sizeof(struct wlr_layer_surface_v1_configure));
-		if (configure == NULL) {
-			wl_client_post_no_memory(wl_resource_get_client(surface->resource));
-			return;
-		}
+		struct wlr_layer_surface_v1_configure *configure;
 		surface->configure_next_serial = wl_display_next_serial(display);
-		wl_list_insert(surface->configure_list.prev, &configure->link);
+		if (surface->configure_count ==
+				WLR_LAYER_SURFACE_V1_CONFIGURE_QUEUE_SIZE) {
+			// Queue is full: fold this configure into the newest one
+			configure = layer_surface_configure_at(surface,
+				surface->configure_count - 1);
+		} else {
+			configure = layer_surface_configure_at(surface,
+				surface->configure_count++);
+			configure->first_serial = surface->configure_next_serial;
+		}
+		configure->serial = surface->configure_next_serial;
 		configure->state.actual_width = width;
 		configure->state.actual_height = height;
-		configure->serial = surface->configure_next_serial;
 		zwlr_layer_surface_v1_send_configure(surface->resource,
 				configure->serial, configure->state.actual_width,
 				configure->state.actual_height);
+		surface->shell->configures_sent++;
 	}
 }
 
@@ -351,10 +375,14 @@ static void layer_surface_role_commit(struct weston_surface *weston_surface,
                                       int32_t                sy) {
 	struct wlr_layer_surface_v1 *surface =
 		weston_surface->committed_private;
+	XFWAY_TRACE_FUNC();
 	if (surface == NULL) {
 		return;
 	}
 
+	xfway_debug_surface_committed(surface->shell->xfwm_display->debug,
+				      weston_surface);
+
   if (!weston_view_is_mapped (surface->view))
       {
         switch (surface->layer)
@@ -391,15 +419,14 @@ static void layer_surface_role_commit(struct weston_surface *weston_surface,
 		return;
 	}
 
-	if (surface->acked_configure) {
+	if (surface->has_acked_configure) {
 		struct wlr_layer_surface_v1_configure *configure =
-			surface->acked_configure;
+			&surface->acked_configure;
 		surface->configured = true;
 		surface->configure_serial = configure->serial;
 		surface->current.actual_width = configure->state.actual_width;
 		surface->current.actual_height = configure->state.actual_height;
-		layer_surface_configure_destroy(configure);
-		surface->acked_configure = NULL;
+		surface->has_acked_configure = false;
 	}
 
 	/*if (weston_view_is_mapped (surface->view) && !surface->configured) {
@@ -445,7 +472,7 @@ static void layer_surface_role_commit(struct weston_surface *weston_surface,
 			!surface->mapped) {
 		surface->mapped = true;
 		wlr_signal_emit_safe(&surface->events.map, surface);
-        weston_log ("map\n");
+        xfway_log_debug (XFWAY_LOG_SCOPE_LAYER_SHELL, "map %p\n", surface);
 	}
 	if (surface->configured && !weston_view_is_mapped (surface->view) &&
 			surface->mapped) {
@@ -531,7 +558,6 @@ static void layer_shell_handle_get_layer_surface(struct wl_client *wl_client,
 		return;
 	}
 
-	wl_list_init(&surface->configure_list);
 	wl_list_init(&surface->popups);
 
 	wl_signal_init(&surface->events.destroy);
@@ -543,11 +569,15 @@ static void layer_shell_handle_get_layer_surface(struct wl_client *wl_client,
 		&surface->surface_destroy);
 	surface->surface_destroy.notify = handle_surface_destroyed;
 
-	weston_log ("new layer_surface %p (res %p)",
+	xfway_log_debug(XFWAY_LOG_SCOPE_LAYER_SHELL, "new layer_surface %p (res %p)\n",
 			surface, surface->resource);
 	wl_resource_set_implementation(surface->resource,
 		&layer_surface_implementation, surface, layer_surface_resource_destroy);
 	wl_list_insert(&shell->surfaces, &surface->link);
+	xfway_client_accounting_add(shell->xfwm_display->accounting, wl_client,
+		XFWAY_CLIENT_LAYER_SURFACES, 1);
+	xfway_client_accounting_add(shell->xfwm_display->accounting, wl_client,
+		XFWAY_CLIENT_VIEWS, 1);
 }
 
 static const struct zwlr_layer_shell_v1_interface layer_shell_implementation = {
@@ -52,6 +52,10 @@ struct wlr_layer_shell_v1 {
 
   xfwmDisplay *xfwm_display;
 
+  /* for xfway_debug snapshots */
+  uint64_t configures_sent;
+  uint64_t configures_acked;
+
 	struct wl_listener display_destroy;
 
 	struct {
@@ -76,8 +80,17 @@ struct wlr_layer_surface_v1_state {
 	uint32_t actual_width, actual_height;
 };
 
+/*
+ * Number of configures that may be outstanding at once. When the client
+ * falls further behind than this, the newest pending entry is updated in
+ * place instead of queueing another one, so intermediate sizes of a fast
+ * resize are never stored.
+ */
+#define WLR_LAYER_SURFACE_V1_CONFIGURE_QUEUE_SIZE 8
+
 struct wlr_layer_surface_v1_configure {
-	struct wl_list link; // wlr_layer_surface_v1::configure_list
+	// serials in [first_serial, serial] were merged into this entry
+	uint32_t first_serial;
 	uint32_t serial;
 	struct wlr_layer_surface_v1_state state;
 };
@@ -99,9 +112,14 @@ struct wlr_layer_surface_v1 {
 	uint32_t configure_serial;
 	struct wl_event_source *configure_idle;
 	uint32_t configure_next_serial;
-	struct wl_list configure_list;
 
-	struct wlr_layer_surface_v1_configure *acked_configure;
+	// ring of configures sent but not yet acked, oldest at configure_head
+	struct wlr_layer_surface_v1_configure
+		configure_queue[WLR_LAYER_SURFACE_V1_CONFIGURE_QUEUE_SIZE];
+	unsigned int configure_head, configure_count;
+
+	struct wlr_layer_surface_v1_configure acked_configure;
+	bool has_acked_configure;
 
 	struct wlr_layer_surface_v1_state client_pending;
 	struct wlr_layer_surface_v1_state server_pending;
@@ -0,0 +1,394 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "worker-pool.h"
+#include "trace.h"
+
+#define MAX_THREADS 4
+
+struct xfway_job
+{
+  struct xfway_worker_pool *pool;
+  xfway_job_func_t func;
+  xfway_job_done_func_t done;
+  void *data;
+
+  /* set by the compositor thread, read by the worker */
+  int cancelled;
+
+  uint64_t submit_us;
+
+  /* the submission queue, then the completed list */
+  struct xfway_job *next;
+
+  struct wl_listener owner_destroy_listener;
+  bool has_owner;
+};
+
+struct xfway_worker_pool
+{
+  pthread_t *threads;
+  int n_threads;
+
+  /* submission queue, workers sleep on cond while it is empty */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  struct xfway_job *queue_head;
+  struct xfway_job *queue_tail;
+  bool shutdown;
+
+  /* Lock-free LIFO of finished jobs: workers push with a compare and
+   * swap, the compositor thread takes the whole list at once. Only the
+   * push onto an empty list writes to event_fd. */
+  struct xfway_job *completed;
+  int event_fd;
+  struct wl_event_source *event_source;
+
+  /* the wait and run fields are updated by workers with atomics, the
+   * queue depths under mutex and the rest by the compositor thread */
+  struct xfway_worker_pool_stats stats;
+};
+
+static uint64_t
+now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+atomic_max (uint64_t *max,
+            uint64_t  value)
+{
+  uint64_t current = __atomic_load_n (max, __ATOMIC_RELAXED);
+
+  while (value > current &&
+         !__atomic_compare_exchange_n (max, &current, value, true,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+static void
+push_completed (struct xfway_worker_pool *pool,
+                struct xfway_job         *job)
+{
+  struct xfway_job *head = __atomic_load_n (&pool->completed, __ATOMIC_RELAXED);
+  uint64_t one = 1;
+
+  do
+    job->next = head;
+  while (!__atomic_compare_exchange_n (&pool->completed, &head, job, true,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  if (head == NULL)
+    {
+      while (write (pool->event_fd, &one, sizeof one) < 0 && errno == EINTR)
+        ;
+    }
+}
+
+static void *
+worker_main (void *data)
+{
+  struct xfway_worker_pool *pool = data;
+  struct xfway_job *job;
+  uint64_t start, end;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&pool->mutex);
+      while (pool->queue_head == NULL && !pool->shutdown)
+        pthread_cond_wait (&pool->cond, &pool->mutex);
+      job = pool->queue_head;
+      if (job == NULL)
+        {
+          pthread_mutex_unlock (&pool->mutex);
+          break;
+        }
+      pool->queue_head = job->next;
+      if (pool->queue_head == NULL)
+        pool->queue_tail = NULL;
+      pool->stats.queue_depth--;
+      pthread_mutex_unlock (&pool->mutex);
+
+      start = now_us ();
+      if (!__atomic_load_n (&job->cancelled, __ATOMIC_ACQUIRE))
+        {
+          XFWAY_TRACE_SPAN ("worker job");
+          job->func (job->data);
+        }
+      end = now_us ();
+
+      __atomic_fetch_add (&pool->stats.total_wait_us, start - job->submit_us, __ATOMIC_RELAXED);
+      atomic_max (&pool->stats.max_wait_us, start - job->submit_us);
+      __atomic_fetch_add (&pool->stats.total_run_us, end - start, __ATOMIC_RELAXED);
+      atomic_max (&pool->stats.max_run_us, end - start);
+
+      push_completed (pool, job);
+    }
+
+  return NULL;
+}
+
+static void
+job_remove_owner (struct xfway_job *job)
+{
+  if (!job->has_owner)
+    return;
+
+  wl_list_remove (&job->owner_destroy_listener.link);
+  job->has_owner = false;
+}
+
+/* Runs the done callbacks of the jobs finished so far, oldest first */
+static void
+dispatch_completed (struct xfway_worker_pool *pool)
+{
+  struct xfway_job *list, *reversed = NULL, *job;
+  uint64_t latency;
+  bool cancelled;
+
+  list = __atomic_exchange_n (&pool->completed, NULL, __ATOMIC_ACQUIRE);
+  while (list)
+    {
+      job = list;
+      list = job->next;
+      job->next = reversed;
+      reversed = job;
+    }
+
+  while (reversed)
+    {
+      job = reversed;
+      reversed = job->next;
+
+      job_remove_owner (job);
+      cancelled = __atomic_load_n (&job->cancelled, __ATOMIC_RELAXED);
+
+      latency = now_us () - job->submit_us;
+      pool->stats.total_latency_us += latency;
+      if (latency > pool->stats.max_latency_us)
+        pool->stats.max_latency_us = latency;
+      if (cancelled)
+        pool->stats.cancelled++;
+      else
+        pool->stats.completed++;
+
+      job->done (job->data, cancelled);
+      free (job);
+    }
+}
+
+static int
+handle_event_fd (int       fd,
+                 uint32_t  mask,
+                 void     *data)
+{
+  struct xfway_worker_pool *pool = data;
+  uint64_t count;
+
+  /* cleared before taking the list, so a push after that wakes us again */
+  while (read (fd, &count, sizeof count) < 0 && errno == EINTR)
+    ;
+  dispatch_completed (pool);
+
+  return 0;
+}
+
+struct xfway_worker_pool *
+xfway_worker_pool_create (struct wl_event_loop *loop,
+                          int                   n_threads)
+{
+  struct xfway_worker_pool *pool;
+  sigset_t all, saved;
+  long n_cpus;
+  int i;
+
+  if (n_threads <= 0)
+    {
+      n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+      n_threads = n_cpus > 2 ? n_cpus - 1 : 1;
+      if (n_threads > MAX_THREADS)
+        n_threads = MAX_THREADS;
+    }
+
+  pool = calloc (1, sizeof *pool);
+  if (pool == NULL)
+    return NULL;
+
+  pool->event_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  pool->threads = calloc (n_threads, sizeof (pthread_t));
+  if (pool->threads == NULL || pool->event_fd < 0)
+    goto err;
+
+  pool->event_source = wl_event_loop_add_fd (loop, pool->event_fd, WL_EVENT_READABLE,
+                                             handle_event_fd, pool);
+  if (pool->event_source == NULL)
+    goto err;
+
+  pthread_mutex_init (&pool->mutex, NULL);
+  pthread_cond_init (&pool->cond, NULL);
+
+  /* signals are for the compositor thread, the workers inherit this mask */
+  sigfillset (&all);
+  pthread_sigmask (SIG_BLOCK, &all, &saved);
+  for (i = 0; i < n_threads; i++)
+    {
+      if (pthread_create (&pool->threads[i], NULL, worker_main, pool) != 0)
+        break;
+      pool->n_threads++;
+    }
+  pthread_sigmask (SIG_SETMASK, &saved, NULL);
+
+  if (pool->n_threads == 0)
+    {
+      xfway_worker_pool_destroy (pool);
+      return NULL;
+    }
+
+  return pool;
+
+err:
+  if (pool->event_fd >= 0)
+    close (pool->event_fd);
+  free (pool->threads);
+  free (pool);
+  return NULL;
+}
+
+void
+xfway_worker_pool_destroy (struct xfway_worker_pool *pool)
+{
+  struct xfway_job *job;
+  int i;
+
+  if (pool == NULL)
+    return;
+
+  /* the workers skip what is left and finish */
+  pthread_mutex_lock (&pool->mutex);
+  for (job = pool->queue_head; job; job = job->next)
+    __atomic_store_n (&job->cancelled, 1, __ATOMIC_RELEASE);
+  pool->shutdown = true;
+  pthread_cond_broadcast (&pool->cond);
+  pthread_mutex_unlock (&pool->mutex);
+
+  for (i = 0; i < pool->n_threads; i++)
+    pthread_join (pool->threads[i], NULL);
+
+  dispatch_completed (pool);
+
+  wl_event_source_remove (pool->event_source);
+  close (pool->event_fd);
+  pthread_cond_destroy (&pool->cond);
+  pthread_mutex_destroy (&pool->mutex);
+  free (pool->threads);
+  free (pool);
+}
+
+struct xfway_job *
+xfway_worker_pool_submit (struct xfway_worker_pool *pool,
+                          xfway_job_func_t          func,
+                          xfway_job_done_func_t     done,
+                          void                     *data)
+{
+  struct xfway_job *job;
+
+  job = calloc (1, sizeof *job);
+  if (job == NULL)
+    return NULL;
+
+  job->pool = pool;
+  job->func = func;
+  job->done = done;
+  job->data = data;
+  job->submit_us = now_us ();
+
+  pthread_mutex_lock (&pool->mutex);
+  if (pool->queue_tail)
+    pool->queue_tail->next = job;
+  else
+    pool->queue_head = job;
+  pool->queue_tail = job;
+  pool->stats.queue_depth++;
+  if (pool->stats.queue_depth > pool->stats.max_queue_depth)
+    pool->stats.max_queue_depth = pool->stats.queue_depth;
+  pthread_cond_signal (&pool->cond);
+  pthread_mutex_unlock (&pool->mutex);
+
+  pool->stats.submitted++;
+
+  return job;
+}
+
+void
+xfway_job_cancel (struct xfway_job *job)
+{
+  __atomic_store_n (&job->cancelled, 1, __ATOMIC_RELEASE);
+  job_remove_owner (job);
+}
+
+static void
+handle_owner_destroy (struct wl_listener *listener,
+                      void               *data)
+{
+  struct xfway_job *job = wl_container_of (listener, job, owner_destroy_listener);
+
+  xfway_job_cancel (job);
+}
+
+void
+xfway_job_cancel_on_signal (struct xfway_job *job,
+                            struct wl_signal *destroy_signal)
+{
+  job_remove_owner (job);
+  job->owner_destroy_listener.notify = handle_owner_destroy;
+  wl_signal_add (destroy_signal, &job->owner_destroy_listener);
+  job->has_owner = true;
+}
+
+void
+xfway_worker_pool_get_stats (struct xfway_worker_pool       *pool,
+                             struct xfway_worker_pool_stats *stats)
+{
+  stats->submitted = pool->stats.submitted;
+  stats->completed = pool->stats.completed;
+  stats->cancelled = pool->stats.cancelled;
+  stats->total_latency_us = pool->stats.total_latency_us;
+  stats->max_latency_us = pool->stats.max_latency_us;
+
+  pthread_mutex_lock (&pool->mutex);
+  stats->queue_depth = pool->stats.queue_depth;
+  stats->max_queue_depth = pool->stats.max_queue_depth;
+  pthread_mutex_unlock (&pool->mutex);
+
+  stats->total_wait_us = __atomic_load_n (&pool->stats.total_wait_us, __ATOMIC_RELAXED);
+  stats->max_wait_us = __atomic_load_n (&pool->stats.max_wait_us, __ATOMIC_RELAXED);
+  stats->total_run_us = __atomic_load_n (&pool->stats.total_run_us, __ATOMIC_RELAXED);
+  stats->max_run_us = __atomic_load_n (&pool->stats.max_run_us, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,86 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server.h>
+
+struct xfway_worker_pool;
+struct xfway_job;
+
+/* Runs on a worker thread, must not touch compositor state */
+typedef void (*xfway_job_func_t) (void *data);
+
+/* Runs on the compositor thread once the job is over. When cancelled is
+ * true func may or may not have run and whatever the job was for may be
+ * gone: only data should be touched. */
+typedef void (*xfway_job_done_func_t) (void *data, bool cancelled);
+
+struct xfway_worker_pool_stats
+{
+  uint64_t submitted;
+  uint64_t completed;
+  uint64_t cancelled;
+  /* jobs waiting for a worker */
+  uint32_t queue_depth;
+  uint32_t max_queue_depth;
+  /* from submission to a worker picking the job up */
+  uint64_t total_wait_us;
+  uint64_t max_wait_us;
+  /* in func */
+  uint64_t total_run_us;
+  uint64_t max_run_us;
+  /* from submission to done */
+  uint64_t total_latency_us;
+  uint64_t max_latency_us;
+};
+
+/* Worker threads for CPU bound or blocking work, so it never holds up
+ * input or repaint. Finished jobs are handed back on a lock-free list
+ * and an eventfd wakes loop up to run their done callbacks.
+ *
+ * n_threads of 0 picks one per CPU but one, at most 4. Everything but the
+ * job functions must be called from the compositor thread. */
+struct xfway_worker_pool *xfway_worker_pool_create (struct wl_event_loop *loop,
+                                                    int                   n_threads);
+
+/* Cancels the queued jobs and waits for the running ones, every done
+ * callback has run when it returns. */
+void xfway_worker_pool_destroy (struct xfway_worker_pool *pool);
+
+/* The job is valid until done has run. Returns NULL if it could not be
+ * queued, func and done are not called then. */
+struct xfway_job *xfway_worker_pool_submit (struct xfway_worker_pool *pool,
+                                            xfway_job_func_t          func,
+                                            xfway_job_done_func_t     done,
+                                            void                     *data);
+
+/* func is skipped if it has not started; done runs with cancelled set
+ * either way. */
+void xfway_job_cancel (struct xfway_job *job);
+
+/* Cancels job when destroy_signal is emitted, such as the destroy_signal
+ * of the surface the job works for. */
+void xfway_job_cancel_on_signal (struct xfway_job *job,
+                                 struct wl_signal *destroy_signal);
+
+void xfway_worker_pool_get_stats (struct xfway_worker_pool       *pool,
+                                  struct xfway_worker_pool_stats *stats);
+
+#endif /* __WORKER_POOL_H__ */
@@ -0,0 +1,289 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Prints the compositor's counters from the xfway_debug global, once, or
+ * every interval seconds as rates:
+ *
+ *   xfconf-query -c xfway -p /debug/debug-protocol -n -t bool -s true
+ *   xfway-debug [-i seconds] [filter]
+ *
+ * filter keeps the counters whose object contains it. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <protocol/xfway-debug-client-protocol.h>
+
+struct counter
+{
+  char *object;
+  char *name;
+  uint64_t value;
+};
+
+struct snapshot
+{
+  struct counter *counters;
+  size_t n_counters;
+  size_t size;
+  uint64_t time_ms;
+  int done;
+};
+
+static struct xfway_debug *debug;
+
+static void
+registry_global (void               *data,
+                 struct wl_registry *registry,
+                 uint32_t            name,
+                 const char         *interface,
+                 uint32_t            version)
+{
+  if (strcmp (interface, xfway_debug_interface.name) == 0)
+    debug = wl_registry_bind (registry, name, &xfway_debug_interface, 1);
+}
+
+static void
+registry_global_remove (void               *data,
+                        struct wl_registry *registry,
+                        uint32_t            name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+  .global = registry_global,
+  .global_remove = registry_global_remove,
+};
+
+static void
+snapshot_counter (void                        *data,
+                  struct xfway_debug_snapshot *xfway_debug_snapshot,
+                  const char                  *object,
+                  const char                  *name,
+                  uint32_t                     value_hi,
+                  uint32_t                     value_lo)
+{
+  struct snapshot *snapshot = data;
+  struct counter *counter;
+
+  if (snapshot->n_counters == snapshot->size)
+    {
+      snapshot->size = snapshot->size ? snapshot->size * 2 : 64;
+      snapshot->counters = realloc (snapshot->counters,
+                                    snapshot->size * sizeof (struct counter));
+      if (snapshot->counters == NULL)
+        {
+          fprintf (stderr, "xfway-debug: out of memory\n");
+          exit (1);
+        }
+    }
+
+  counter = &snapshot->counters[snapshot->n_counters++];
+  counter->object = strdup (object);
+  counter->name = strdup (name);
+  counter->value = (uint64_t) value_hi << 32 | value_lo;
+}
+
+static void
+snapshot_done (void                        *data,
+               struct xfway_debug_snapshot *xfway_debug_snapshot,
+               uint32_t                     time_hi,
+               uint32_t                     time_lo)
+{
+  struct snapshot *snapshot = data;
+
+  snapshot->time_ms = (uint64_t) time_hi << 32 | time_lo;
+  snapshot->done = 1;
+  xfway_debug_snapshot_destroy (xfway_debug_snapshot);
+}
+
+static const struct xfway_debug_snapshot_listener snapshot_listener = {
+  .counter = snapshot_counter,
+  .done = snapshot_done,
+};
+
+static void
+snapshot_clear (struct snapshot *snapshot)
+{
+  size_t i;
+
+  for (i = 0; i < snapshot->n_counters; i++)
+    {
+      free (snapshot->counters[i].object);
+      free (snapshot->counters[i].name);
+    }
+  snapshot->n_counters = 0;
+  snapshot->done = 0;
+}
+
+static int
+snapshot_take (struct wl_display *display,
+               struct snapshot   *snapshot)
+{
+  struct xfway_debug_snapshot *proxy;
+
+  snapshot_clear (snapshot);
+
+  proxy = xfway_debug_get_counters (debug);
+  xfway_debug_snapshot_add_listener (proxy, &snapshot_listener, snapshot);
+
+  while (!snapshot->done)
+    {
+      if (wl_display_dispatch (display) < 0)
+        return -1;
+    }
+
+  return 0;
+}
+
+/* Snapshots list the counters in the same order unless an object came or
+ * went, so the previous value is usually at the same index */
+static const struct counter *
+snapshot_find (const struct snapshot *snapshot,
+               const struct counter  *counter,
+               size_t                 hint)
+{
+  size_t i;
+
+  if (hint < snapshot->n_counters &&
+      strcmp (snapshot->counters[hint].object, counter->object) == 0 &&
+      strcmp (snapshot->counters[hint].name, counter->name) == 0)
+    return &snapshot->counters[hint];
+
+  for (i = 0; i < snapshot->n_counters; i++)
+    {
+      if (strcmp (snapshot->counters[i].object, counter->object) == 0 &&
+          strcmp (snapshot->counters[i].name, counter->name) == 0)
+        return &snapshot->counters[i];
+    }
+
+  return NULL;
+}
+
+static void
+snapshot_print (const struct snapshot *snapshot,
+                const struct snapshot *previous,
+                const char            *filter)
+{
+  const struct counter *counter, *prev;
+  double seconds = 0;
+  size_t i;
+
+  if (previous)
+    seconds = (snapshot->time_ms - previous->time_ms) / 1000.0;
+
+  for (i = 0; i < snapshot->n_counters; i++)
+    {
+      counter = &snapshot->counters[i];
+      if (filter && strstr (counter->object, filter) == NULL)
+        continue;
+
+      printf ("%-32s %-20s %12llu", counter->object, counter->name,
+              (unsigned long long) counter->value);
+
+      prev = previous ? snapshot_find (previous, counter, i) : NULL;
+      if (prev && seconds > 0 && counter->value >= prev->value)
+        printf (" %12.1f/s", (counter->value - prev->value) / seconds);
+
+      putchar ('\n');
+    }
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "usage: %s [-i seconds] [filter]\n", name);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  struct wl_display *display;
+  struct wl_registry *registry;
+  struct snapshot snapshots[2] = { { 0 }, { 0 } };
+  struct snapshot *current, *previous = NULL;
+  const char *filter = NULL;
+  unsigned int interval = 0;
+  int opt, n = 0;
+
+  while ((opt = getopt (argc, argv, "i:h")) != -1)
+    {
+      switch (opt)
+        {
+        case 'i':
+          interval = atoi (optarg);
+          break;
+        default:
+          usage (argv[0]);
+          return opt == 'h' ? 0 : 1;
+        }
+    }
+  if (optind < argc)
+    filter = argv[optind];
+
+  display = wl_display_connect (NULL);
+  if (display == NULL)
+    {
+      fprintf (stderr, "xfway-debug: cannot connect to the Wayland display\n");
+      return 1;
+    }
+
+  registry = wl_display_get_registry (display);
+  wl_registry_add_listener (registry, &registry_listener, NULL);
+  wl_display_roundtrip (display);
+
+  if (debug == NULL)
+    {
+      fprintf (stderr, "xfway-debug: the compositor has no xfway_debug global, "
+               "set /debug/debug-protocol in the xfway channel\n");
+      return 1;
+    }
+
+  for (;;)
+    {
+      current = &snapshots[n++ & 1];
+      if (snapshot_take (display, current) < 0)
+        {
+          fprintf (stderr, "xfway-debug: lost the connection to the compositor\n");
+          return 1;
+        }
+
+      if (previous)
+        putchar ('\n');
+      snapshot_print (current, previous, filter);
+      fflush (stdout);
+
+      if (interval == 0)
+        break;
+
+      previous = current;
+      sleep (interval);
+    }
+
+  snapshot_clear (&snapshots[0]);
+  snapshot_clear (&snapshots[1]);
+  free (snapshots[0].counters);
+  free (snapshots[1].counters);
+  xfway_debug_destroy (debug);
+  wl_registry_destroy (registry);
+  wl_display_disconnect (display);
+
+  return 0;
+}
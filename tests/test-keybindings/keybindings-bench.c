@@ -0,0 +1,249 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Times the compositor's key to action lookup with N shortcuts bound:
+ * compiling them from their accelerators, looking up key presses that hit
+ * and miss, and rebinding one of them as a change in the xfconf channel
+ * does. The same lookups done by walking a list of bindings, as weston
+ * does with its own, are timed for comparison.
+ * Usage: test-keybindings [bindings] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "keybindings.h"
+
+#define LOOKUPS 1000000
+
+static const char *key_names[] =
+{
+  "Tab", "Return", "Escape", "space", "BackSpace", "Delete", "Insert",
+  "Home", "End", "Page_Up", "Page_Down", "Left", "Right", "Up", "Down",
+  "Print", "Pause", "Menu",
+};
+
+struct shortcut
+{
+  char accelerator[64];
+  xkb_keysym_t keysym;
+  uint32_t modifiers;
+  enum xfway_action action;
+};
+
+static double
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+accelerator_for (char *buf, size_t size, uint32_t modifiers, const char *key)
+{
+  snprintf (buf, size, "%s%s%s%s%s",
+            modifiers & XFWAY_MODIFIER_CTRL ? "<Primary>" : "",
+            modifiers & XFWAY_MODIFIER_SHIFT ? "<Shift>" : "",
+            modifiers & XFWAY_MODIFIER_ALT ? "<Alt>" : "",
+            modifiers & XFWAY_MODIFIER_SUPER ? "<Super>" : "",
+            key);
+}
+
+/* n distinct shortcuts over letters, digits, function and named keys,
+ * with every set of modifiers */
+static struct shortcut *
+make_shortcuts (unsigned n)
+{
+  struct shortcut *shortcuts = calloc (n, sizeof (struct shortcut));
+  unsigned n_keys = 26 + 10 + 24 + sizeof (key_names) / sizeof (key_names[0]);
+  unsigned i, k;
+  char key[16];
+
+  for (i = 0; i < n; i++)
+    {
+      k = i % n_keys;
+      if (k < 26)
+        snprintf (key, sizeof (key), "%c", 'a' + k);
+      else if (k < 36)
+        snprintf (key, sizeof (key), "%c", '0' + k - 26);
+      else if (k < 60)
+        snprintf (key, sizeof (key), "F%u", k - 36 + 1);
+      else
+        snprintf (key, sizeof (key), "%s", key_names[k - 60]);
+
+      accelerator_for (shortcuts[i].accelerator, sizeof (shortcuts[i].accelerator),
+                       (i / n_keys) % 16, key);
+      shortcuts[i].action = 1 + i % (XFWAY_ACTION_COUNT - 1);
+    }
+
+  return shortcuts;
+}
+
+static void
+bench_table (const struct shortcut *shortcuts, unsigned n, unsigned *order)
+{
+  struct xfway_keybindings keybindings;
+  struct shortcut *parsed = calloc (n, sizeof (struct shortcut));
+  double start, compiled, hit, missed, rebound;
+  enum xfway_action action;
+  unsigned i, found = 0;
+
+  xfway_keybindings_init (&keybindings);
+
+  start = now_ns ();
+  for (i = 0; i < n; i++)
+    {
+      parsed[i] = shortcuts[i];
+      if (!xfway_keybindings_parse (shortcuts[i].accelerator,
+                                    &parsed[i].keysym, &parsed[i].modifiers))
+        {
+          fprintf (stderr, "cannot parse %s\n", shortcuts[i].accelerator);
+          exit (1);
+        }
+      xfway_keybindings_set (&keybindings, parsed[i].keysym,
+                             parsed[i].modifiers, parsed[i].action);
+    }
+  compiled = now_ns ();
+
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      const struct shortcut *s = &parsed[order[i % n]];
+
+      found += xfway_keybindings_lookup (&keybindings, s->keysym, s->modifiers) == s->action;
+    }
+  hit = now_ns ();
+
+  /* the same keys with the hyper bit, bound to nothing */
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      const struct shortcut *s = &parsed[order[i % n]];
+
+      found += xfway_keybindings_lookup (&keybindings, s->keysym, s->modifiers | (1 << 7)) != XFWAY_ACTION_NONE;
+    }
+  missed = now_ns ();
+
+  /* what a change of /shortcuts/<accelerator> does */
+  for (i = 0; i < n; i++)
+    {
+      action = xfway_keybindings_set (&keybindings, parsed[i].keysym,
+                                      parsed[i].modifiers, XFWAY_ACTION_NONE);
+      xfway_keybindings_set (&keybindings, parsed[i].keysym, parsed[i].modifiers, action);
+    }
+  rebound = now_ns ();
+
+  if (found != LOOKUPS || keybindings.n_bindings != n)
+    {
+      fprintf (stderr, "lookup mismatch: %u of %u found, %u bound\n",
+               found, LOOKUPS, keybindings.n_bindings);
+      exit (1);
+    }
+
+  printf ("table: compile %.3f ms, hit %.1f ns, miss %.1f ns, rebind one %.1f ns\n",
+          (compiled - start) / 1e6, (hit - compiled) / LOOKUPS,
+          (missed - hit) / LOOKUPS, (rebound - missed) / n);
+
+  xfway_keybindings_release (&keybindings);
+  free (parsed);
+}
+
+static void
+bench_list (const struct shortcut *shortcuts, unsigned n, unsigned *order)
+{
+  struct shortcut *parsed = calloc (n, sizeof (struct shortcut));
+  double start, hit;
+  unsigned i, j, found = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      parsed[i] = shortcuts[i];
+      xfway_keybindings_parse (shortcuts[i].accelerator,
+                               &parsed[i].keysym, &parsed[i].modifiers);
+    }
+
+  start = now_ns ();
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      const struct shortcut *s = &parsed[order[i % n]];
+
+      for (j = 0; j < n; j++)
+        {
+          if (parsed[j].keysym == s->keysym && parsed[j].modifiers == s->modifiers)
+            {
+              found += parsed[j].action == s->action;
+              break;
+            }
+        }
+    }
+  hit = now_ns ();
+
+  if (found != LOOKUPS)
+    {
+      fprintf (stderr, "list mismatch: %u of %u found\n", found, LOOKUPS);
+      exit (1);
+    }
+
+  printf ("list:  hit %.1f ns\n", (hit - start) / LOOKUPS);
+
+  free (parsed);
+}
+
+int
+main (int argc, char *argv[])
+{
+  unsigned sizes[] = { 100, 500, 1000 };
+  unsigned n_sizes = 3;
+  unsigned s, i, j, n, tmp;
+  struct shortcut *shortcuts;
+  unsigned *order;
+
+  if (argc > 1)
+    {
+      sizes[0] = atoi (argv[1]);
+      n_sizes = 1;
+      if (sizes[0] == 0)
+        return 1;
+    }
+
+  srand (1);
+  for (s = 0; s < n_sizes; s++)
+    {
+      n = sizes[s];
+      shortcuts = make_shortcuts (n);
+
+      order = malloc (n * sizeof (unsigned));
+      for (i = 0; i < n; i++)
+        order[i] = i;
+      for (i = n - 1; i > 0; i--)
+        {
+          j = rand () % (i + 1);
+          tmp = order[i];
+          order[i] = order[j];
+          order[j] = tmp;
+        }
+
+      printf ("%u bindings\n", n);
+      bench_table (shortcuts, n, order);
+      bench_list (shortcuts, n, order);
+
+      free (order);
+      free (shortcuts);
+    }
+
+  return 0;
+}
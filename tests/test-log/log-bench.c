@@ -0,0 +1,136 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Times what logging costs the thread that logs, through the ring and
+ * written synchronously as weston_log used to be. The sink is a pipe on
+ * stderr read by a thread that takes sleep_us after every read, standing in for
+ * a slow journald or serial console; 0 reads as fast as it can. For the
+ * ring, messages dropped because the reader fell behind are reported.
+ * Usage: test-log [messages] [sleep_us] */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "log.h"
+
+struct sink
+{
+  int fds[2];
+  unsigned sleep_us;
+  pthread_t reader;
+};
+
+static double
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void *
+reader_thread (void *data)
+{
+  struct sink *sink = data;
+  char buf[4096];
+
+  while (read (sink->fds[0], buf, sizeof (buf)) > 0)
+    if (sink->sleep_us)
+      usleep (sink->sleep_us);
+
+  return NULL;
+}
+
+static void
+sink_open (struct sink *sink, unsigned sleep_us)
+{
+  if (pipe (sink->fds) < 0)
+    {
+      perror ("pipe");
+      exit (EXIT_FAILURE);
+    }
+  sink->sleep_us = sleep_us;
+  pthread_create (&sink->reader, NULL, reader_thread, sink);
+}
+
+static void
+sink_close (struct sink *sink)
+{
+  close (sink->fds[1]);
+  pthread_join (sink->reader, NULL);
+  close (sink->fds[0]);
+}
+
+static void
+run (const char *name, unsigned n, unsigned sleep_us, bool ring)
+{
+  struct sink sink;
+  double start, t, worst = 0;
+  uint64_t dropped;
+  unsigned i;
+  int saved_stderr;
+
+  sink_open (&sink, sleep_us);
+  saved_stderr = dup (STDERR_FILENO);
+  dup2 (sink.fds[1], STDERR_FILENO);
+  if (ring)
+    xfway_log_init (STDERR_FILENO);
+  dropped = xfway_log_get_dropped ();
+
+  /* ring or not, xfway_log_write is the path weston_log takes */
+  start = now_ns ();
+  for (i = 0; i < n; i++)
+    {
+      t = now_ns ();
+      xfway_log_write (XFWAY_LOG_SCOPE_CORE, XFWAY_LOG_INFO,
+                       "message %u of %u from the compositor thread\n", i, n);
+      t = now_ns () - t;
+      if (t > worst)
+        worst = t;
+    }
+  t = now_ns () - start;
+
+  if (ring)
+    xfway_log_shutdown ();
+  dup2 (saved_stderr, STDERR_FILENO);
+  close (saved_stderr);
+  sink_close (&sink);
+
+  printf ("%-12s %8.1f ns/message, worst %9.1f us, %llu dropped\n",
+          name, t / n, worst / 1000,
+          (unsigned long long) (xfway_log_get_dropped () - dropped));
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned n = argc > 1 ? strtoul (argv[1], NULL, 10) : 100000;
+  unsigned sleep_us = argc > 2 ? strtoul (argv[2], NULL, 10) : 100;
+
+  if (n == 0)
+    return EXIT_FAILURE;
+
+  printf ("%u messages, reader sleeps %u us per read\n", n, sleep_us);
+
+  run ("synchronous", n, sleep_us, false);
+  run ("ring", n, sleep_us, true);
+
+  return EXIT_SUCCESS;
+}
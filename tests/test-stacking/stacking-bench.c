@@ -0,0 +1,157 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Times the shell client's window lists through a session restore and a
+ * mass close: frame N clients, activate them in random order, then unframe
+ * them in random order. The same work done with g_list_append and
+ * g_list_remove, as the lists used to be kept, is timed for comparison.
+ * Usage: test-stacking [clients] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "screen.h"
+#include "client.h"
+#include "stacking.h"
+
+static void
+shuffle (guint *order, guint n, GRand *rand)
+{
+  guint i, j, tmp;
+
+  for (i = 0; i < n; i++)
+    order[i] = i;
+  for (i = n - 1; i > 0; i--)
+    {
+      j = g_rand_int_range (rand, 0, i + 1);
+      tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+}
+
+static void
+bench_stacking (guint n, const guint *activate, const guint *close)
+{
+  ScreenInfo *screen_info = myScreenInit (NULL);
+  Client **clients = g_new (Client *, n);
+  gint64 start, framed, activated, closed;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n; i++)
+    {
+      clients[i] = clientFrame (screen_info, GUINT_TO_POINTER (i + 1), FALSE);
+      clientSetId (clients[i], i + 1);
+    }
+  framed = g_get_monotonic_time ();
+
+  for (i = 0; i < n; i++)
+    {
+      Client *c = clientGetFromId (screen_info, activate[i] + 1);
+
+      clientRaise (c);
+      clientSetLastActive (c);
+    }
+  activated = g_get_monotonic_time ();
+
+  for (i = 0; i < n; i++)
+    clientUnframe (clientGetFromHandle (screen_info, GUINT_TO_POINTER (close[i] + 1)),
+                   FALSE);
+  closed = g_get_monotonic_time ();
+
+  g_assert (screen_info->client_count == 0);
+  g_assert (g_queue_is_empty (&screen_info->windows_stack));
+  g_assert (g_queue_is_empty (&screen_info->windows_mru));
+
+  printf ("stacking: frame %.3f ms, activate %.3f ms, unframe %.3f ms\n",
+          (framed - start) / 1000.0, (activated - framed) / 1000.0,
+          (closed - activated) / 1000.0);
+
+  g_free (clients);
+}
+
+static void
+bench_glist (guint n, const guint *activate, const guint *close)
+{
+  GList *windows = NULL, *windows_stack = NULL, *list;
+  gpointer *clients = g_new (gpointer, n);
+  gint64 start, framed, activated, closed;
+  guint i;
+
+  for (i = 0; i < n; i++)
+    clients[i] = g_new0 (Client, 1);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n; i++)
+    {
+      windows = g_list_append (windows, clients[i]);
+      windows_stack = g_list_append (windows_stack, clients[i]);
+    }
+  framed = g_get_monotonic_time ();
+
+  for (i = 0; i < n; i++)
+    {
+      /* lookup by id was a walk of the window list */
+      for (list = windows; list->data != clients[activate[i]]; list = list->next)
+        ;
+      windows_stack = g_list_remove (windows_stack, list->data);
+      windows_stack = g_list_append (windows_stack, list->data);
+    }
+  activated = g_get_monotonic_time ();
+
+  for (i = 0; i < n; i++)
+    {
+      windows = g_list_remove (windows, clients[close[i]]);
+      windows_stack = g_list_remove (windows_stack, clients[close[i]]);
+    }
+  closed = g_get_monotonic_time ();
+
+  printf ("GList:    frame %.3f ms, activate %.3f ms, unframe %.3f ms\n",
+          (framed - start) / 1000.0, (activated - framed) / 1000.0,
+          (closed - activated) / 1000.0);
+
+  for (i = 0; i < n; i++)
+    g_free (clients[i]);
+  g_free (clients);
+}
+
+int
+main (int argc, char *argv[])
+{
+  guint n = argc > 1 ? (guint) atoi (argv[1]) : 10000;
+  guint *activate, *close;
+  GRand *rand;
+
+  if (n == 0)
+    return 1;
+
+  rand = g_rand_new_with_seed (1);
+  activate = g_new (guint, n);
+  close = g_new (guint, n);
+  shuffle (activate, n, rand);
+  shuffle (close, n, rand);
+
+  printf ("%u clients\n", n);
+  bench_stacking (n, activate, close);
+  bench_glist (n, activate, close);
+
+  g_free (activate);
+  g_free (close);
+  g_rand_free (rand);
+
+  return 0;
+}
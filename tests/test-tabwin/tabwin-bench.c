@@ -0,0 +1,106 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Times the switcher with many fake clients: showing it, then one Alt+Tab
+ * keypress per client all the way around, each followed by the redraw.
+ * With the virtual grid the cost of a keypress should stay flat as the
+ * number of clients grows. Needs a display to map the switcher on.
+ * Usage: test-tabwin [clients...] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+#include "screen.h"
+#include "client.h"
+#include "tabwin.h"
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+bench_tabwin (guint n)
+{
+  ScreenInfo *screen_info;
+  Tabwin *tabwin;
+  GList *client_list = NULL;
+  Client *c;
+  gint64 start, shown, press, total = 0, worst = 0;
+  guint i;
+
+  screen_info = myScreenInit (gdk_screen_get_default ());
+  screen_info->params->cycle_tabwin_mode = STANDARD_ICON_GRID;
+  tabwin = tabwinNew (screen_info, FALSE);
+
+  for (i = 0; i < n; i++)
+    {
+      c = clientFrame (screen_info, GUINT_TO_POINTER (i + 1), FALSE);
+      clientSetId (c, i + 1);
+      c->name = g_strdup_printf ("Window %u", i + 1);
+      tabwinAddClient (tabwin, c);
+      client_list = g_list_prepend (client_list, c);
+    }
+
+  start = g_get_monotonic_time ();
+  tabwinShow (tabwin, &client_list, client_list);
+  flush_events ();
+  shown = g_get_monotonic_time ();
+
+  for (i = 0; i < n; i++)
+    {
+      press = g_get_monotonic_time ();
+      tabwinSelectNext (tabwin);
+      flush_events ();
+      press = g_get_monotonic_time () - press;
+
+      total += press;
+      worst = MAX (worst, press);
+    }
+
+  printf ("%5u clients (%s): show %.3f ms, keypress mean %.3f ms, max %.3f ms\n",
+          n, tabwin->virtual ? "virtual" : "full", (shown - start) / 1000.0,
+          total / 1000.0 / n, worst / 1000.0);
+
+  tabwinHide (tabwin);
+  tabwinDestroy (tabwin);
+  g_list_free (client_list);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const guint defaults[] = { 100, 500, 2000 };
+  guint i;
+
+  gtk_init (&argc, &argv);
+
+  if (argc > 1)
+    {
+      for (i = 1; i < (guint) argc; i++)
+        if (atoi (argv[i]) > 0)
+          bench_tabwin ((guint) atoi (argv[i]));
+    }
+  else
+    {
+      for (i = 0; i < G_N_ELEMENTS (defaults); i++)
+        bench_tabwin (defaults[i]);
+    }
+
+  return 0;
+}
@@ -0,0 +1,113 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Checks the switcher thumbnail downscaler against a plain per-pixel box
+ * filter, then times it on a 3840x2160 window.
+ * Usage: test-thumbnail [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "thumbnail.h"
+
+#define SRC_WIDTH 3840
+#define SRC_HEIGHT 2160
+#define MAX_SIZE 256
+
+static int
+check_against_reference (const uint8_t *src, int sw, int sh, int dw, int dh)
+{
+  struct xfway_thumbnail_scaler scaler = { 0 };
+  uint8_t *dst = malloc ((size_t) dw * dh * 4);
+  int dx, dy, c, errors = 0;
+
+  xfway_thumbnail_downscale (&scaler, src, sw, sh, sw * 4,
+                             dst, dw, dh, dw * 4, true);
+
+  for (dy = 0; dy < dh; dy++)
+    for (dx = 0; dx < dw; dx++)
+      {
+        int x0 = (int64_t) dx * sw / dw, x1 = (int64_t) (dx + 1) * sw / dw;
+        int y0 = (int64_t) dy * sh / dh, y1 = (int64_t) (dy + 1) * sh / dh;
+        int x, y;
+
+        if (x1 <= x0)
+          x1 = x0 + 1;
+        if (y1 <= y0)
+          y1 = y0 + 1;
+
+        for (c = 0; c < 4; c++)
+          {
+            uint64_t sum = 0, count = (uint64_t) (x1 - x0) * (y1 - y0);
+            int sc = c == 0 ? 2 : c == 2 ? 0 : c;
+
+            for (y = y0; y < y1; y++)
+              for (x = x0; x < x1; x++)
+                sum += src[((size_t) y * sw + x) * 4 + sc];
+
+            if (dst[((size_t) dy * dw + dx) * 4 + c] != (sum + count / 2) / count)
+              errors++;
+          }
+      }
+
+  free (dst);
+  xfway_thumbnail_scaler_release (&scaler);
+  return errors;
+}
+
+int main (int    argc,
+          char **argv)
+{
+  struct xfway_thumbnail_scaler scaler = { 0 };
+  struct timespec start, end;
+  int iterations = argc > 1 ? atoi (argv[1]) : 50;
+  int dw, dh, i, errors;
+  uint8_t *src;
+  uint32_t *dst;
+  double ms;
+
+  src = malloc ((size_t) SRC_WIDTH * SRC_HEIGHT * 4);
+  for (i = 0; i < SRC_WIDTH * SRC_HEIGHT * 4; i++)
+    src[i] = rand ();
+
+  errors = check_against_reference (src, 37, 23, 5, 4) +
+           check_against_reference (src, 640, 480, 256, 192) +
+           check_against_reference (src, 7, 3, 9, 5);
+  if (errors)
+    {
+      fprintf (stderr, "downscale differs from reference in %d channels\n", errors);
+      return 1;
+    }
+
+  xfway_thumbnail_fit (SRC_WIDTH, SRC_HEIGHT, MAX_SIZE, MAX_SIZE, &dw, &dh);
+  dst = malloc ((size_t) dw * dh * 4);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < iterations; i++)
+    xfway_thumbnail_downscale (&scaler, src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4,
+                               dst, dw, dh, dw * 4, true);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+  printf ("%dx%d -> %dx%d: %.2f ms per thumbnail (%d iterations)\n",
+          SRC_WIDTH, SRC_HEIGHT, dw, dh, ms / iterations, iterations);
+
+  xfway_thumbnail_scaler_release (&scaler);
+  free (dst);
+  free (src);
+  return 0;
+}
@@ -0,0 +1,127 @@
+/* Copyright (C) 2019 adlo
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Times recording a trace span, alone and nested in another, against an
+ * empty loop, then dumps the rings while a second thread keeps recording
+ * and checks the dump is complete JSON-wise by counting its events.
+ * Usage: test-trace [spans] [path] */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+static volatile unsigned sink;
+static volatile int stop;
+
+static void
+inner (unsigned i)
+{
+  XFWAY_TRACE_SPAN ("inner");
+
+  sink += i;
+}
+
+/* Counts the spans it started in *data */
+static void *
+recorder_thread (void *data)
+{
+  unsigned *started = data;
+  unsigned i = 0;
+
+  while (!stop)
+    {
+      XFWAY_TRACE_SPAN ("recorder");
+
+      inner (i);
+      __atomic_store_n (started, ++i, __ATOMIC_RELEASE);
+    }
+
+  return NULL;
+}
+
+static double
+time_loop (unsigned n, int spans)
+{
+  uint64_t start = xfway_trace_now ();
+  unsigned i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (spans == 0)
+        {
+          sink += i;
+        }
+      else if (spans == 1)
+        {
+          inner (i);
+        }
+      else
+        {
+          XFWAY_TRACE_SPAN ("outer");
+
+          inner (i);
+        }
+    }
+
+  return (double) (xfway_trace_now () - start) / n;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned n = argc > 1 ? strtoul (argv[1], NULL, 10) : 1000000;
+  const char *path = argc > 2 ? argv[2] : "test-trace.json";
+  double empty, one, two;
+  pthread_t recorder;
+  char line[256];
+  unsigned events = 0;
+  unsigned started = 0;
+  FILE *f;
+
+  if (n == 0)
+    return EXIT_FAILURE;
+
+  empty = time_loop (n, 0);
+  one = time_loop (n, 1);
+  two = time_loop (n, 2);
+  printf ("%u iterations: %.1f ns empty, %.1f ns per span, %.1f ns per nested pair\n",
+          n, empty, one - empty, two - empty);
+
+  /* the first recorder span is in its ring once the second has started */
+  pthread_create (&recorder, NULL, recorder_thread, &started);
+  while (__atomic_load_n (&started, __ATOMIC_ACQUIRE) < 2)
+    ;
+  if (!xfway_trace_dump (path))
+    {
+      perror (path);
+      return EXIT_FAILURE;
+    }
+  stop = 1;
+  pthread_join (recorder, NULL);
+
+  f = fopen (path, "r");
+  while (f && fgets (line, sizeof (line), f))
+    if (strstr (line, "\"ph\":\"X\""))
+      events++;
+  if (f)
+    fclose (f);
+  printf ("dumped %u spans to %s, the recorder started %u\n", events, path,
+          started);
+
+  return events > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
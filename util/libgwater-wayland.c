@@ -40,12 +40,24 @@
 
 #include "libgwater-wayland.h"
 
+#define G_WATER_WAYLAND_EVENTS (G_IO_IN | G_IO_ERR | G_IO_HUP)
+
 struct _GWaterWaylandSource {
     GSource source;
     gboolean display_owned;
     struct wl_display *display;
     gpointer fd;
     int error;
+    /*
+     * Events dispatched since the main loop last went a round without us.
+     * Past the budget we sit out one iteration, so that lower priority
+     * sources (GTK redraws among them) get to run during a backlog.
+     */
+    guint budget;
+    guint burst;
+    gboolean yield;
+    gboolean flush_pending;
+    GWaterWaylandSourceStats stats;
 };
 
 static gboolean
@@ -53,13 +65,34 @@ _g_water_wayland_source_prepare(GSource *source, gint *timeout)
 {
     GWaterWaylandSource *self = (GWaterWaylandSource *)source;
 
+    *timeout = -1;
+    if ( self->yield )
+        return FALSE;
+
     *timeout = 0;
     if ( wl_display_prepare_read(self->display) != 0 )
         return TRUE;
-    else if ( wl_display_flush(self->display) < 0 )
+
+    /*
+     * Requests sent while dispatching are only flushed here, once per
+     * iteration, right before we may sleep
+     */
+    self->stats.flushes++;
+    if ( wl_display_flush(self->display) < 0 )
     {
-        self->error = errno;
-        return TRUE;
+        if ( errno != EAGAIN )
+        {
+            self->error = errno;
+            wl_display_cancel_read(self->display);
+            return TRUE;
+        }
+
+        /* The socket is full, try again once the compositor read some */
+        if ( ! self->flush_pending )
+        {
+            self->flush_pending = TRUE;
+            g_source_modify_unix_fd(source, self->fd, G_WATER_WAYLAND_EVENTS | G_IO_OUT);
+        }
     }
 
     *timeout = -1;
@@ -74,18 +107,37 @@ _g_water_wayland_source_check(GSource *source)
     if ( self->error > 0 )
         return TRUE;
 
+    if ( self->yield )
+    {
+        /* prepare did not start a read, nothing to cancel */
+        self->yield = FALSE;
+        self->burst = 0;
+        return FALSE;
+    }
+
     GIOCondition revents;
     revents = g_source_query_unix_fd(source, self->fd);
 
+    if ( ( revents & G_IO_OUT ) && self->flush_pending )
+    {
+        /* prepare flushes the rest on the next iteration */
+        self->flush_pending = FALSE;
+        g_source_modify_unix_fd(source, self->fd, G_WATER_WAYLAND_EVENTS);
+    }
+
     if ( revents & G_IO_IN )
     {
         if ( wl_display_read_events(self->display) < 0 )
             self->error = errno;
     }
     else
+    {
         wl_display_cancel_read(self->display);
+        /* the backlog is drained */
+        self->burst = 0;
+    }
 
-    return ( revents > 0 );
+    return ( ( revents & G_WATER_WAYLAND_EVENTS ) != 0 );
 }
 
 static gboolean
@@ -104,13 +156,33 @@ _g_water_wayland_source_dispatch(GSource *source, GSourceFunc callback, gpointer
         return G_SOURCE_REMOVE;
     }
 
-    if ( wl_display_dispatch_pending(self->display) < 0 )
+    int events;
+    events = wl_display_dispatch_pending(self->display);
+    if ( events < 0 )
     {
         if ( callback != NULL )
             return callback(user_data);
         return G_SOURCE_REMOVE;
     }
 
+    self->stats.wakeups++;
+    self->stats.events += events;
+    if ( (guint64) events > self->stats.max_events )
+        self->stats.max_events = events;
+
+    /*
+     * libwayland has no way to stop halfway through its queue, so the
+     * budget is checked between reads, each of which is bounded by the
+     * connection buffer
+     */
+    self->burst += events;
+    if ( ( self->budget > 0 ) && ( self->burst >= self->budget ) )
+    {
+        g_debug("Dispatched %u events in a row, yielding", self->burst);
+        self->yield = TRUE;
+        self->stats.yields++;
+    }
+
     return G_SOURCE_CONTINUE;
 }
 
@@ -157,7 +229,8 @@ g_water_wayland_source_new_for_display(GMainContext *context, struct wl_display
     self = (GWaterWaylandSource *)source;
     self->display = display;
 
-    self->fd = g_source_add_unix_fd(source, wl_display_get_fd(self->display), G_IO_IN | G_IO_ERR | G_IO_HUP);
+    self->budget = G_WATER_WAYLAND_DEFAULT_BUDGET;
+    self->fd = g_source_add_unix_fd(source, wl_display_get_fd(self->display), G_WATER_WAYLAND_EVENTS);
 
     g_source_attach(source, context);
 
@@ -190,3 +263,19 @@ g_water_wayland_source_get_display(GWaterWaylandSource *self)
 
     return self->display;
 }
+
+void
+g_water_wayland_source_set_dispatch_budget(GWaterWaylandSource *self, guint budget)
+{
+    g_return_if_fail(self != NULL);
+
+    self->budget = budget;
+}
+
+const GWaterWaylandSourceStats *
+g_water_wayland_source_get_stats(GWaterWaylandSource *self)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    return &self->stats;
+}
@@ -30,6 +30,17 @@ G_BEGIN_DECLS
 
 typedef struct _GWaterWaylandSource GWaterWaylandSource;
 
+/* Events dispatched in a row before the source lets other sources run */
+#define G_WATER_WAYLAND_DEFAULT_BUDGET 256
+
+typedef struct {
+    guint64 wakeups; /* dispatches, events per wakeup is events / wakeups */
+    guint64 events;
+    guint64 max_events; /* most events dispatched by a single wakeup */
+    guint64 yields; /* iterations skipped because the budget ran out */
+    guint64 flushes;
+} GWaterWaylandSourceStats;
+
 GWaterWaylandSource *g_water_wayland_source_new(GMainContext *context, const gchar *name);
 GWaterWaylandSource *g_water_wayland_source_new_for_display(GMainContext *context, struct wl_display *display);
 void g_water_wayland_source_free(GWaterWaylandSource *self);
@@ -37,6 +48,9 @@ void g_water_wayland_source_free(GWaterWaylandSource *self);
 void g_water_wayland_source_set_error_callback(GWaterWaylandSource *self, GSourceFunc callback, gpointer user_data, GDestroyNotify destroy_notify);
 struct wl_display *g_water_wayland_source_get_display(GWaterWaylandSource *source);
 
+void g_water_wayland_source_set_dispatch_budget(GWaterWaylandSource *self, guint budget);
+const GWaterWaylandSourceStats *g_water_wayland_source_get_stats(GWaterWaylandSource *self);
+
 G_END_DECLS
 
 #endif /* __G_WATER_WAYLAND_H__ */